@@ -346,14 +346,14 @@ int pause_game (void)
                 msg_rect.y = rect.y + rect.h/2 - pause_msg->h/2;
                 SDL_BlitSurface(pause_msg,NULL,screen,&msg_rect);
             }
-        SDL_UpdateRects (screen, anim_rects, anim_update_rects);
+        update_screen_rects (anim_rects, anim_update_rects);
         SDL_FreeSurface(pause_msg);
     }
     return !anim_gamepaused;
 }
 
 /**** Redraw frame ****/
-void animate_frame (void)
+void animate_frame (int present)
 {
     /* Delay after game ends */
     if (endgame > 0)
@@ -372,7 +372,11 @@ void animate_frame (void)
     /* Draw */
     draw_ships ();
     draw_pilots ();
+    /* Projectiles spawned by the objects above join the list before */
+    /* it is animated and the ones spawned by projectiles after it */
+    flush_projectiles ();
     animate_projectiles ();
+    flush_projectiles ();
     animate_particles ();
     draw_bat_attack ();
     draw_player_hud ();
@@ -395,8 +399,9 @@ void animate_frame (void)
         anim_fadescr = fades[0] | (fades[1] << 8) | (fades[2] << 16) | (fades[3] << 24);
     }
 
-    /* Update screen */
-    SDL_UpdateRects (screen, anim_rects, anim_update_rects);
+    /* Update screen. Catch up frames are drawn, but not shown */
+    if (present)
+        update_screen_rects (anim_rects, anim_update_rects);
 
     /* End the level if there are less than two teams left
      * and endmode is last player wins or if there are less than 10
@@ -42,8 +42,8 @@ extern int pause_game (void);
 /* Start fading out a player viewport */
 extern void kill_plr_screen (int plr);
 
-/* Animate a single frame */
-extern void animate_frame (void);
+/* Animate a single frame. If present is zero, the screen is not updated */
+extern void animate_frame (int present);
 
 /* When >0, counts down to 0. When hits 0, the level ends */
 extern int endgame;
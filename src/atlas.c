@@ -0,0 +1,197 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : atlas.c
+ * Description : Sprite atlases for baked graphics
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "SDL.h"
+
+#include "console.h"
+#include "atlas.h"
+
+#define MAX_ATLASES 16
+
+static struct Atlas *atlases[MAX_ATLASES];
+static int atlas_count;
+static size_t atlas_memory;
+
+/* Create a new atlas */
+struct Atlas *new_atlas (const char *name, SDL_Surface * likethis)
+{
+    struct Atlas *atlas;
+    if (atlas_count == MAX_ATLASES) {
+        fprintf (stderr, "new_atlas(%s): too many atlases\n", name);
+        exit (1);
+    }
+    atlas = malloc (sizeof (struct Atlas));
+    if (!atlas) {
+        perror ("new_atlas");
+        exit (1);
+    }
+    atlas->name = name;
+    atlas->likethis = likethis;
+    atlas->pages = NULL;
+    atlas->pagecount = 0;
+    atlas->shelf = NULL;
+    atlas->shelf_x = atlas->shelf_y = atlas->shelf_h = 0;
+    atlas->frames = 0;
+    atlas->bytes = 0;
+    atlas->baketime = 0;
+    atlases[atlas_count++] = atlas;
+    return atlas;
+}
+
+/* Free an atlas */
+void free_atlas (struct Atlas *atlas)
+{
+    int r;
+    for (r = 0; r < atlas->pagecount; r++)
+        SDL_FreeSurface (atlas->pages[r]);
+    free (atlas->pages);
+    atlas_memory -= atlas->bytes;
+    for (r = 0; r < atlas_count; r++) {
+        if (atlases[r] == atlas) {
+            atlases[r] = atlases[--atlas_count];
+            break;
+        }
+    }
+    free (atlas);
+}
+
+/* Add a new page to an atlas */
+static SDL_Surface *add_page (struct Atlas *atlas, int w, int h)
+{
+    SDL_Surface *page;
+    size_t bytes;
+
+    bytes = (size_t) w * h * atlas->likethis->format->BytesPerPixel;
+    if (atlas_memory + bytes > ATLAS_BUDGET)
+        return NULL;
+    page = make_surface (atlas->likethis, w, h);
+    if (!page) {
+        fprintf (stderr, "add_page(%s): %s\n", atlas->name, SDL_GetError ());
+        return NULL;
+    }
+    SDL_FillRect (page, NULL, 0);
+    if (page->format->Amask)
+        SDL_SetAlpha (page, SDL_SRCALPHA, SDL_ALPHA_OPAQUE);
+    else
+        SDL_SetColorKey (page, SDL_SRCCOLORKEY, 0);
+
+    atlas->pages = realloc (atlas->pages,
+                            sizeof (SDL_Surface *) * (atlas->pagecount + 1));
+    if (!atlas->pages) {
+        perror ("add_page");
+        exit (1);
+    }
+    atlas->pages[atlas->pagecount++] = page;
+    atlas->bytes += bytes;
+    atlas_memory += bytes;
+    return page;
+}
+
+/* Reserve space for a frame */
+int atlas_add (struct Atlas *atlas, int w, int h, struct AtlasFrame *frame)
+{
+    SDL_Surface *page;
+
+    if (w > ATLAS_PAGE_SIZE || h > ATLAS_PAGE_SIZE) {
+        /* Too big to share a page */
+        page = add_page (atlas, w, h);
+        if (!page)
+            return 0;
+        frame->page = page;
+        frame->rect.x = 0;
+        frame->rect.y = 0;
+    } else {
+        if (atlas->shelf_x + w > ATLAS_PAGE_SIZE) {
+            /* Start a new shelf */
+            atlas->shelf_x = 0;
+            atlas->shelf_y += atlas->shelf_h;
+            atlas->shelf_h = 0;
+        }
+        if (atlas->shelf == NULL || atlas->shelf_y + h > ATLAS_PAGE_SIZE) {
+            atlas->shelf = add_page (atlas, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+            if (!atlas->shelf)
+                return 0;
+            atlas->shelf_x = 0;
+            atlas->shelf_y = 0;
+            atlas->shelf_h = 0;
+        }
+        frame->page = atlas->shelf;
+        frame->rect.x = atlas->shelf_x;
+        frame->rect.y = atlas->shelf_y;
+        atlas->shelf_x += w;
+        if (h > atlas->shelf_h)
+            atlas->shelf_h = h;
+    }
+    frame->rect.w = w;
+    frame->rect.h = h;
+    atlas->frames++;
+    return 1;
+}
+
+/* Blit a frame centered on x,y of a player viewport */
+void draw_atlas_frame (const struct AtlasFrame *frame, int x, int y,
+                       SDL_Rect viewport)
+{
+    SDL_Rect src, dst;
+    int sx = 0, sy = 0, w = frame->rect.w, h = frame->rect.h;
+    x -= w / 2;
+    y -= h / 2;
+    if (x < 0) {
+        sx = -x;
+        w += x;
+        x = 0;
+    }
+    if (y < 0) {
+        sy = -y;
+        h += y;
+        y = 0;
+    }
+    if (x + w > viewport.w)
+        w = viewport.w - x;
+    if (y + h > viewport.h)
+        h = viewport.h - y;
+    if (w <= 0 || h <= 0)
+        return;
+    src.x = frame->rect.x + sx;
+    src.y = frame->rect.y + sy;
+    src.w = w;
+    src.h = h;
+    dst.x = viewport.x + x;
+    dst.y = viewport.y + y;
+    SDL_BlitSurface (frame->page, &src, screen, &dst);
+}
+
+/* Print the memory used by each atlas */
+void atlas_stats (void)
+{
+    int r;
+    for (r = 0; r < atlas_count; r++)
+        printf ("Atlas %s: %d frames on %d pages, %lu KB, baked in %u ms\n",
+                atlases[r]->name, atlases[r]->frames, atlases[r]->pagecount,
+                (unsigned long) atlases[r]->bytes / 1024,
+                (unsigned int) atlases[r]->baketime);
+    printf ("Atlases use %lu KB of %d KB\n",
+            (unsigned long) atlas_memory / 1024, ATLAS_BUDGET / 1024);
+}
@@ -0,0 +1,74 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : atlas.h
+ * Description : Sprite atlases for baked graphics
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "SDL.h"
+
+/* Size of a normal atlas page. Bigger frames get a page of their own */
+#define ATLAS_PAGE_SIZE 256
+
+/* How much memory all atlases may use together */
+#define ATLAS_BUDGET    (4*1024*1024)
+
+/* A frame stored in an atlas */
+struct AtlasFrame {
+    SDL_Surface *page;
+    SDL_Rect rect;
+};
+
+/* A set of pages that frames are packed into, shelf by shelf */
+struct Atlas {
+    const char *name;
+    SDL_Surface *likethis;      /* Pages are made like this surface */
+    SDL_Surface **pages;
+    int pagecount;
+    SDL_Surface *shelf;         /* Page that small frames are packed into */
+    int shelf_x, shelf_y, shelf_h;      /* Free space on that page */
+    int frames;
+    size_t bytes;
+    Uint32 baketime;            /* Milliseconds spent filling the atlas */
+};
+
+/* Create a new atlas. Pages have the same pixel format as likethis. */
+/* Unused pixels are zero, which is transparent through the colorkey or */
+/* the alpha channel */
+extern struct Atlas *new_atlas (const char *name, SDL_Surface * likethis);
+
+/* Free an atlas and all its pages */
+extern void free_atlas (struct Atlas *atlas);
+
+/* Reserve space for a w*h frame. Returns 1 on success, or 0 if the */
+/* memory budget would be exceeded */
+extern int atlas_add (struct Atlas *atlas, int w, int h,
+                      struct AtlasFrame *frame);
+
+/* Blit a frame centered on x,y of a player viewport, clipped to it */
+extern void draw_atlas_frame (const struct AtlasFrame *frame, int x, int y,
+                              SDL_Rect viewport);
+
+/* Print the memory used by each atlas */
+extern void atlas_stats (void);
+
+#endif
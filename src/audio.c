@@ -37,6 +37,7 @@
 
 #include "console.h"
 #include "fs.h"
+#include "jobs.h"
 #include "startup.h"
 #include "parser.h"
 #include "player.h"
@@ -49,6 +50,14 @@ static struct dllist *playlist, *playlist_original;
 
 static Mix_Chunk *samples[SAMPLE_COUNT];
 static Mix_Music *music=NULL;
+static SDL_RWops *sample_rw[SAMPLE_COUNT]; /* Used while loading */
+
+/* Worker thread job to decode a sample */
+static void load_sample (void *arg)
+{
+    SDL_RWops **rw = arg;
+    samples[rw - sample_rw] = Mix_LoadWAV_RW(*rw,0);
+}
 
 /* Music stopped playing, move on to the next track */
 static void playlist_forward (void)
@@ -104,12 +113,24 @@ void init_audio ()
     Mix_HookMusicFinished (playlist_forward);
 
     /* Load samples */
-    ldat = ldat_open_file(getfullpath(DATA_DIRECTORY,"sfx.ldat"));
+    ldat = ldat_map_file(getfullpath(DATA_DIRECTORY,"sfx.ldat"));
     if(!ldat) {
         fprintf(stderr,"Can't load sound effects!");
     } else {
+        Job *jobs[SAMPLE_COUNT];
+        /* Decode the samples on the worker threads if they can */
+        /* be read at the same time */
         for (w = 0; w < SAMPLE_COUNT; w++) {
-            samples[w] = Mix_LoadWAV_RW(ldat_get_item(ldat,"SFX",w),0);
+            sample_rw[w] = ldat_open_item(ldat,"SFX",w);
+            jobs[w] = sample_rw[w] ? add_job(load_sample, sample_rw + w) : NULL;
+        }
+        for (w = 0; w < SAMPLE_COUNT; w++) {
+            if (jobs[w]) {
+                finish_job(jobs[w]);
+                SDL_FreeRW(sample_rw[w]);
+            } else {
+                samples[w] = Mix_LoadWAV_RW(ldat_get_item(ldat,"SFX",w),0);
+            }
             if (samples[w] == NULL) {
                 fprintf (stderr,"Couldn't get SFX %d\n", w);
             }
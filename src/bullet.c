@@ -35,12 +35,14 @@
 #include "ship.h"
 #include "audio.h"
 #include "defines.h" /* For Round() */
+#include "vortex.h"
 
 #define DIVIDINGMINE_INTERVAL (7*GAME_SPEED)
 #define DIVIDINGMINE_RAND (2*GAME_SPEED)
+#define BIG_CRATER_RADIUS 12 /* Crater left by megabombs and rockets */
 
 /* Draw a simple one dot projectile */
-static void draw_simple_projectile(struct Projectile *p,int x,int y, SDL_Rect viewport) {
+void draw_simple_projectile(struct Projectile *p,int x,int y, SDL_Rect viewport) {
     putpixel (screen, x + viewport.x, y + viewport.y, p->color);
 }
 
@@ -114,17 +116,14 @@ static void draw_zap(struct Projectile *p,int x,int y, SDL_Rect viewport) {
 
 /* Draw a vortex */
 static void draw_vortex(struct Projectile *p,int x,int y, SDL_Rect viewport) {
-    int i;
-    if(p->var>8) p->var=0;
+    if(p->var>=vortex_frame_count-1) p->var=0;
     else p->var++;
-    for(i=0;i<12;i++) {
-        double d = -M_PI_4 * i + p->var / 4.0;
-        int j;
-        for(j=4;j<=16;j++) {
-            putpixel(screen, x+viewport.x + cos(d-j/6.0) * j,
-                    y + viewport.y + sin(d-j/6.0) * j, p->color);
-        }
-    }
+    draw_vortex_phase(p->var, p->color, x, y, viewport);
+}
+
+/* Bake procedurally drawn projectiles */
+void init_bullets(void) {
+    bake_vortex(VORTEX_FRAMES, col_gray);
 }
 
 /* Spawn a cluster of projectiles */
@@ -176,7 +175,8 @@ static void projectile_explode_cluster1(struct Projectile *p) {
 
 /* Explode into cluster of grenades */
 static void projectile_explode_cluster2(struct Projectile *p) {
-    add_explosion(Round(p->physics.x),Round(p->physics.y));
+    add_big_explosion(Round(p->physics.x),Round(p->physics.y),
+            BIG_CRATER_RADIUS);
     spawn_clusters(p->physics.x,p->physics.y,5.6, 8, make_grenade);
     spawn_clusters (p->physics.x, p->physics.y,5.6, 16, make_firestarter);
 }
@@ -221,6 +221,8 @@ static void spear_explode(struct Projectile *p) {
     draw_line (lev_level.terrain, Round(p->physics.x) - dx,
                Round(p->physics.y) - dy, Round(p->physics.x) + dx,
                Round(p->physics.y) + dy, p->color);
+    mark_terrain_dirty (Round(p->physics.x) - 6, Round(p->physics.y) - 6,
+            13, 13);
 }
 
 /* Spear a ship */
@@ -465,6 +467,26 @@ static Uint8 rand_col(Uint8 c) {
     return tmp;
 }
 
+/* Crowding check for dividing mines */
+static void mine_divide(struct Projectile *mine);
+
+struct Crowd {
+    struct Projectile *mine;
+    double radius;
+    int count;
+};
+
+/* Count a dividing mine if it is close enough. Stops counting */
+/* as soon as it is known to be too crowded */
+static int count_crowd(struct Projectile *p, void *arg) {
+    struct Crowd *crowd = arg;
+    if(p!=crowd->mine && p->life!=0 && p->timerfunc == mine_divide
+            && hypot(p->physics.x-crowd->mine->physics.x,
+                p->physics.y-crowd->mine->physics.y) < crowd->radius)
+        crowd->count++;
+    return crowd->count > crowd->mine->owner;
+}
+
 /* Dividing mine division */
 /* Note. some variables from Projectile are heavily reused here */
 /* for other purposes than what they were intended for:
@@ -473,25 +495,27 @@ static Uint8 rand_col(Uint8 c) {
  * ownerteam -> crowdedness treshold
  */
 static void mine_divide(struct Projectile *mine) {
-    struct Projectile *newmine = malloc(sizeof(struct Projectile));
+    struct Projectile *newmine;
     double splitangle = rand()%628/100.0;
-    struct dllist *lst;
-    int crowd=0;
+    struct Crowd crowd;
     Vector v;
 
-    /* How many other dividing mines there are nearby? */
-    lst = projectile_list;
-    while(lst) {
-        struct Projectile *p = lst->data;
-        if(p!=mine && p->timerfunc == mine_divide
-                && hypot(p->physics.x-mine->physics.x,
-                    p->physics.y-mine->physics.y) < 14 * mine->physics.radius)
-            crowd++;
-        lst=lst->next;
-    }
+    /* How many other dividing mines there are nearby? The crowding */
+    /* radius fits in an index cell, so only the mines in the cells */
+    /* around this one need to be looked at, and only if there are */
+    /* enough of them to be crowded in the first place */
+    crowd.mine = mine;
+    crowd.radius = 14 * mine->physics.radius;
+    if(crowd.radius > PROJ_CELL)
+        crowd.radius = PROJ_CELL;
+    crowd.count = 0;
+    if(count_projectiles_near(PROJ_DIVMINE, mine->physics.x,
+                mine->physics.y) - 1 > mine->owner)
+        visit_projectiles_near(PROJ_DIVMINE, mine->physics.x,
+                mine->physics.y, count_crowd, &crowd);
 
     /* If too crowded, don't divide */
-    if(crowd > mine->owner) {
+    if(crowd.count > mine->owner) {
         mine->timer = mine->var;
         return;
     }
@@ -537,6 +561,11 @@ static void mine_divide(struct Projectile *mine) {
     set_fuse(mine,4); /* Become insensitive for a while so mines can separate */
 
     /* Split */
+    newmine = malloc(sizeof(struct Projectile));
+    if(!newmine) {
+        perror("mine_divide");
+        return;
+    }
     memcpy(newmine,mine,sizeof(struct Projectile));
     
     mine->physics.vel.x += v.x;
@@ -566,15 +595,19 @@ static void landmine_getstuck(struct Projectile *mine) {
 }
 
 /* Detonate landmine */
+/* The owner index lists the newest mines first, but the oldest */
+/* one is detonated */
 int detonate_landmine(struct Ship *owner) {
-    struct dllist *ptr = projectile_list;
-    while(ptr) {
-        struct Projectile *p=ptr->data;
-        if(p->src == owner && p->timerfunc==landmine_explode) {
-            p->timer=1;
-            return 1;
-        }
-        ptr=ptr->next;
+    struct Projectile *p = first_owned_projectile(PROJ_LANDMINE, owner);
+    struct Projectile *oldest = NULL;
+    while(p) {
+        if(p->timerfunc==landmine_explode)
+            oldest = p;
+        p = next_owned_projectile(p);
+    }
+    if(oldest) {
+        oldest->timer=1;
+        return 1;
     }
     return 0;
 }
@@ -662,6 +695,8 @@ static struct Projectile *make_base(double x,double y, Vector v) {
     p->otherobj = 0;
     p->hydrophobic = 0;
     p->critter = 1;
+    p->kind = PROJ_UNTRACKED;
+    p->cell = -1;
 
     if (game_settings.large_bullets)
         p->draw = draw_big_projectile;
@@ -792,6 +827,7 @@ struct Projectile *make_divmine(double x,double y, Vector v) {
 
     p->timer = p->var;
     p->timerfunc = mine_divide;
+    p->kind = PROJ_DIVMINE;
 
     return p;
 }
@@ -1066,6 +1102,7 @@ struct Projectile *make_landmine(double x,double y, Vector v) {
     p->draw = draw_big_projectile;
     p->explode = landmine_getstuck;
     p->timer=-1;
+    p->kind = PROJ_LANDMINE;
 
     return p;
 }
@@ -26,6 +26,13 @@
 
 #include "projectile.h"
 
+/* Draw a single pixel projectile. Uncloaked projectiles using this */
+/* are batched by the projectile drawing framework */
+extern void draw_simple_projectile(struct Projectile *p,int x,int y, SDL_Rect viewport);
+
+/* Bake the procedurally drawn projectiles. Call after the video mode is set */
+extern void init_bullets(void);
+
 /* Spawn a cluster of projectiles */
 extern void spawn_clusters (double x, double y, double f,int count,
             struct Projectile *(*make_projectile)(double x, double y, Vector v));
@@ -40,6 +40,7 @@
 #include "font.h"
 #include "demo.h"
 #include "startup.h"
+#include "jobs.h"
 
 /* The Bit Depth to use */
 #define SCREEN_DEPTH 32
@@ -51,9 +52,19 @@ Uint32 col_gray, col_grenade, col_snow, col_clay, col_clay_uw, col_default,
     col_yellow, col_black, col_red, col_cyan, col_white, col_rope, col_plrs[4];
 Uint32 col_pause_backg, col_green, col_blue, col_translucent;
 
+/* Screen update damage tracking */
+#define DAMAGE_TILE_W 32
+#define DAMAGE_TILE_H 16
+#define MAX_DAMAGE_RECTS 128
+
+#define ZOOM_BAND_ROWS 64   /* Rows per job when scaling surfaces */
+
 /* Internally used globals */
 static SDL_Joystick *pad_0; /* The first joypad is always opened,
                                for it can be used in menus */
+static Uint8 *con_shadow;   /* Copy of what is currently on the display */
+static int con_shadow_w, con_shadow_h;
+static int con_shadow_valid;
 
 /** Cleanup **/
 void con_cleanup (void)
@@ -382,11 +393,51 @@ void recolor (SDL_Surface * surface, float red, float green, float blue,
     }
 }
 
+/* A band of rows to be scaled by zoom_surface */
+typedef struct {
+    SDL_Surface *src, *dst;
+    const int *xindex, *yindex;
+    int y0, rows;
+    Job *job;
+} ZoomBand;
+
+/* Scale a band of rows. Run by a worker thread */
+static void zoom_rows(void *arg) {
+    ZoomBand *band = arg;
+    const int *xindex = band->xindex;
+    int x, y, w = band->dst->w;
+    for (y = band->y0; y < band->y0 + band->rows; y++) {
+        Uint8 *targ = (Uint8 *) band->dst->pixels + y * band->dst->pitch;
+        const Uint8 *src;
+        /* Rows made from the same source row are identical */
+        if (y > band->y0 && band->yindex[y] == band->yindex[y - 1]) {
+            memcpy(targ, targ - band->dst->pitch,
+                    w * band->dst->format->BytesPerPixel);
+            continue;
+        }
+        src = (const Uint8 *) band->src->pixels
+            + band->yindex[y] * band->src->pitch;
+        if (band->dst->format->BytesPerPixel == 1) {
+            for (x = 0; x < w; x++)
+                targ[x] = src[xindex[x]];
+        } else {
+            Uint32 *targ32 = (Uint32 *) targ;
+            const Uint32 *src32 = (const Uint32 *) src;
+            for (x = 0; x < w; x++)
+                targ32[x] = src32[xindex[x]];
+        }
+    }
+}
+
 /* Return a scaled version of the surface */
+/* Artwork and collisionmap are scaled using the same index tables, */
+/* so they stay aligned. */
 SDL_Surface *zoom_surface(SDL_Surface *original, float aspect, float zoom) {
     SDL_Surface *scaled;
-    Uint8 *targ, bpp;
-    int x, y;
+    ZoomBand *band;
+    int *xindex, *yindex;
+    int x, y, bands, b;
+    Uint8 bpp;
 
     bpp = original->format->BytesPerPixel;
     if(bpp!=1 && bpp!=4) {
@@ -395,31 +446,49 @@ SDL_Surface *zoom_surface(SDL_Surface *original, float aspect, float zoom) {
     }
     scaled = make_surface(original,original->w * aspect * zoom,
             original->h * zoom);
+    if(scaled==NULL) {
+        fprintf(stderr,"zoom_surface(): %s\n",SDL_GetError());
+        return NULL;
+    }
 
-    targ = ((Uint8 *) scaled->pixels);
+    /* Source column and row of each target column and row */
+    xindex = malloc(sizeof(int) * scaled->w);
+    yindex = malloc(sizeof(int) * scaled->h);
+    bands = (scaled->h + ZOOM_BAND_ROWS - 1) / ZOOM_BAND_ROWS;
+    band = malloc(sizeof(ZoomBand) * (bands + 1));
+    if(!xindex || !yindex || !band) {
+        perror("zoom_surface");
+        exit(1);
+    }
+    for (x = 0; x < scaled->w; x++) {
+        xindex[x] = (int)(x/(aspect*zoom));
+        if(xindex[x] >= original->w)
+            xindex[x] = original->w - 1;
+    }
     for (y = 0; y < scaled->h; y++) {
-        for (x = 0; x < scaled->w; x++) {
-#if 1 /* This works with a limited set of bitdepths, but is faster than using memcpy */
-            switch (bpp) {
-            case 1:
-                *((Uint8 *) (targ)) =
-                    *((Uint8 *) (original->pixels)+((int)(y/zoom))*original->w+(int)(x/(aspect*zoom)));
-                targ++;
-                break;
-            case 4:
-                *((Uint32 *) (targ)) =
-                    *((Uint32 *) (original->pixels)+((int)(y/zoom))*original->w+(int)(x/(aspect*zoom)));
-                targ += 4;
-                break;
-            }
-#else /* This works with all bitdepths, but is a bit slower */
-            memcpy(targ,original->pixels+(int)(y/zoom)*original->pitch+
-                    (int)(x/(aspect*zoom))*bpp,bpp);
-            targ+=bpp;
-#endif
-        }
-        targ += scaled->pitch - scaled->w*bpp;
+        yindex[y] = (int)(y/zoom);
+        if(yindex[y] >= original->h)
+            yindex[y] = original->h - 1;
+    }
+
+    /* Bands of rows are scaled in parallel */
+    for (b = 0; b < bands; b++) {
+        band[b].src = original;
+        band[b].dst = scaled;
+        band[b].xindex = xindex;
+        band[b].yindex = yindex;
+        band[b].y0 = b * ZOOM_BAND_ROWS;
+        band[b].rows = scaled->h - band[b].y0;
+        if(band[b].rows > ZOOM_BAND_ROWS)
+            band[b].rows = ZOOM_BAND_ROWS;
+        band[b].job = add_job(zoom_rows, band + b);
     }
+    for (b = 0; b < bands; b++)
+        finish_job(band[b].job);
+
+    free(band);
+    free(xindex);
+    free(yindex);
     return scaled;
 }
 
@@ -455,6 +524,7 @@ void toggle_fullscreen(void) {
      !defined(__QNXNTO__))
     /* This is the easy way, but it only works under X11 */
     SDL_WM_ToggleFullScreen(screen);
+    invalidate_screen();
 #else
     int fullscreen = !(screen->flags & SDL_FULLSCREEN);
     int w=screen->w,h=screen->h;
@@ -476,10 +546,164 @@ void toggle_fullscreen(void) {
     /* Copy back the pixel data */
     memcpy(screen->pixels,pixels,screen->h*screen->pitch);
     free(pixels);
-    SDL_UpdateRect(screen,0,0,0,0);
+    invalidate_screen();
+    update_screen_rect(0,0,0,0);
 #endif
 }
 
+/* Compare a part of the screen against the shadow copy. */
+/* Returns nonzero and updates the shadow copy if they differ */
+static int tile_changed (int x, int y, int w, int h)
+{
+    int bpp = screen->format->BytesPerPixel;
+    int spitch = con_shadow_w * bpp;
+    Uint8 *src = (Uint8 *) screen->pixels + y * screen->pitch + x * bpp;
+    Uint8 *dst = con_shadow + y * spitch + x * bpp;
+    int row;
+    for (row = 0; row < h; row++) {
+        if (memcmp (src, dst, w * bpp)) {
+            /* Rows before this one are unchanged */
+            for (; row < h; row++) {
+                memcpy (dst, src, w * bpp);
+                src += screen->pitch;
+                dst += spitch;
+            }
+            return 1;
+        }
+        src += screen->pitch;
+        dst += spitch;
+    }
+    return 0;
+}
+
+/* Find the changed parts of a screen rectangle. Damaged regions are */
+/* appended to the damage array and the new count is returned. */
+static int find_damage (SDL_Rect *rect, SDL_Rect *damage, int count)
+{
+    int x0 = rect->x, y0 = rect->y, x1 = rect->x + rect->w,
+        y1 = rect->y + rect->h;
+    int first = count, area = 0;
+    int tx, ty, tw, th, band, r, d;
+
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > screen->w) x1 = screen->w;
+    if (y1 > screen->h) y1 = screen->h;
+    if (x0 >= x1 || y0 >= y1)
+        return count;
+
+    for (ty = y0; ty < y1; ty += DAMAGE_TILE_H) {
+        th = y1 - ty < DAMAGE_TILE_H ? y1 - ty : DAMAGE_TILE_H;
+        band = count;
+        for (tx = x0; tx < x1; tx += DAMAGE_TILE_W) {
+            tw = x1 - tx < DAMAGE_TILE_W ? x1 - tx : DAMAGE_TILE_W;
+            if (tile_changed (tx, ty, tw, th) == 0)
+                continue;
+            area += tw * th;
+            /* Join with the tile on the left */
+            if (count > band && damage[count - 1].x + damage[count - 1].w == tx) {
+                damage[count - 1].w += tw;
+                continue;
+            }
+            if (count == MAX_DAMAGE_RECTS)
+                goto full_update;
+            damage[count].x = tx;
+            damage[count].y = ty;
+            damage[count].w = tw;
+            damage[count].h = th;
+            count++;
+        }
+        /* Join with identical spans on the row above */
+        for (r = band; r < count; r++) {
+            for (d = first; d < band; d++) {
+                if (damage[d].x == damage[r].x && damage[d].w == damage[r].w
+                        && damage[d].y + damage[d].h == ty) {
+                    damage[d].h += th;
+                    damage[r] = damage[--count];
+                    r--;
+                    break;
+                }
+            }
+        }
+    }
+    /* If most of the rectangle has changed, one big update is cheaper */
+    if (area * 4 < (x1 - x0) * (y1 - y0) * 3)
+        return count;
+
+full_update:
+    /* Make sure the shadow copy is up to date for the whole rectangle */
+    for (ty = y0; ty < y1; ty++)
+        memcpy (con_shadow + (ty * con_shadow_w + x0) * screen->format->BytesPerPixel,
+                (Uint8 *) screen->pixels + ty * screen->pitch +
+                x0 * screen->format->BytesPerPixel,
+                (x1 - x0) * screen->format->BytesPerPixel);
+    damage[first].x = x0;
+    damage[first].y = y0;
+    damage[first].w = x1 - x0;
+    damage[first].h = y1 - y0;
+    return first + 1;
+}
+
+/* Update the changed parts of the given screen rectangles */
+void update_screen_rects (int numrects, SDL_Rect *rects)
+{
+    SDL_Rect damage[MAX_DAMAGE_RECTS];
+    int r, count = 0;
+
+    if (con_shadow == NULL || con_shadow_w != screen->w
+            || con_shadow_h != screen->h) {
+        free (con_shadow);
+        con_shadow = malloc (screen->w * screen->h *
+                screen->format->BytesPerPixel);
+        if (con_shadow == NULL) {
+            perror (__func__);
+            SDL_UpdateRects (screen, numrects, rects);
+            return;
+        }
+        con_shadow_w = screen->w;
+        con_shadow_h = screen->h;
+        con_shadow_valid = 0;
+    }
+    if (con_shadow_valid == 0) {
+        /* Display contents are unknown, send everything */
+        SDL_Rect all = {0, 0, screen->w, screen->h};
+        find_damage (&all, damage, 0);
+        SDL_UpdateRect (screen, 0, 0, 0, 0);
+        con_shadow_valid = 1;
+        return;
+    }
+    for (r = 0; r < numrects; r++) {
+        if (count == MAX_DAMAGE_RECTS) {
+            SDL_UpdateRects (screen, count, damage);
+            count = 0;
+        }
+        count = find_damage (&rects[r], damage, count);
+    }
+    if (count)
+        SDL_UpdateRects (screen, count, damage);
+}
+
+/* Update the changed parts of a screen rectangle */
+void update_screen_rect (int x, int y, int w, int h)
+{
+    SDL_Rect rect;
+    if (x == 0 && y == 0 && w == 0 && h == 0) {
+        w = screen->w;
+        h = screen->h;
+    }
+    rect.x = x;
+    rect.y = y;
+    rect.w = w;
+    rect.h = h;
+    update_screen_rects (1, &rect);
+}
+
+/* The display contents are unknown, next update will cover everything */
+void invalidate_screen (void)
+{
+    con_shadow_valid = 0;
+}
+
 /* Display an error message */
 void error_screen(const char *title, const char *exitmsg, const char *message[]) {
     SDL_Rect r1, r2;
@@ -509,7 +733,7 @@ void error_screen(const char *title, const char *exitmsg, const char *message[])
     
     centered_string(screen,Bigfont, r2.y + r2.h - font_height(Bigfont),
             exitmsg, font_color_red);
-    SDL_UpdateRect (screen, r1.x, r1.y, r1.w, r1.h);
+    update_screen_rect (r1.x, r1.y, r1.w, r1.h);
     wait_for_enter();
 
 }
@@ -75,6 +75,15 @@ extern void close_joypads();
 /* Toggle between fullscreen and windowed mode */
 extern void toggle_fullscreen(void);
 
+/* Update the display. Only the parts of the rectangles that have */
+/* changed since the last update are sent. A 0,0,0,0 rectangle */
+/* means the whole screen, like with SDL_UpdateRect */
+extern void update_screen_rects (int numrects, SDL_Rect *rects);
+extern void update_screen_rect (int x, int y, int w, int h);
+
+/* Forget what is on the display. The next update covers everything */
+extern void invalidate_screen (void);
+
 /* Map color to RGBA value in current pixel format. Generates a */
 /* SDL_gfx compatible value if SDL_gfx is used. */
 extern Uint32 map_rgba(Uint8 r,Uint8 g,Uint8 b,Uint8 a);
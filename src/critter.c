@@ -32,6 +32,7 @@
 #include "game.h"
 #include "list.h"
 #include "ship.h"
+#include "nav.h"
 #include "fs.h"
 
 #include "audio.h"
@@ -166,10 +167,22 @@ static void shatter(struct Critter *critter) {
             critter->physics.vel,make_snowflake);
 }
 
+/* Check if there is ground to walk on in the direction */
+/* according to the navigation grid */
+static int gc_can_walk(struct Critter *critter, int dir) {
+    return nav_ground_run(Round(critter->walker.physics.x),
+            Round(critter->walker.physics.y), dir, 2) == 2;
+}
+
 /* Timer function: change ground critter walking direction */
 static void gc_dosomething(struct Critter *critter) {
     /* Decisions, 0 stay still, 1 walk left, 2 walk right */
     int decision = rand()%3;
+    /* Don't walk into a dead end if there is somewhere else to go */
+    if(decision==1 && !gc_can_walk(critter,-1) && gc_can_walk(critter,1))
+        decision = 2;
+    else if(decision==2 && !gc_can_walk(critter,1) && gc_can_walk(critter,-1))
+        decision = 1;
     switch(decision) {
         case 0: critter->walker.walking = 0; break;
         case 1:
@@ -194,16 +207,20 @@ static void gc_flee(struct Critter *critter) {
         int enemy = find_nearest_enemy(critter->walker.physics.x,
                 critter->walker.physics.y, critter->owner, &distance);
         if(distance<200.0) {
+            int dir;
             critter->walker.walkspeed = 3;
-            if(players[enemy].ship->physics.x < critter->walker.physics.x) {
-                if(critter->walker.walking<0)
-                    critter->cornered+=1;
-                critter->walker.walking = 1;
-            } else {
-                if(critter->walker.walking>0)
-                    critter->cornered+=1;
-                critter->walker.walking = -1;
+            if(players[enemy].ship->physics.x < critter->walker.physics.x)
+                dir = 1;
+            else
+                dir = -1;
+            /* Nowhere to run, the only way is past the enemy */
+            if(!gc_can_walk(critter,dir) && gc_can_walk(critter,-dir)) {
+                dir = -dir;
+                critter->cornered+=1;
             }
+            if(critter->walker.walking == -dir)
+                critter->cornered+=1;
+            critter->walker.walking = dir;
         } else {
             critter->walker.walkspeed = 1;
         }
@@ -258,18 +275,16 @@ static void gc_die(struct Critter *critter) {
 /* Air/water critter timer function: search a new target to go to */
 static void ac_searchtarget(struct Critter *critter) {
     unsigned int loops=0;
-    int newx,newy,tmp;
+    int newx,newy;
     int oldx = Round(critter->physics.x);
     int oldy = Round(critter->physics.y);
+    int medium = critter->type==AIRCRITTER?NAV_AIR:NAV_WATER;
 
-    /* Search for a new target that doesn't go thru solid terrain */
+    /* Search for a new target that can be reached in a straight line */
     do {
         newx = oldx + 200-rand()%400;
         newy = oldy + 200-rand()%400;
-    } while(((critter->type==AIRCRITTER?is_water(newx,newy):is_free(newx,newy))
-            || hit_solid_line(oldx,oldy,newx,newy,&tmp,&tmp)
-            != (critter->type==AIRCRITTER?TER_FREE:TER_WATER))
-            && loops++<100);
+    } while(nav_clear_path(oldx,oldy,newx,newy,medium)==0 && loops++<100);
 
     critter->flyer.targx = newx;
     critter->flyer.targy = newy;
@@ -311,18 +326,21 @@ static struct Critter *find_enemy_critter(float x,float y,int owner, double *dis
 
 /* Search for a target to shoot at */
 /* Set airborne to zero to limit targets to those that can be easily */
-/* shot at from ground */
+/* shot at from ground. If targplr is given, it is set to the player */
+/* whose ship was chosen, or -1 if the target is something else */
 static int find_target(float x, float y, int owner, float *targx, float *targy,
-        double *dist, int airborne) {
+        double *dist, int airborne, int *targplr) {
     double distance;
     int eplr;
     struct Critter *ec;
+    if(targplr) *targplr = -1;
     /* First priority, enemy ships */
     eplr = find_nearest_enemy(x,y, owner, &distance);
     if(distance < 120.0) {
         *targx = players[eplr].ship->physics.x;
         *targy = players[eplr].ship->physics.y;
         if(dist) *dist = distance;
+        if(targplr) *targplr = eplr;
         return 1;
     }
     /* Second priority, enemy helicopters */
@@ -361,7 +379,7 @@ static void soldier_animate(struct Critter *soldier) {
     else if(soldier->ff==0 || soldier->cornered>60.0) {
         float targx,targy;
         if(find_target(soldier->physics.x, soldier->physics.y,
-                    soldier->owner, &targx, &targy, NULL, 0))
+                    soldier->owner, &targx, &targy, NULL, 0, NULL))
         {
             if(critter_shoot(soldier,atan2(targy-soldier->physics.y,targx-soldier->physics.x))) {
                 soldier->walker.walking = 0;
@@ -381,12 +399,19 @@ static void helicopter_animate(struct Critter *hc) {
     else if(hc->ff==0) {
         double distance;
         float targx,targy;
+        int targplr;
         if(find_target(hc->physics.x,hc->physics.y, hc->owner, &targx, &targy,
-                    &distance, 1))
+                    &distance, 1, &targplr))
         {
             if(distance>60.0) {
-                hc->flyer.targx = targx;
-                hc->flyer.targy = targy;
+                /* Find the way around terrain to enemy ships */
+                if(targplr<0 || nav_towards_player(targplr, NAV_AIR,
+                            Round(hc->physics.x), Round(hc->physics.y),
+                            &hc->flyer.targx, &hc->flyer.targy)==0)
+                {
+                    hc->flyer.targx = targx;
+                    hc->flyer.targy = targy;
+                }
             }
             if(distance<150.0) {
                 if(critter_shoot(hc,atan2(targy-hc->physics.y,targx-hc->physics.x))) {
@@ -454,17 +479,20 @@ static void bat_animate(struct Critter *bat) {
         double d;
         struct Ship *targ = find_nearest_ship(bat->physics.x,bat->physics.y,NULL,&d);
         if(d<200.0) {
-            bat->flyer.targx = targ->physics.x;
-            bat->flyer.targy = targ->physics.y;
-            if(d<20.0) {
-                int p=0;
-                for(;p<4;p++) {
-                    if(players[p].ship == targ) {
-                        bat_harass_player(bat,p);
-                        break;
-                    }
-                }
+            int p;
+            for(p=0;p<4;p++)
+                if(players[p].ship == targ)
+                    break;
+            /* Follow the flow field to player ships */
+            if(p==4 || nav_towards_player(p, NAV_AIR,
+                        Round(bat->physics.x), Round(bat->physics.y),
+                        &bat->flyer.targx, &bat->flyer.targy)==0)
+            {
+                bat->flyer.targx = targ->physics.x;
+                bat->flyer.targy = targ->physics.y;
             }
+            if(d<20.0 && p<4)
+                bat_harass_player(bat,p);
         } else if(bat->timer<0) {
             bat->timer = 2*GAME_SPEED + rand()%(2*GAME_SPEED);
         }
@@ -885,6 +913,7 @@ static void animate_watercritter(struct Critter *critter) {
 /* Animate critters */
 void animate_critters (void) {
     struct dllist *list = critter_list;
+    update_nav();
     while (list) {
         struct Critter *critter=list->data;
         switch(critter->type) {
@@ -30,6 +30,7 @@
 #include "level.h"
 #include "player.h"
 #include "decor.h"
+#include "points.h"
 
 #define SNOWFLAKE_INTERVAL      20
 #define MAX_WIND_TIME	400     /* Maximium time in frames that a breeze can last */
@@ -43,6 +44,7 @@ struct SnowSource {
 
 /* Internally used globals */
 static struct dllist *decor_list;
+static struct PointBatch decor_points;
 static struct SnowSource snowsource[32];
 static int weather_wind_targ_vector;
 static int weather_windy=1;
@@ -161,24 +163,6 @@ void add_splash (double x, double y, double f,int count, Vector v,
     }
 }
 
-/* Draw on screen */
-static inline void draw_decor(struct Decor *d)
-{
-    int x, y, p;
-    for (p = 0; p < 4; p++) {
-        if (players[p].state==ALIVE || players[p].state==DEAD) {
-            x = Round(d->physics.x) - cam_rects[p].x + viewport_rects[p].x;
-            y = Round(d->physics.y) - cam_rects[p].y + viewport_rects[p].y;
-            if ((x > viewport_rects[p].x &&
-                        x < viewport_rects[p].x + cam_rects[p].w) &&
-                    (y > viewport_rects[p].y &&
-                     y < viewport_rects[p].y + cam_rects[p].h)) {
-                putpixel (screen, x, y, d->color);
-            }
-        }
-    }
-}
-
 /* Create new snow */
 static void snowfall(void) {
     static const int sscount = sizeof(snowsource)/sizeof(struct SnowSource);
@@ -258,9 +242,11 @@ void animate_decorations(void) {
             else
                 dllist_remove(list);
         } else {
-            draw_decor(d);
+            add_point(&decor_points, Round(d->physics.x), Round(d->physics.y),
+                    d->color);
         }
         list = next;
     }
+    draw_points(&decor_points);
 }
 
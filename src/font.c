@@ -92,8 +92,7 @@ static inline void set_proper_font (FontInfo * fi, FontSize size)
 #ifdef HAVE_LIBSDL_TTF
 /* Load the font configuration file */
 static int load_font_cfg (const char *filename) {
-    struct dllist *fontcfg;
-    struct ConfigBlock *block;
+    struct ConfigFile *fontcfg;
     struct Translate tr[] = {
         {"bigfont", CFG_STRING, &TruetypeFonts.bigfont},
         {"smallfont", CFG_STRING, &TruetypeFonts.smallfont},
@@ -105,11 +104,9 @@ static int load_font_cfg (const char *filename) {
     fontcfg = read_config_file(filename,1);
     if(!fontcfg) return 1;
 
-    block=fontcfg->data;
+    translate_config(&fontcfg->blocks[0],tr,0);
 
-    translate_config(block->values,tr,0);
-
-    dllist_free(fontcfg,free_config_file);
+    free_config_file(fontcfg);
     
     if(TruetypeFonts.bigfont==NULL) {
         printf("Error: bigfont not specified\n");
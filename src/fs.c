@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -34,6 +35,7 @@
 
 #include "console.h"
 #include "fs.h"
+#include "jobs.h"
 #include "lcmap.h"
 
 /* Paths */
@@ -49,6 +51,52 @@
 
 #define HOME_PATH "luola/"
 
+/* An image that is being decoded by a worker thread */
+typedef struct {
+    LDAT_Block *block;
+    SDL_RWops *rw;
+    SDL_Surface *image;
+    Job *job;
+} Preload;
+
+static LDAT *fs_preload_ldat;
+static Preload *fs_preload;
+static int fs_preload_count;
+static int *fs_preload_slots;   /* Preload indices hashed by block, -1 if empty */
+static Uint32 fs_preload_mask;  /* Number of hash slots - 1 */
+
+/* Image cache. The cache is only read on the machine that wrote it, */
+/* so everything is in native byte order */
+#define IMAGE_CACHE_FILE "imagecache"
+#define IMAGE_CACHE_VERSION 1
+#define CACHE_ID_LEN 32
+
+struct CacheHeader {
+    char magic[4];                  /* "LICH" */
+    Uint32 version;
+    Uint32 srcsize, srcmtime;       /* Source archive */
+    Uint32 bpp, Rmask, Gmask, Bmask;/* Screen format */
+    Uint32 count;                   /* Number of entries */
+};
+
+/* Cache entry. pitch*h bytes of pixels follow, padded to 4 bytes */
+struct CacheEntry {
+    char id[CACHE_ID_LEN];
+    Sint32 index, variant;
+    Uint32 w, h, pitch, bpp;
+    Uint32 flags, colorkey, alpha;
+    Uint32 Rmask, Gmask, Bmask, Amask;
+};
+
+static LDAT *fs_cache_ldat;         /* Archive whose images are cached */
+static struct CacheHeader fs_cache_header;
+static Uint8 *fs_cache_data;        /* A valid cache file */
+static struct CacheEntry **fs_cache_entries; /* Entries hashed by key */
+static Uint32 fs_cache_mask;        /* Number of hash slots - 1 */
+static Uint8 *fs_cache_out;         /* Entries for a new cache file */
+static Uint32 fs_cache_outlen, fs_cache_outsize;
+static int fs_cache_stale;          /* Cache must be rebuilt */
+
 /* Get the full path of a filename */
 const char *getfullpath (DataDir dir,const char *filename)
 {
@@ -220,16 +268,24 @@ static SDL_Surface *load_luola_image_rw (SDL_RWops * rw)
     return image;
 }
 
-/* Load an image from SDL_RWops */
-SDL_Surface *load_image_rw (SDL_RWops * rw, int allownull,
-                            Transparency transparency)
+/* Decode an image without converting it */
+static SDL_Surface *decode_image_rw (SDL_RWops * rw)
 {
-    SDL_Surface *tmp, *conv = NULL;
+    SDL_Surface *image;
 
     /* Check if Luola can load the image itself (LCMAP ?) */
-    tmp = load_luola_image_rw (rw);
-    if (tmp == NULL) /* If not, then use SDL_image */
-        tmp = IMG_Load_RW (rw, 0);
+    image = load_luola_image_rw (rw);
+    if (image == NULL) /* If not, then use SDL_image */
+        image = IMG_Load_RW (rw, 0);
+    return image;
+}
+
+/* Set transparency and convert a decoded image to screen format */
+static SDL_Surface *convert_image (SDL_Surface * tmp, int allownull,
+                                   Transparency transparency)
+{
+    SDL_Surface *conv = NULL;
+
     if (tmp == NULL) {
         if (allownull == 0) {
             fprintf (stderr,"Unable to load image from SDL_RWops\n%s\n",
@@ -283,6 +339,353 @@ SDL_Surface *load_image_rw (SDL_RWops * rw, int allownull,
     return conv;
 }
 
+/* Load an image from SDL_RWops */
+SDL_Surface *load_image_rw (SDL_RWops * rw, int allownull,
+                            Transparency transparency)
+{
+    return convert_image (decode_image_rw (rw), allownull, transparency);
+}
+
+/* Worker thread job to decode a preloaded image */
+static void decode_preload (void *arg)
+{
+    Preload *p = arg;
+    p->image = decode_image_rw (p->rw);
+}
+
+/* Hash slot of a catalog block */
+static Uint32 preload_hash (const LDAT_Block * block)
+{
+    return ((size_t) block / sizeof (LDAT_Block)) * 2654435761u;
+}
+
+/* Start decoding all images in an LDAT file */
+void preload_images (LDAT * datafile)
+{
+    LDAT_Block *block;
+    Uint32 size = 16, h;
+    int r = 0;
+    if (fs_preload_ldat)
+        end_preload ();
+    while (size < datafile->items * 2u)
+        size <<= 1;
+    fs_preload = malloc (sizeof (Preload) * datafile->items);
+    fs_preload_slots = malloc (sizeof (int) * size);
+    if (fs_preload == NULL || fs_preload_slots == NULL) {
+        perror (__func__);
+        free (fs_preload);
+        free (fs_preload_slots);
+        fs_preload = NULL;
+        fs_preload_slots = NULL;
+        return;
+    }
+    memset (fs_preload_slots, 0xff, sizeof (int) * size);
+    fs_preload_mask = size - 1;
+    for (block = datafile->catalog; block; block = block->next) {
+        /* The index is the packing list, not an image */
+        if (strcmp (block->ID, "INDEX") == 0)
+            continue;
+        fs_preload[r].rw = ldat_open_item (datafile, block->ID, block->index);
+        if (fs_preload[r].rw == NULL)
+            continue;
+        fs_preload[r].block = block;
+        fs_preload[r].image = NULL;
+        fs_preload[r].job = add_job (decode_preload, &fs_preload[r]);
+        h = preload_hash (block) & fs_preload_mask;
+        while (fs_preload_slots[h] >= 0)
+            h = (h + 1) & fs_preload_mask;
+        fs_preload_slots[h] = r;
+        r++;
+    }
+    fs_preload_ldat = datafile;
+    fs_preload_count = r;
+}
+
+/* Get a preloaded image. Returns NULL if it is not available */
+static SDL_Surface *take_preload (LDAT * datafile, const char *id, int index)
+{
+    SDL_Surface *image;
+    LDAT_Block *block;
+    Uint32 h;
+    int r;
+    if (datafile != fs_preload_ldat)
+        return NULL;
+    block = ldat_find_item (datafile, id, index);
+    if (block == NULL)
+        return NULL;
+    for (h = preload_hash (block) & fs_preload_mask;
+            (r = fs_preload_slots[h]) >= 0; h = (h + 1) & fs_preload_mask) {
+        if (fs_preload[r].block == block) {
+            if (fs_preload[r].job) {
+                finish_job (fs_preload[r].job);
+                fs_preload[r].job = NULL;
+            }
+            image = fs_preload[r].image;
+            fs_preload[r].image = NULL;
+            return image;
+        }
+    }
+    return NULL;
+}
+
+/* Wait for the preload jobs to finish and free unused images */
+void end_preload (void)
+{
+    int r;
+    for (r = 0; r < fs_preload_count; r++) {
+        if (fs_preload[r].job)
+            finish_job (fs_preload[r].job);
+        if (fs_preload[r].image)
+            SDL_FreeSurface (fs_preload[r].image);
+        SDL_FreeRW (fs_preload[r].rw);
+    }
+    free (fs_preload);
+    free (fs_preload_slots);
+    fs_preload = NULL;
+    fs_preload_slots = NULL;
+    fs_preload_ldat = NULL;
+    fs_preload_count = 0;
+}
+
+/* Length of a cache entry with its pixels */
+static Uint32 cache_entry_len (Uint32 pitch, Uint32 h)
+{
+    return sizeof (struct CacheEntry) + ((pitch * h + 3) & ~3);
+}
+
+/* Hash a cache entry key */
+static Uint32 cache_hash (const char *id, int index, int variant)
+{
+    Uint32 hash = 5381;
+    while (*id)
+        hash = hash * 33 + (Uint8) *id++;
+    return hash + index * 2654435761u + variant * 40503u;
+}
+
+/* Open the image cache for an archive */
+int open_image_cache (LDAT * datafile, const char *archive)
+{
+    struct CacheHeader *header;
+    struct CacheEntry *entry;
+    struct stat st;
+    Uint8 *ptr, *end;
+    FILE *fp;
+    long len;
+    Uint32 r, h, size = 16;
+
+    if (fs_cache_ldat)
+        close_image_cache ();
+    if (stat (archive, &st))
+        return 0;
+    fs_cache_ldat = datafile;
+    memset (&fs_cache_header, 0, sizeof (struct CacheHeader));
+    memcpy (fs_cache_header.magic, "LICH", 4);
+    fs_cache_header.version = IMAGE_CACHE_VERSION;
+    fs_cache_header.srcsize = st.st_size;
+    fs_cache_header.srcmtime = st.st_mtime;
+    fs_cache_header.bpp = screen->format->BitsPerPixel;
+    fs_cache_header.Rmask = screen->format->Rmask;
+    fs_cache_header.Gmask = screen->format->Gmask;
+    fs_cache_header.Bmask = screen->format->Bmask;
+
+    /* Read the whole cache at once */
+    fp = fopen (getfullpath (HOME_DIRECTORY, IMAGE_CACHE_FILE), "rb");
+    if (fp == NULL)
+        return 0;
+    fseek (fp, 0, SEEK_END);
+    len = ftell (fp);
+    rewind (fp);
+    if (len < (long) sizeof (struct CacheHeader)) {
+        fclose (fp);
+        return 0;
+    }
+    fs_cache_data = malloc (len);
+    if (fs_cache_data == NULL || fread (fs_cache_data, 1, len, fp) != len) {
+        fclose (fp);
+        free (fs_cache_data);
+        fs_cache_data = NULL;
+        return 0;
+    }
+    fclose (fp);
+
+    /* Check that the cache was made for this archive and screen */
+    header = (struct CacheHeader *) fs_cache_data;
+    if (memcmp (header, &fs_cache_header,
+                offsetof (struct CacheHeader, count)) ||
+            header->count > len / sizeof (struct CacheEntry))
+        goto invalid;
+    while (size < header->count * 2u)
+        size <<= 1;
+    fs_cache_entries = calloc (size, sizeof (struct CacheEntry *));
+    if (fs_cache_entries == NULL)
+        goto invalid;
+    fs_cache_mask = size - 1;
+    ptr = fs_cache_data + sizeof (struct CacheHeader);
+    end = fs_cache_data + len;
+    for (r = 0; r < header->count; r++) {
+        entry = (struct CacheEntry *) ptr;
+        if (end - ptr < (long) sizeof (struct CacheEntry) ||
+                entry->pitch < entry->w * (entry->bpp / 8) ||
+                end - ptr < (long) cache_entry_len (entry->pitch, entry->h))
+            goto invalid;
+        entry->id[CACHE_ID_LEN - 1] = '\0';
+        h = cache_hash (entry->id, entry->index, entry->variant) &
+            fs_cache_mask;
+        while (fs_cache_entries[h])
+            h = (h + 1) & fs_cache_mask;
+        fs_cache_entries[h] = entry;
+        ptr += cache_entry_len (entry->pitch, entry->h);
+    }
+    fs_cache_header.count = header->count;
+    return 1;
+
+  invalid:
+    free (fs_cache_entries);
+    free (fs_cache_data);
+    fs_cache_entries = NULL;
+    fs_cache_data = NULL;
+    return 0;
+}
+
+/* Get an image from the image cache */
+SDL_Surface *get_cached_image (const char *id, int index, int variant)
+{
+    struct CacheEntry *entry = NULL;
+    SDL_Surface *image;
+    Uint8 *pixels;
+    Uint32 r;
+    if (fs_cache_data == NULL)
+        return NULL;
+    for (r = cache_hash (id, index, variant) & fs_cache_mask;
+            fs_cache_entries[r]; r = (r + 1) & fs_cache_mask) {
+        if (fs_cache_entries[r]->index == index &&
+                fs_cache_entries[r]->variant == variant &&
+                strcmp (fs_cache_entries[r]->id, id) == 0) {
+            entry = fs_cache_entries[r];
+            break;
+        }
+    }
+    if (entry == NULL)
+        return NULL;
+    image = SDL_CreateRGBSurface (SDL_SWSURFACE, entry->w, entry->h,
+            entry->bpp, entry->Rmask, entry->Gmask, entry->Bmask,
+            entry->Amask);
+    if (image == NULL)
+        return NULL;
+    pixels = (Uint8 *) (entry + 1);
+    for (r = 0; r < entry->h; r++)
+        memcpy ((Uint8 *) image->pixels + r * image->pitch,
+                pixels + r * entry->pitch, entry->w * (entry->bpp / 8));
+    if (entry->flags & SDL_SRCCOLORKEY)
+        SDL_SetColorKey (image, entry->flags &
+                (SDL_SRCCOLORKEY | SDL_RLEACCEL), entry->colorkey);
+    if (entry->flags & SDL_SRCALPHA)
+        SDL_SetAlpha (image, entry->flags & (SDL_SRCALPHA | SDL_RLEACCEL),
+                entry->alpha);
+    else if (image->flags & SDL_SRCALPHA)
+        SDL_SetAlpha (image, 0, SDL_ALPHA_OPAQUE);
+    return image;
+}
+
+/* Store an image in the image cache */
+void cache_image (const char *id, int index, int variant,
+                  SDL_Surface * image)
+{
+    struct CacheEntry *entry;
+    Uint32 len;
+    if (fs_cache_ldat == NULL || fs_cache_stale || image == NULL ||
+            image->format->BytesPerPixel < 2 || strlen (id) >= CACHE_ID_LEN)
+        return;
+    if (fs_cache_data) {
+        /* The cache is missing an image, so rebuild it next time */
+        fs_cache_stale = 1;
+        return;
+    }
+    len = cache_entry_len (image->pitch, image->h);
+    if (fs_cache_outlen + len > fs_cache_outsize) {
+        Uint32 newsize = fs_cache_outsize ? fs_cache_outsize : 256 * 1024;
+        Uint8 *out;
+        while (newsize < fs_cache_outlen + len)
+            newsize *= 2;
+        out = realloc (fs_cache_out, newsize);
+        if (out == NULL) {
+            perror (__func__);
+            fs_cache_stale = 1;
+            return;
+        }
+        fs_cache_out = out;
+        fs_cache_outsize = newsize;
+    }
+    entry = (struct CacheEntry *) (fs_cache_out + fs_cache_outlen);
+    memset (entry, 0, len);
+    strcpy (entry->id, id);
+    entry->index = index;
+    entry->variant = variant;
+    entry->w = image->w;
+    entry->h = image->h;
+    entry->pitch = image->pitch;
+    entry->bpp = image->format->BitsPerPixel;
+    entry->flags = image->flags & (SDL_SRCCOLORKEY | SDL_SRCALPHA |
+            SDL_RLEACCEL);
+    entry->colorkey = image->format->colorkey;
+    entry->alpha = image->format->alpha;
+    entry->Rmask = image->format->Rmask;
+    entry->Gmask = image->format->Gmask;
+    entry->Bmask = image->format->Bmask;
+    entry->Amask = image->format->Amask;
+    SDL_LockSurface (image);
+    memcpy (entry + 1, image->pixels, image->pitch * image->h);
+    SDL_UnlockSurface (image);
+    fs_cache_outlen += len;
+    fs_cache_header.count++;
+}
+
+/* Write the image cache if it was rebuilt and free it */
+void close_image_cache (void)
+{
+    char path[PATH_MAX], tmppath[PATH_MAX + 4];
+    FILE *fp;
+    strncpy (path, getfullpath (HOME_DIRECTORY, IMAGE_CACHE_FILE),
+            PATH_MAX - 1);
+    path[PATH_MAX - 1] = '\0';
+    if (fs_cache_stale) {
+        remove (path);
+    } else if (fs_cache_out) {
+        /* Write to a temporary file first so a broken cache is never seen */
+        sprintf (tmppath, "%s.tmp", path);
+        fp = fopen (tmppath, "wb");
+        if (fp == NULL) {
+            perror (tmppath);
+        } else {
+            if (fwrite (&fs_cache_header, sizeof (struct CacheHeader), 1,
+                        fp) != 1 ||
+                    fwrite (fs_cache_out, 1, fs_cache_outlen, fp) !=
+                    fs_cache_outlen) {
+                perror (tmppath);
+                fclose (fp);
+                remove (tmppath);
+            } else {
+                fclose (fp);
+#ifdef WIN32
+                remove (path);
+#endif
+                if (rename (tmppath, path))
+                    perror (path);
+            }
+        }
+    }
+    free (fs_cache_entries);
+    free (fs_cache_data);
+    free (fs_cache_out);
+    fs_cache_entries = NULL;
+    fs_cache_data = NULL;
+    fs_cache_out = NULL;
+    fs_cache_outlen = 0;
+    fs_cache_outsize = 0;
+    fs_cache_stale = 0;
+    fs_cache_ldat = NULL;
+}
+
 /* Load an array of images with sequential index numbers from an LDAT file */
 /* count is set to the number of images read. */
 SDL_Surface **load_image_array (LDAT * datafile, int allownull,
@@ -290,7 +693,6 @@ SDL_Surface **load_image_array (LDAT * datafile, int allownull,
                                 int *count)
 {
     SDL_Surface **surfaces;
-    SDL_RWops *data;
     int r;
     *count = ldat_get_item_count(datafile, id);
     if(*count==0) {
@@ -301,10 +703,9 @@ SDL_Surface **load_image_array (LDAT * datafile, int allownull,
         return NULL;
     }
     surfaces = malloc (sizeof (SDL_Surface *) * (*count));
-    for (r=0;r<*count;r++) {
-        data = ldat_get_item (datafile, id, r);
-        surfaces[r] = load_image_rw (data, allownull, transparency);
-    }
+    for (r=0;r<*count;r++)
+        surfaces[r] = load_image_ldat (datafile, allownull, transparency,
+                id, r);
     return surfaces;
 }
 
@@ -313,14 +714,28 @@ SDL_Surface *load_image_ldat (LDAT * datafile, int allownull,
                               Transparency transparency, const char *id,
                               int index)
 {
+    SDL_Surface *image;
     SDL_RWops *data;
-    data = ldat_get_item (datafile, id, index);
-    if (data == NULL) {
-        if (allownull)
-            return NULL;
-        exit (1);
+    if (datafile == fs_cache_ldat) {
+        image = get_cached_image (id, index, transparency);
+        if (image)
+            return image;
+    }
+    image = take_preload (datafile, id, index);
+    if (image) {
+        image = convert_image (image, allownull, transparency);
+    } else {
+        data = ldat_get_item (datafile, id, index);
+        if (data == NULL) {
+            if (allownull)
+                return NULL;
+            exit (1);
+        }
+        image = load_image_rw (data, allownull, transparency);
     }
-    return load_image_rw (data, allownull, transparency);
+    if (datafile == fs_cache_ldat)
+        cache_image (id, index, transparency, image);
+    return image;
 }
 
 /* Take a screenshot and save it in the home directory */
@@ -59,6 +59,33 @@ extern SDL_Surface *load_image (const char *filename, int allownull,
 extern SDL_Surface *load_image_rw (SDL_RWops * rw, int allownull,
                                    Transparency transparency);
 
+/* Start decoding all images in an LDAT file on the worker threads. */
+/* load_image_ldat and load_image_array will then use the decoded images */
+/* and only convert them to screen format. */
+/* Does nothing unless the file is memory mapped or compressed */
+extern void preload_images (LDAT * datafile);
+
+/* Wait for the preloaded images and free the unused ones. */
+/* Must be called before the LDAT file is freed */
+extern void end_preload (void);
+
+/* Open the image cache for an archive. Images loaded from the archive */
+/* with load_image_ldat and load_image_array are stored in the cache */
+/* already in screen format. Returns nonzero if a valid cache was found */
+extern int open_image_cache (LDAT * datafile, const char *archive);
+
+/* Get an image from the image cache. variant tells apart different */
+/* versions of the same item. Returns NULL if the image is not cached */
+extern SDL_Surface *get_cached_image (const char *id, int index,
+                                      int variant);
+
+/* Store a copy of an image in the image cache */
+extern void cache_image (const char *id, int index, int variant,
+                         SDL_Surface * image);
+
+/* Write the image cache if it was rebuilt and close it */
+extern void close_image_cache (void);
+
 /* Load an array of images with sequential index numbers from an LDAT file. */
 /* count is set to the number of images read. */
 extern SDL_Surface **load_image_array (LDAT * datafile, int allownull,
@@ -25,6 +25,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <dirent.h>
+#ifndef WIN32
+#include <sys/time.h>
+#endif
 #include <SDL.h>
 
 #include "startup.h"
@@ -40,6 +43,12 @@
 #include "parser.h"
 #include "audio.h"
 
+/* Maximum number of frames to simulate in a row when catching up */
+#define MAX_CATCHUP_FRAMES 4
+
+/* How long before the deadline to stop sleeping and start spinning (us) */
+#define SPIN_TIME 2000
+
 /* Some globals */
 static SDL_Surface *gam_filler;
 GameInfo game_settings;
@@ -304,7 +313,7 @@ void game_statistics (void)
     /* Draw the "press enter to continue" message */
     centered_string (screen, Bigfont, rect.y + rect.h - 30,
                      "Press enter to continue", font_color_white);
-    SDL_UpdateRect (screen, rect.x, rect.y, rect.w, rect.h);
+    update_screen_rect (rect.x, rect.y, rect.w, rect.h);
     /* Wait for Enter to be pressed */
     wait_for_enter();
 }
@@ -328,15 +337,37 @@ void fill_player_screens (void) {
     } else {
         SDL_FillRect (screen, NULL, 0);
     }
-    SDL_UpdateRect (screen, 0, 0, 0, 0);
+    update_screen_rect (0, 0, 0, 0);
+}
+
+/* Get current time in microseconds */
+Uint64 get_time_us (void) {
+#ifndef WIN32
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (Uint64) tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+    return (Uint64) SDL_GetTicks () * 1000;
+#endif
+}
+
+/* Wait until the deadline. SDL_Delay only has millisecond granularity */
+/* and tends to oversleep, so the last bit is spent spinning. */
+static void wait_until (Uint64 deadline) {
+    Uint64 now = get_time_us ();
+    if (now + SPIN_TIME < deadline)
+        SDL_Delay ((deadline - now - SPIN_TIME) / 1000);
+    while (get_time_us () < deadline) {}
 }
 
 /* Ingame event loop */
 void game_eventloop (void) {
     SDL_Event Event;
-    Uint32 lasttime = SDL_GetTicks (), delay;
+    Uint64 frame_len = GAME_SPEED * 1000, next_frame, now;
     Uint8 is_not_paused = 1;
+    int frames;
     game_loop = 1;
+    next_frame = get_time_us ();
     while (game_loop) {
         while (SDL_PollEvent (&Event)) {
             switch (Event.type) {
@@ -386,6 +417,9 @@ void game_eventloop (void) {
             case SDL_JOYAXISMOTION:
                 player_joyaxishandler (&Event.jaxis);
                 break;
+            case SDL_VIDEOEXPOSE:
+                invalidate_screen ();
+                break;
             case SDL_QUIT:
                 exit(0);
             default:
@@ -393,14 +427,21 @@ void game_eventloop (void) {
             }
         }
         if (is_not_paused) {
-            lasttime = SDL_GetTicks ();
-            animate_frame ();
-            delay = SDL_GetTicks () - lasttime;
-            if (delay >= GAME_SPEED)
-                delay = 0;
-            else
-                delay = GAME_SPEED - delay;
-            SDL_Delay (delay);
+            /* Run the simulation at a fixed rate. If we have fallen */
+            /* behind, run extra frames without updating the screen. */
+            now = get_time_us ();
+            for (frames = 0; frames < MAX_CATCHUP_FRAMES && game_loop
+                    && now >= next_frame; frames++) {
+                next_frame += frame_len;
+                animate_frame (now < next_frame
+                        || frames == MAX_CATCHUP_FRAMES - 1);
+            }
+            /* Too far behind, give up catching up */
+            if (now >= next_frame)
+                next_frame = now + frame_len;
+            wait_until (next_frame);
+        } else {
+            next_frame = get_time_us ();
         }
     }
 }
@@ -468,7 +509,7 @@ void save_game_config (void)
 }
 
 /* Parse configuration file settings block */
-static void parse_settings_block(struct dllist *values) {
+static void parse_settings_block(const struct ConfigBlock *block) {
     struct Translate tr[] = {
         {"indestructable_base", CFG_INT, &game_settings.ls.indstr_base},
         {"regenerate_base", CFG_INT, &game_settings.base_regen},
@@ -503,57 +544,56 @@ static void parse_settings_block(struct dllist *values) {
         {"bigscreens", CFG_INT, &game_settings.bigscreens},
         {0,0,0}
     };
-    translate_config(values,tr,0);
+    translate_config(block,tr,0);
 }
 
-static void parse_controllers_block(struct dllist *values) {
-    while(values) {
-        struct KeyValue *pair=values->data;
+static void parse_controllers_block(const struct ConfigBlock *block) {
+    int r;
+    for(r=0;r<block->count;r++) {
+        const struct KeyValue *pair=&block->values[r];
         int plr=atoi(pair->key);
         if(plr<0 || plr>3) {
             printf("No such player (%d)\n",plr);
         } else {
             game_settings.controller[plr].number = atoi (pair->value);
         }
-        values=values->next;
     }
 }
 
-static void parse_keys_block(struct dllist *values,int player) {
-    while(values) {
-        struct KeyValue *pair=values->data;
+static void parse_keys_block(const struct ConfigBlock *block,int player) {
+    int r;
+    for(r=0;r<block->count;r++) {
+        const struct KeyValue *pair=&block->values[r];
         int key;
         key=atoi(pair->key);
         if(key<0 || key>5)
             printf("No such key (%d)\n",key);
         else
             game_settings.controller[player].keys[key] = atoi (pair->value);
-        values=values->next;
     }
 }
 
 /* Load game configuration */
 static void load_game_config (void) {
-    struct dllist *gamecfg,*cfgptr;
-    
+    struct ConfigFile *gamecfg;
+    int b;
+
     gamecfg=read_config_file(getfullpath(HOME_DIRECTORY,"luola.cfg"),0);
     if(!gamecfg) {
         printf("Couldn't load configuration file. Using built in defaults.\n");
         return;
     }
-    cfgptr=gamecfg;
-    while(cfgptr) {
-        struct ConfigBlock *block=cfgptr->data;
+    for(b=0;b<gamecfg->count;b++) {
+        const struct ConfigBlock *block=&gamecfg->blocks[b];
         if(block->title==NULL||strcmp(block->title,"settings")==0)
-            parse_settings_block(block->values);
-        else if(strcmp(block->title,"controllers")==0) parse_controllers_block(block->values);
-        else if(strcmp(block->title,"keys1")==0) parse_keys_block(block->values,0);
-        else if(strcmp(block->title,"keys2")==0) parse_keys_block(block->values,1);
-        else if(strcmp(block->title,"keys3")==0) parse_keys_block(block->values,2);
-        else if(strcmp(block->title,"keys4")==0) parse_keys_block(block->values,3);
+            parse_settings_block(block);
+        else if(strcmp(block->title,"controllers")==0) parse_controllers_block(block);
+        else if(strcmp(block->title,"keys1")==0) parse_keys_block(block,0);
+        else if(strcmp(block->title,"keys2")==0) parse_keys_block(block,1);
+        else if(strcmp(block->title,"keys3")==0) parse_keys_block(block,2);
+        else if(strcmp(block->title,"keys4")==0) parse_keys_block(block,3);
         else printf("Unknown block \"%s\"\n",block->title);
-        cfgptr=cfgptr->next;
     }
-    dllist_free(gamecfg,free_config_file);
+    free_config_file(gamecfg);
 }
 
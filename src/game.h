@@ -112,6 +112,9 @@ extern void game_eventloop (void);
 /* Save game settings */
 extern void save_game_config (void);
 
+/* Get current time in microseconds */
+extern Uint64 get_time_us (void);
+
 /* Some globals */
 extern GameInfo game_settings;
 extern PerLevelSettings level_settings;
@@ -22,6 +22,7 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include "startup.h"
 #include "console.h"
@@ -37,6 +38,7 @@
 #include "ship.h"
 #include "weapon.h"
 #include "special.h"
+#include "projectile.h"
 #include "decor.h"
 #include "critter.h"
 #include "particle.h"
@@ -218,7 +220,7 @@ static void draw_hotseat_startup (void)
     if (game_settings.mbg_anim)
         draw_starfield ();
     draw_menu (screen, hotseat_startup_menu);
-    SDL_UpdateRect (screen, 0, 0, 0, 0);
+    update_screen_rect (0, 0, 0, 0);
 }
 
 /* Hotseat game startup eventloop */
@@ -354,7 +356,8 @@ void hotseat_game (void)
 
         /* Load selected level */
         fill_player_screens ();
-        open_level (curlevel);
+        if (open_level (curlevel))
+            continue;
         load_level (curlevel);
 
         /* Check level size */
@@ -363,7 +366,7 @@ void hotseat_game (void)
                 "Level is smaller than the viewport!",
                 "Increase level zoom or use quarter screens.",NULL
             };
-            error_screen(curlevel->settings->mainblock.name,
+            error_screen(curlevel->name,
                     "Press enter to skip level", toosmall);
             close_level(curlevel);
             continue;
@@ -407,6 +410,14 @@ void hotseat_game (void)
         SDL_EnableKeyRepeat(0,0);
         game_eventloop ();
         SDL_EnableKeyRepeat(SDL_DEFAULT_REPEAT_DELAY,SDL_DEFAULT_REPEAT_INTERVAL);
+        if (luola_options.stats)
+            printf ("Projectile queue: %lu spawned, %lu removed, "
+                    "max depth %d, %lu flushes in %lu us\n",
+                    projectile_queue_stats.spawned,
+                    projectile_queue_stats.removed,
+                    projectile_queue_stats.maxdepth,
+                    projectile_queue_stats.flushes,
+                    (unsigned long) projectile_queue_stats.flushtime);
 
         /* Game finished, clean up */
         music_stop ();
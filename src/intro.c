@@ -770,7 +770,7 @@ void draw_intro_screen (void)
     draw_menu (screen, intro_menu);
     if (intr_message.show)
         intro_draw_message ();
-    SDL_UpdateRect (screen, 0, 0, 0, 0);
+    update_screen_rect (0, 0, 0, 0);
 }
 
 /* Called by a menu callback (this is exported in intro.h as well) */
@@ -0,0 +1,197 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2001-2006 Calle Laakkonen
+ *
+ * File        : jobs.c
+ * Description : Background worker threads
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include "jobs.h"
+
+#define MAX_WORKERS 8
+
+typedef enum { JOB_QUEUED, JOB_RUNNING, JOB_DONE } JobState;
+
+struct Job {
+    JobFunc func;
+    void *arg;
+    JobState state;
+    struct Job *prev;
+    struct Job *next;
+};
+
+static SDL_mutex *job_lock;
+static SDL_cond *job_queued;    /* Signaled when a job is added */
+static SDL_cond *job_finished;  /* Broadcast when a job is finished */
+static Job *job_first, *job_last;
+static int job_workers;
+
+/* Remove a job from the queue. Must be called with job_lock held */
+static void unqueue_job (Job * job)
+{
+    if (job->prev)
+        job->prev->next = job->next;
+    else
+        job_first = job->next;
+    if (job->next)
+        job->next->prev = job->prev;
+    else
+        job_last = job->prev;
+    job->state = JOB_RUNNING;
+}
+
+/* Worker thread main loop */
+static int job_worker (void *unused)
+{
+    Job *job;
+    SDL_mutexP (job_lock);
+    while (1) {
+        while (job_first == NULL)
+            SDL_CondWait (job_queued, job_lock);
+        job = job_first;
+        unqueue_job (job);
+        SDL_mutexV (job_lock);
+
+        job->func (job->arg);
+
+        SDL_mutexP (job_lock);
+        job->state = JOB_DONE;
+        SDL_CondBroadcast (job_finished);
+    }
+    return 0;
+}
+
+/* Get the number of processors */
+static int cpu_count (void)
+{
+#if !defined(WIN32) && defined(_SC_NPROCESSORS_ONLN)
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+        return cpus;
+#endif
+    return 2;
+}
+
+/* Start the worker threads */
+void init_jobs (void)
+{
+    int cpus = cpu_count ();
+    if (cpus > MAX_WORKERS)
+        cpus = MAX_WORKERS;
+    job_lock = SDL_CreateMutex ();
+    job_queued = SDL_CreateCond ();
+    job_finished = SDL_CreateCond ();
+    if (job_lock == NULL || job_queued == NULL || job_finished == NULL) {
+        fprintf (stderr, "Could not create job queue: %s\n", SDL_GetError ());
+        return;
+    }
+    for (job_workers = 0; job_workers < cpus; job_workers++) {
+        if (SDL_CreateThread (job_worker, NULL) == NULL) {
+            fprintf (stderr, "Could not start worker thread: %s\n",
+                    SDL_GetError ());
+            break;
+        }
+    }
+}
+
+/* Queue a job */
+Job *add_job (JobFunc func, void *arg)
+{
+    Job *job = malloc (sizeof (Job));
+    if (job == NULL) {
+        perror (__func__);
+        exit (1);
+    }
+    job->func = func;
+    job->arg = arg;
+    job->next = NULL;
+    if (job_workers == 0) {
+        job->state = JOB_DONE;
+        func (arg);
+        return job;
+    }
+    job->state = JOB_QUEUED;
+    SDL_mutexP (job_lock);
+    job->prev = job_last;
+    if (job_last)
+        job_last->next = job;
+    else
+        job_first = job;
+    job_last = job;
+    SDL_CondSignal (job_queued);
+    SDL_mutexV (job_lock);
+    return job;
+}
+
+/* Wait until the job is done and free it */
+void finish_job (Job * job)
+{
+    if (job_workers) {
+        SDL_mutexP (job_lock);
+        if (job->state == JOB_QUEUED) {
+            /* Nobody has started it yet, so do it ourselves */
+            unqueue_job (job);
+            SDL_mutexV (job_lock);
+            job->func (job->arg);
+            SDL_mutexP (job_lock);
+            job->state = JOB_DONE;
+        }
+        while (job->state != JOB_DONE)
+            SDL_CondWait (job_finished, job_lock);
+        SDL_mutexV (job_lock);
+    }
+    free (job);
+}
+
+/* Remove a job that has not been started yet */
+int cancel_job (Job * job)
+{
+    int cancelled = 0;
+    if (job_workers == 0)
+        return 0;
+    SDL_mutexP (job_lock);
+    if (job->state == JOB_QUEUED) {
+        unqueue_job (job);
+        cancelled = 1;
+    }
+    SDL_mutexV (job_lock);
+    if (cancelled)
+        free (job);
+    return cancelled;
+}
+
+/* Check if a job is done */
+int job_done (Job * job)
+{
+    int done;
+    if (job_workers == 0)
+        return 1;
+    SDL_mutexP (job_lock);
+    done = job->state == JOB_DONE;
+    SDL_mutexV (job_lock);
+    return done;
+}
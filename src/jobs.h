@@ -0,0 +1,50 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2001-2006 Calle Laakkonen
+ *
+ * File        : jobs.h
+ * Description : Background worker threads
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+/* A function run by a worker thread */
+typedef void (*JobFunc) (void *arg);
+
+/* A queued job. Jobs are freed by finish_job */
+typedef struct Job Job;
+
+/* Start the worker threads */
+extern void init_jobs (void);
+
+/* Queue a job. If there are no worker threads, the job is run at once */
+extern Job *add_job (JobFunc func, void *arg);
+
+/* Wait until the job is done and free it. */
+/* If no worker has started the job yet, it is run in this thread */
+extern void finish_job (Job * job);
+
+/* Remove a job that no worker has started yet and free it. */
+/* Returns 0 if the job was already started */
+extern int cancel_job (Job * job);
+
+/* Check if a job is done, so finish_job will not block */
+extern int job_done (Job * job);
+
+#endif
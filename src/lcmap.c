@@ -26,6 +26,7 @@
 #include <zlib.h>
 
 #include "lcmap.h"
+#include "jobs.h"
 
 #define LCMAP_FLAG_MASK		0x03
 #define LCMAP_FLAG_8BIT		0x01
@@ -34,275 +35,660 @@
 
 #define PALETTE_ENTRIES		18      /* How many palette entries to store */
 
+/* Version 2 layout, numbers are little endian:                      */
+/*  "LCMAP", 4 zero bytes (width and height in version 1), version    */
+/*  width and height (32 bit), palette size and RGB entries           */
+/*  rows per band and band count (32 bit)                             */
+/*  band table: offset, packed and unpacked length of each band       */
+/*  band data: zlib compressed run length encoded rows                */
+#define LCMAP_VERSION		2
+#define LCMAP_BAND_ROWS		64      /* Rows per independently packed band */
+#define LCMAP_MAX_RUN		0x1000000 /* Longest run a 24bit length holds */
+#define LCMAP_BAND_ENTRY_LEN	12      /* offset, packed and unpacked length */
+
+/* One band of rows being decoded */
+typedef struct {
+    int version;
+    Uint32 offset;              /* Position in the band data */
+    Uint8 *zdata;               /* Compressed band */
+    Uint32 zlen;
+    Uint32 rawlen;
+    Uint32 width, height;       /* Size of the whole image */
+    Uint32 y0, rows;            /* Rows covered by this band */
+    /* Surface output */
+    Uint8 *pixels;              /* First row of the band in the surface */
+    int pitch;
+    /* Grid output */
+    Uint8 *grid;
+    const Uint8 *map;
+    int mark;
+    Uint32 count[256];
+    Uint32 *marks;
+    Uint32 markcount, marksize;
+
+    int error;                  /* zlib error or 1 if RLE data is corrupt */
+    Job *job;
+} LCMAP_Band;
+
+static void put_le32 (Uint8 * ptr, Uint32 value)
+{
+    ptr[0] = value;
+    ptr[1] = value >> 8;
+    ptr[2] = value >> 16;
+    ptr[3] = value >> 24;
+}
+
+static Uint32 get_le32 (const Uint8 * ptr)
+{
+    return ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (Uint32) ptr[3] << 24;
+}
+
+/* Run length encode rows of an 8 bit surface. Runs do not continue */
+/* over the last row, so each band can be decoded on its own. */
+/* The output is never longer than the number of pixels */
+static Uint32 encode_rows (Uint8 * data, SDL_Surface * surface, int y0,
+                           int rows)
+{
+    Uint32 dlen = 0, run = 0;
+    Uint8 value = 0, *pixel;
+    int x, y;
+    for (y = y0; y < y0 + rows; y++) {
+        pixel = (Uint8 *) surface->pixels + y * surface->pitch;
+        for (x = 0; x < surface->w; x++, pixel++) {
+            if (run > 0 && *pixel == value && run < LCMAP_MAX_RUN) {
+                run++;
+                continue;
+            }
+            if (run > 0) {
+                /* Lengths are stored as run-1 */
+                run--;
+                if (run == 0) {
+                    data[dlen++] = value << 2;
+                } else if (run <= 0xff) {
+                    data[dlen++] = (value << 2) | LCMAP_FLAG_8BIT;
+                    data[dlen++] = run;
+                } else if (run <= 0xffff) {
+                    data[dlen++] = (value << 2) | LCMAP_FLAG_16BIT;
+                    data[dlen++] = run;
+                    data[dlen++] = run >> 8;
+                } else {
+                    data[dlen++] = (value << 2) | LCMAP_FLAG_24BIT;
+                    data[dlen++] = run;
+                    data[dlen++] = run >> 8;
+                    data[dlen++] = run >> 16;
+                }
+            }
+            value = *pixel;
+            run = 1;
+        }
+    }
+    /* Last run */
+    if (run > 0) {
+        run--;
+        if (run == 0) {
+            data[dlen++] = value << 2;
+        } else if (run <= 0xff) {
+            data[dlen++] = (value << 2) | LCMAP_FLAG_8BIT;
+            data[dlen++] = run;
+        } else if (run <= 0xffff) {
+            data[dlen++] = (value << 2) | LCMAP_FLAG_16BIT;
+            data[dlen++] = run;
+            data[dlen++] = run >> 8;
+        } else {
+            data[dlen++] = (value << 2) | LCMAP_FLAG_24BIT;
+            data[dlen++] = run;
+            data[dlen++] = run >> 8;
+            data[dlen++] = run >> 16;
+        }
+    }
+    return dlen;
+}
+
+/* Convert an 8 bit surface to a version 2 LCMAP */
+/* The image is split into bands of LCMAP_BAND_ROWS rows that are */
+/* compressed separately and listed in an offset table. */
 Uint8 *surface_to_lcmap (Uint32 * len, SDL_Surface * surface)
 {
-    Uint32 dlen, flen, linelen;
-    Uint16 x, y;
-    Uint8 *data, *zdata, *file;
-    Uint8 value, *pixel, flags;
-    int r, p;
-    uLongf zlen;
+    Uint32 bands, band, hdrlen, flen, dlen, offset;
+    Uint8 *data, **zdata, *file, *ptr;
+    Uint32 *rawlen;
+    uLongf *zlen;
+    int r, p, rows;
 
     if (surface->format->BitsPerPixel != 8) {
         printf ("Error! Surface has incorrect depth\n");
         return NULL;
     }
-    data = malloc (surface->w * surface->h);
-    dlen = 0;
-    pixel = (Uint8 *) surface->pixels;
-    value = *pixel;
-    linelen = 0;
-    /* Encode image */
-    for (y = 0; y < surface->h; y++) {
-        for (x = 0; x < surface->w; x++) {
-            if (*pixel != value || linelen == 0xffffff) {
-                if (linelen == 0)
-                    flags = 0;
-                else if (linelen <= 0xff)
-                    flags = LCMAP_FLAG_8BIT;
-                else if (linelen <= 0xffff)
-                    flags = LCMAP_FLAG_16BIT;
-                else
-                    flags = LCMAP_FLAG_24BIT;
-                data[dlen] = (value << 2) | flags;
-                if (flags == LCMAP_FLAG_8BIT) {
-                    data[dlen + 1] = linelen;
-                    dlen += 2;
-                } else if (flags == LCMAP_FLAG_16BIT) {
-                    data[dlen + 1] = linelen;
-                    data[dlen + 2] = linelen >> 8;
-                    dlen += 3;
-                } else if (flags == LCMAP_FLAG_24BIT) {
-                    data[dlen + 1] = linelen;
-                    data[dlen + 2] = linelen >> 8;
-                    data[dlen + 3] = linelen >> 16;
-                    dlen += 4;
-                } else
-                    dlen++;
-                value = *pixel;
-                linelen = 0;
-            } else
-                linelen++;
-            pixel++;
-        }
-        pixel += surface->pitch - surface->w;
-    }
-    /* Last entry */
-    if (linelen <= 1)
-        flags = 0;
-    else if (linelen <= 0xff)
-        flags = LCMAP_FLAG_8BIT;
-    else if (linelen <= 0xffff)
-        flags = LCMAP_FLAG_16BIT;
-    else
-        flags = LCMAP_FLAG_24BIT;
-    data[dlen] = (value << 2) | flags;
-    if (flags == LCMAP_FLAG_8BIT) {
-        data[dlen + 1] = linelen;
-        dlen += 2;
-    } else if (flags == LCMAP_FLAG_16BIT) {
-        data[dlen + 1] = linelen;
-        data[dlen + 2] = linelen >> 8;
-        dlen += 3;
-    } else if (flags == LCMAP_FLAG_24BIT) {
-        data[dlen + 1] = linelen;
-        data[dlen + 2] = linelen >> 8;
-        data[dlen + 3] = linelen >> 16;
-        dlen += 4;
-    } else
-        dlen++;
-    /* Compress data */
-    zlen = dlen + 200;
-    zdata = malloc (zlen);
-    if ((r = compress (zdata, &zlen, data, dlen)) == Z_BUF_ERROR) {
-        printf ("Error! Not enough space in output buffer\n");
-        if (r == Z_MEM_ERROR)
-            printf ("Not enough memory\n");
-        else if (r == Z_BUF_ERROR)
-            printf ("Outputbuffer too small\n");
-        else
-            printf ("Unknown error\n");
+    bands = (surface->h + LCMAP_BAND_ROWS - 1) / LCMAP_BAND_ROWS;
+    data = malloc (surface->w * LCMAP_BAND_ROWS);
+    zdata = calloc (bands, sizeof (Uint8 *));
+    zlen = calloc (bands, sizeof (uLongf));
+    rawlen = calloc (bands, sizeof (Uint32));
+    hdrlen = 5 + 4 + 1 + 8 + 1 + (PALETTE_ENTRIES * 3) + 8
+        + bands * LCMAP_BAND_ENTRY_LEN;
+    flen = hdrlen;
+    if (data == NULL || (bands && (zdata == NULL || zlen == NULL
+                                   || rawlen == NULL))) {
+        printf ("Error! Not enough memory\n");
         free (data);
         free (zdata);
+        free (zlen);
+        free (rawlen);
         return NULL;
     }
+    /* Encode and compress each band */
+    file = NULL;
+    for (band = 0; band < bands; band++) {
+        rows = surface->h - band * LCMAP_BAND_ROWS;
+        if (rows > LCMAP_BAND_ROWS)
+            rows = LCMAP_BAND_ROWS;
+        dlen = encode_rows (data, surface, band * LCMAP_BAND_ROWS, rows);
+        zlen[band] = compressBound (dlen);
+        zdata[band] = malloc (zlen[band]);
+        if (zdata[band] == NULL)
+            r = Z_MEM_ERROR;
+        else
+            r = compress (zdata[band], &zlen[band], data, dlen);
+        if (r != Z_OK) {
+            printf ("Error occured while compressing LCMAP band %d\n", band);
+            if (r == Z_MEM_ERROR)
+                printf ("Not enough memory\n");
+            else if (r == Z_BUF_ERROR)
+                printf ("Outputbuffer too small\n");
+            else
+                printf ("Unknown error\n");
+            goto out;
+        }
+        rawlen[band] = dlen;
+        flen += zlen[band];
+    }
     /* Create the file */
-    flen = 5 + 13 + (PALETTE_ENTRIES * 3) + zlen;
     file = malloc (flen);
-    file[0] = 'L';
-    file[1] = 'C';
-    file[2] = 'M';
-    file[3] = 'A';
-    file[4] = 'P';
-    file[5] = surface->w;
-    file[6] = surface->w >> 8;
-    file[7] = surface->h;
-    file[8] = surface->h >> 8;
-    file[9] = PALETTE_ENTRIES;
-    r = 10;
+    if (file == NULL) {
+        printf ("Error! Not enough memory\n");
+        goto out;
+    }
+    memcpy (file, "LCMAP", 5);
+    /* Zero width and height tell this is not a version 1 file */
+    memset (file + 5, 0, 4);
+    file[9] = LCMAP_VERSION;
+    put_le32 (file + 10, surface->w);
+    put_le32 (file + 14, surface->h);
+    file[18] = PALETTE_ENTRIES;
+    r = 19;
     for (p = 0; p < PALETTE_ENTRIES; p++) {
         file[r] = surface->format->palette->colors[p].r;
         file[r + 1] = surface->format->palette->colors[p].g;
         file[r + 2] = surface->format->palette->colors[p].b;
         r += 3;
     }
-    file[r] = dlen;
-    r++;
-    file[r] = dlen >> 8;
-    r++;
-    file[r] = dlen >> 16;
-    r++;
-    file[r] = dlen >> 24;
-    r++;
-    file[r] = zlen;
-    r++;
-    file[r] = zlen >> 8;
-    r++;
-    file[r] = zlen >> 16;
-    r++;
-    file[r] = zlen >> 24;
-    r++;
-    memcpy (file + r, zdata, zlen);
-    free (data);
-    free (zdata);
+    put_le32 (file + r, LCMAP_BAND_ROWS);
+    put_le32 (file + r + 4, bands);
+    r += 8;
+    /* Band table and band data. Offsets are from the end of the table */
+    offset = 0;
+    ptr = file + hdrlen;
+    for (band = 0; band < bands; band++) {
+        put_le32 (file + r, offset);
+        put_le32 (file + r + 4, zlen[band]);
+        put_le32 (file + r + 8, rawlen[band]);
+        r += LCMAP_BAND_ENTRY_LEN;
+        memcpy (ptr, zdata[band], zlen[band]);
+        ptr += zlen[band];
+        offset += zlen[band];
+    }
     *len = flen;
+  out:
+    for (band = 0; band < bands; band++)
+        free (zdata[band]);
+    free (zdata);
+    free (zlen);
+    free (rawlen);
+    free (data);
     return file;
 }
 
-SDL_Surface *lcmap_to_surface_rw (SDL_RWops * rw)
+/* LCMAP header */
+typedef struct {
+    int version;
+    Uint32 width, height;
+    int palent;
+    SDL_Color palette[256];
+    Uint32 bandrows, bands;     /* Version 2 */
+    Uint32 unpackedlen, zlen;   /* Version 1 */
+} LCMAP_Header;
+
+/* Read the LCMAP headers */
+static int read_header (SDL_RWops * rw, LCMAP_Header * hdr)
 {
-    SDL_Surface *surface;
-    SDL_Color *colors;
-    int r, x;
-    uLongf uplen;
-    Uint32 pos, unpackedlen, zlen, loop;
-    Uint16 width, height;
-    Uint8 *zdata, *data, *pixels, value, flags, palent, *dataptr;
-    Uint8 tmpbuf[8];
-    /* Read the headers */
+    Uint8 tmpbuf[10];
+    int r;
     if (!SDL_RWread (rw, tmpbuf, 1, 5)) {
         printf
             ("Error occured while attempting to read the magic number of an LCMAP file\n");
-        return NULL;
+        return 1;
     }
     if (strncmp ((char*)tmpbuf, "LCMAP", 5)) {
         printf ("Error! This file doesn't seem to be an LCMAP\n");
-        return NULL;
+        return 1;
     }
     if (!SDL_RWread (rw, tmpbuf, 1, 5)) {
         printf
             ("Error occured while attempting to read the LCMAP size info.\n");
-        return NULL;
+        return 1;
     }
-    width = tmpbuf[0] | tmpbuf[1] << 8;
-    height = tmpbuf[2] | tmpbuf[3] << 8;
-    palent = tmpbuf[4];
-    colors = malloc (sizeof (SDL_Color) * palent);
-    for (r = 0; r < palent; r++) {
+    hdr->width = tmpbuf[0] | tmpbuf[1] << 8;
+    hdr->height = tmpbuf[2] | tmpbuf[3] << 8;
+    if (hdr->width == 0 && hdr->height == 0) {
+        hdr->version = tmpbuf[4];
+        if (hdr->version != LCMAP_VERSION) {
+            printf ("Error! Unsupported LCMAP version %d\n", hdr->version);
+            return 1;
+        }
+        if (!SDL_RWread (rw, tmpbuf, 1, 9)) {
+            printf
+                ("Error occured while attempting to read the LCMAP size info.\n");
+            return 1;
+        }
+        hdr->width = get_le32 (tmpbuf);
+        hdr->height = get_le32 (tmpbuf + 4);
+        hdr->palent = tmpbuf[8];
+    } else {
+        hdr->version = 1;
+        hdr->palent = tmpbuf[4];
+    }
+    for (r = 0; r < hdr->palent; r++) {
         if (!SDL_RWread (rw, tmpbuf, 1, 3)) {
             printf ("Error occured while reading LCMAP palette entry %d\n",
                     r);
-            return NULL;
+            return 1;
         }
-        colors[r].r = tmpbuf[0];
-        colors[r].g = tmpbuf[1];
-        colors[r].b = tmpbuf[2];
+        hdr->palette[r].r = tmpbuf[0];
+        hdr->palette[r].g = tmpbuf[1];
+        hdr->palette[r].b = tmpbuf[2];
     }
     if (!SDL_RWread (rw, tmpbuf, 1, 8)) {
         printf
             ("Error occured while attempting to read LCMAP data lengths.\n");
+        return 1;
+    }
+    if (hdr->version == 1) {
+        hdr->unpackedlen = get_le32 (tmpbuf);
+        hdr->zlen = get_le32 (tmpbuf + 4);
+        hdr->bandrows = hdr->height;
+        hdr->bands = 1;
+    } else {
+        hdr->bandrows = get_le32 (tmpbuf);
+        hdr->bands = get_le32 (tmpbuf + 4);
+        if (hdr->bandrows == 0 || hdr->height > 0x7fffffff
+            || hdr->bands != (hdr->height + hdr->bandrows - 1) / hdr->bandrows) {
+            printf ("Error! LCMAP header is corrupted\n");
+            return 1;
+        }
+    }
+    /* SDL surface pitch is only 16 bits */
+    if (hdr->width > 0xfff0) {
+        printf ("Error! LCMAP is too wide (%u pixels)\n", hdr->width);
+        return 1;
+    }
+    return 0;
+}
+
+/* Read the band table and the compressed data of all bands. */
+/* A version 1 LCMAP is one band that covers the whole image. */
+static LCMAP_Band *read_bands (SDL_RWops * rw, const LCMAP_Header * hdr,
+                               Uint8 ** zdata)
+{
+    LCMAP_Band *band;
+    Uint8 tmpbuf[LCMAP_BAND_ENTRY_LEN];
+    Uint32 b, zlen;
+
+    band = calloc (hdr->bands + 1, sizeof (LCMAP_Band));
+    if (band == NULL) {
+        printf ("Error! Not enough memory\n");
         return NULL;
     }
-    unpackedlen =
-        tmpbuf[0] | tmpbuf[1] << 8 | tmpbuf[2] << 16 | tmpbuf[3] << 24;
-    zlen = tmpbuf[4] | tmpbuf[5] << 8 | tmpbuf[6] << 16 | tmpbuf[7] << 24;
+    *zdata = NULL;
+    if (hdr->version == 1) {
+        band[0].zlen = hdr->zlen;
+        band[0].rawlen = hdr->unpackedlen;
+        zlen = hdr->zlen;
+    } else {
+        zlen = 0;
+        for (b = 0; b < hdr->bands; b++) {
+            if (!SDL_RWread (rw, tmpbuf, 1, LCMAP_BAND_ENTRY_LEN)) {
+                printf
+                    ("Error occured while reading the LCMAP band table.\n");
+                goto fail;
+            }
+            band[b].offset = get_le32 (tmpbuf);
+            band[b].zlen = get_le32 (tmpbuf + 4);
+            band[b].rawlen = get_le32 (tmpbuf + 8);
+            if (band[b].offset > 0x7fffffff || band[b].zlen > 0x7fffffff) {
+                printf ("Error! LCMAP band table is corrupted\n");
+                goto fail;
+            }
+            if (band[b].offset + band[b].zlen > zlen)
+                zlen = band[b].offset + band[b].zlen;
+        }
+    }
+    /* Read all bands at once */
+    *zdata = malloc (zlen + 1);
+    if (*zdata == NULL) {
+        printf ("Error! Not enough memory\n");
+        goto fail;
+    }
+    if (zlen > 0 && !SDL_RWread (rw, *zdata, zlen, 1)) {
+        printf ("Error! Could not read image data\n%s\n", SDL_GetError ());
+        goto fail;
+    }
+    for (b = 0; b < hdr->bands; b++) {
+        band[b].version = hdr->version;
+        band[b].zdata = *zdata + band[b].offset;
+        band[b].width = hdr->width;
+        band[b].height = hdr->height;
+        band[b].y0 = b * hdr->bandrows;
+        band[b].rows = hdr->height - band[b].y0;
+        if (band[b].rows > hdr->bandrows)
+            band[b].rows = hdr->bandrows;
+    }
+    return band;
+  fail:
+    free (*zdata);
+    *zdata = NULL;
+    free (band);
+    return NULL;
+}
+
+/* Store a run of pixels in a column major grid */
+static void fill_grid (LCMAP_Band * band, Uint32 x, Uint32 y, Uint32 n,
+                       Uint8 value)
+{
+    Uint8 *col;
+    Uint32 i;
+    if (band->map)
+        value = band->map[value];
+    band->count[value] += n;
+    col = band->grid + (size_t) x *band->height + band->y0 + y;
+    for (i = 0; i < n; i++, col += band->height)
+        *col = value;
+    if (value == band->mark) {
+        if (band->markcount + n > band->marksize) {
+            band->marksize = (band->markcount + n) * 2;
+            band->marks = realloc (band->marks,
+                                   sizeof (Uint32) * 2 * band->marksize);
+            if (band->marks == NULL) {
+                perror ("fill_grid");
+                exit (1);
+            }
+        }
+        for (i = 0; i < n; i++) {
+            band->marks[band->markcount * 2] = x + i;
+            band->marks[band->markcount * 2 + 1] = band->y0 + y;
+            band->markcount++;
+        }
+    }
+}
+
+/* Decode one band into a surface or a grid. Run by a worker thread */
+static void decode_band (void *arg)
+{
+    LCMAP_Band *band = arg;
+    Uint8 *data, *ptr, *end, value, flags;
+    Uint32 loop, n, x, row;
+    uLongf uplen;
+
+    data = malloc (band->rawlen + 1);
+    if (data == NULL) {
+        band->error = Z_MEM_ERROR;
+        return;
+    }
+    uplen = band->rawlen;
+    band->error = uncompress (data, &uplen, band->zdata, band->zlen);
+    if (band->error != Z_OK || uplen != band->rawlen) {
+        if (band->error == Z_OK && band->version > 1)
+            band->error = 1;
+        if (band->error != Z_OK) {
+            free (data);
+            return;
+        }
+    }
+    ptr = data;
+    end = data + uplen;
+    x = 0;
+    row = 0;
+    while (ptr < end && band->width > 0) {
+        value = *ptr >> 2;
+        flags = *ptr & LCMAP_FLAG_MASK;
+        if (ptr + flags >= end)
+            break;
+        if (flags == LCMAP_FLAG_8BIT)
+            loop = 1 + ptr[1];
+        else if (flags == LCMAP_FLAG_16BIT)
+            loop = 1 + (ptr[1] | ptr[2] << 8);
+        else if (flags == LCMAP_FLAG_24BIT) /* Version 1 didn't add 1 */
+            loop = (band->version > 1) + (ptr[1] | ptr[2] << 8 | ptr[3] << 16);
+        else
+            loop = 1;
+        ptr += 1 + flags;
+        /* Runs may continue to the next row */
+        while (loop && row < band->rows) {
+            n = band->width - x;
+            if (n > loop)
+                n = loop;
+            if (band->grid)
+                fill_grid (band, x, row, n, value);
+            else
+                memset (band->pixels + (size_t) row * band->pitch + x,
+                        value, n);
+            x += n;
+            loop -= n;
+            if (x == band->width) {
+                x = 0;
+                row++;
+            }
+        }
+        if (loop)
+            break;
+    }
+    /* Version 1 encoder got the last run wrong, so it is not checked */
+    if (band->version > 1 && (ptr != end || row != band->rows || x != 0)
+        && (band->width > 0 || ptr != end))
+        band->error = 1;
+    free (data);
+}
+
+/* Decode all bands, in parallel if there are worker threads */
+static int decode_bands (LCMAP_Band * band, Uint32 bands)
+{
+    Uint32 b;
+    int failed = 0;
+    for (b = 0; b < bands; b++)
+        band[b].job = add_job (decode_band, band + b);
+    for (b = 0; b < bands; b++) {
+        finish_job (band[b].job);
+        if (band[b].error && failed == 0) {
+            failed = 1;
+            printf ("Error occured while decoding LCMAP band %d\n", b);
+            if (band[b].error == Z_MEM_ERROR)
+                printf ("Not enough memory\n");
+            else if (band[b].error == Z_DATA_ERROR
+                     || band[b].error == Z_BUF_ERROR)
+                printf ("Input data corrupted\n");
+            else if (band[b].error == 1)
+                printf ("Run length data corrupted\n");
+            else
+                printf ("Unknown zlib error %d\n", band[b].error);
+        }
+    }
+    return failed;
+}
+
+SDL_Surface *lcmap_to_surface_rw (SDL_RWops * rw)
+{
+    SDL_Surface *surface;
+    LCMAP_Header hdr;
+    LCMAP_Band *band;
+    Uint8 *zdata;
+    Uint32 b;
+    int failed;
+
+    if (read_header (rw, &hdr))
+        return NULL;
     /* Build the image */
     surface =
-        SDL_CreateRGBSurface (SDL_SWSURFACE, width, height, 8, 0, 0, 0, 0);
+        SDL_CreateRGBSurface (SDL_SWSURFACE, hdr.width, hdr.height, 8, 0, 0,
+                              0, 0);
     if (surface == NULL) {
         printf ("Error! Couldn't create a surface!\n%s\n", SDL_GetError ());
         return NULL;
     }
-    SDL_SetColors (surface, colors, 0, palent);
-    /* Unpack data */
-    data = malloc (unpackedlen);
-    dataptr = data;
-    zdata = malloc (sizeof (Uint8) * zlen);
-    if (!SDL_RWread (rw, zdata, 1, zlen)) {
-        printf ("Error! Could not read image data\n%s\n", SDL_GetError ());
+    SDL_SetColors (surface, hdr.palette, 0, hdr.palent);
+    band = read_bands (rw, &hdr, &zdata);
+    if (band == NULL) {
+        SDL_FreeSurface (surface);
         return NULL;
     }
-    uplen = unpackedlen;
-    if ((r = uncompress (data, &uplen, zdata, zlen)) != Z_OK) {
-        printf ("Error occured during unpack!\n");
-        if (r == Z_MEM_ERROR)
-            printf ("Not enough memory\n");
-        else if (r == Z_BUF_ERROR)
-            printf ("Output buffer too small\n");
-        else if (r == Z_STREAM_ERROR)
-            printf ("Level parameter invalid\n");
-        else if (r == Z_DATA_ERROR)
-            printf ("Input data corrupted\n");
-        else
-            printf ("Unknown zlib error %d\n", r);
+    /* Decode pixel data */
+    if (SDL_MUSTLOCK (surface))
+        SDL_LockSurface (surface);
+    for (b = 0; b < hdr.bands; b++) {
+        band[b].pitch = surface->pitch;
+        band[b].pixels = (Uint8 *) surface->pixels
+            + (size_t) band[b].y0 * surface->pitch;
+    }
+    failed = decode_bands (band, hdr.bands);
+    if (SDL_MUSTLOCK (surface))
+        SDL_UnlockSurface (surface);
+    free (zdata);
+    free (band);
+    if (failed) {
+        SDL_FreeSurface (surface);
         return NULL;
     }
+    return surface;
+}
+
+/* Decode an LCMAP straight into a grid */
+int lcmap_to_grid_rw (SDL_RWops * rw, const Uint8 * map, int mark,
+                      LCMAP_Grid * grid)
+{
+    LCMAP_Header hdr;
+    LCMAP_Band *band;
+    Uint8 *zdata;
+    Uint32 b, v;
+    int failed;
+
+    memset (grid, 0, sizeof (LCMAP_Grid));
+    if (read_header (rw, &hdr))
+        return 1;
+    grid->width = hdr.width;
+    grid->height = hdr.height;
+    /* Unused entries are black, as in an 8 bit surface */
+    grid->ncolors = 256;
+    memcpy (grid->palette, hdr.palette, sizeof (SDL_Color) * hdr.palent);
+    grid->grid = calloc ((size_t) hdr.width * hdr.height + 1, 1);
+    if (grid->grid == NULL) {
+        printf ("Error! Not enough memory\n");
+        return 1;
+    }
+    band = read_bands (rw, &hdr, &zdata);
+    if (band == NULL) {
+        lcmap_free_grid (grid);
+        return 1;
+    }
+    for (b = 0; b < hdr.bands; b++) {
+        band[b].grid = grid->grid;
+        band[b].map = map;
+        band[b].mark = mark;
+    }
+    failed = decode_bands (band, hdr.bands);
+    /* Combine the per band statistics in band order */
+    for (b = 0; b < hdr.bands; b++) {
+        for (v = 0; v < 256; v++)
+            grid->count[v] += band[b].count[v];
+        grid->markcount += band[b].markcount;
+    }
+    if (grid->markcount > 0) {
+        grid->marks = malloc (sizeof (Uint32) * 2 * grid->markcount);
+        if (grid->marks == NULL) {
+            perror ("lcmap_to_grid_rw");
+            exit (1);
+        }
+        grid->markcount = 0;
+        for (b = 0; b < hdr.bands; b++) {
+            memcpy (grid->marks + grid->markcount * 2, band[b].marks,
+                    sizeof (Uint32) * 2 * band[b].markcount);
+            grid->markcount += band[b].markcount;
+        }
+    }
+    for (b = 0; b < hdr.bands; b++)
+        free (band[b].marks);
     free (zdata);
-    if (uplen != unpackedlen) {
-        printf
-            ("Warning! Data lengths differ! ZLib says %ld, but we say %d\n",
-             uplen, unpackedlen);
+    free (band);
+    if (failed) {
+        lcmap_free_grid (grid);
+        return 1;
     }
-    /* Decode pixel data */
-    pixels = surface->pixels;
+    return 0;
+}
+
+/* Build a grid from an 8 bit surface */
+int surface_to_grid (SDL_Surface * surface, const Uint8 * map, int mark,
+                     LCMAP_Grid * grid)
+{
+    LCMAP_Band band;
+    Uint8 *row;
+    Uint32 x, y, n;
+
+    memset (grid, 0, sizeof (LCMAP_Grid));
+    if (surface->format->BitsPerPixel != 8
+        || surface->format->palette == NULL) {
+        printf ("Error! Surface has incorrect depth\n");
+        return 1;
+    }
+    grid->width = surface->w;
+    grid->height = surface->h;
+    grid->ncolors = surface->format->palette->ncolors;
+    if (grid->ncolors > 256)
+        grid->ncolors = 256;
+    memcpy (grid->palette, surface->format->palette->colors,
+            sizeof (SDL_Color) * grid->ncolors);
+    grid->grid = malloc ((size_t) surface->w * surface->h + 1);
+    if (grid->grid == NULL) {
+        printf ("Error! Not enough memory\n");
+        return 1;
+    }
+    /* Treat the surface as one band of runs */
+    memset (&band, 0, sizeof (LCMAP_Band));
+    band.grid = grid->grid;
+    band.height = surface->h;
+    band.map = map;
+    band.mark = mark;
     if (SDL_MUSTLOCK (surface))
         SDL_LockSurface (surface);
-    pos = 0;
-    x = 0;
-    while (pos < unpackedlen) {
-        value = *data >> 2;
-        flags = *data & LCMAP_FLAG_MASK;
-        if (flags) {
-            if (flags == LCMAP_FLAG_8BIT) {
-                loop = 1 + *(data + 1);
-                pos++;
-                data++;
-            } else if (flags == LCMAP_FLAG_16BIT) {
-                loop = 1 + (*(data + 1) | *(data + 2) << 8);
-                pos += 2;
-                data += 2;
-            } else if (flags == LCMAP_FLAG_24BIT) {
-                loop =
-                    0 + (*(data + 1) | *(data + 2) << 8 | *(data + 3) << 16);
-                pos += 3;
-                data += 3;
-            } else {
-                printf
-                    ("Unrecognized flag in LCMAP. (This shouldn't happen, file corrupted ?)\n");
-                loop = 1;
-            }
-        } else
-            loop = 1;
-        while (loop) {
-            if (x == width) {
-                pixels += surface->pitch - surface->w;
-                x = 0;
-            }
-            *pixels = value;
-            pixels++;
-            if (pixels >=
-                (Uint8 *) surface->pixels + surface->pitch * surface->h)
-                loop = 1;
-            x++;
-            loop--;
+    for (y = 0; y < grid->height; y++) {
+        row = (Uint8 *) surface->pixels + (size_t) y * surface->pitch;
+        for (x = 0; x < grid->width; x += n) {
+            for (n = 1; x + n < grid->width && row[x + n] == row[x]; n++);
+            fill_grid (&band, x, y, n, row[x]);
         }
-        data++;
-        pos++;
     }
     if (SDL_MUSTLOCK (surface))
         SDL_UnlockSurface (surface);
-    free (dataptr);
-    return surface;
+    memcpy (grid->count, band.count, sizeof (band.count));
+    grid->marks = band.marks;
+    grid->markcount = band.markcount;
+    return 0;
+}
+
+/* Free the grid data */
+void lcmap_free_grid (LCMAP_Grid * grid)
+{
+    free (grid->grid);
+    free (grid->marks);
+    grid->grid = NULL;
+    grid->marks = NULL;
 }
 
 SDL_Surface *lcmap_to_surface (Uint8 * lcmap, int len)
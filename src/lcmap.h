@@ -26,8 +26,29 @@
 
 #include "SDL.h"
 
+/* A collision map decoded straight into a column major grid */
+typedef struct {
+    Uint32 width, height;
+    Uint8 *grid;                /* Value of (x,y) is grid[x*height+y] */
+    int ncolors;
+    SDL_Color palette[256];
+    Uint32 count[256];          /* Number of pixels of each value */
+    Uint32 *marks;              /* x,y pairs of the marked pixels, by row */
+    Uint32 markcount;
+} LCMAP_Grid;
+
 extern SDL_Surface *lcmap_to_surface (Uint8 * lcmap, int len);
 extern SDL_Surface *lcmap_to_surface_rw (SDL_RWops * rw);
 extern Uint8 *surface_to_lcmap (Uint32 * len, SDL_Surface * surface);
 
+/* Decode an LCMAP into a grid in one pass, translating each value */
+/* through map (if not NULL). Pixels whose translated value is mark */
+/* are listed. Returns nonzero on error */
+extern int lcmap_to_grid_rw (SDL_RWops * rw, const Uint8 * map, int mark,
+                             LCMAP_Grid * grid);
+/* The same for an 8 bit surface */
+extern int surface_to_grid (SDL_Surface * surface, const Uint8 * map,
+                            int mark, LCMAP_Grid * grid);
+extern void lcmap_free_grid (LCMAP_Grid * grid);
+
 #endif
@@ -29,7 +29,7 @@
 #include "lconf.h"
 #include "parser.h"
 
-static void parse_main_block(struct dllist *values,struct LSB_Main *mainb) {
+static void parse_main_block(const struct ConfigBlock *block,struct LSB_Main *mainb) {
     struct Translate tr[] = {
         {"collisionmap", CFG_STRING, &mainb->collmap},
         {"artwork", CFG_STRING, &mainb->artwork},
@@ -41,10 +41,10 @@ static void parse_main_block(struct dllist *values,struct LSB_Main *mainb) {
         {0,0,0}
     };
 
-    translate_config(values,tr,0);
+    translate_config(block,tr,0);
 }
 
-static struct LSB_Override *parse_override_block(struct dllist *values,
+static struct LSB_Override *parse_override_block(const struct ConfigBlock *block,
         struct LSB_Override *override) {
     struct Translate tr[] = {
         {"critters", CFG_INT, &override->critters},
@@ -71,7 +71,7 @@ static struct LSB_Override *parse_override_block(struct dllist *values,
     override->birds = -1;
     override->bats = -1;
 
-    translate_config(values,tr,0);
+    translate_config(block,tr,0);
 
     return override;
 }
@@ -92,7 +92,7 @@ const char *obj2str(ObjectType obj) {
     return "<unknown>";
 }
 
-static struct LSB_Object *parse_object_block(struct dllist *values,
+static struct LSB_Object *parse_object_block(const struct ConfigBlock *block,
         struct LSB_Object *object)
 {
     char *typestr;
@@ -112,7 +112,7 @@ static struct LSB_Object *parse_object_block(struct dllist *values,
     object->id = 0; object->link = 0;
 
 
-    translate_config(values,tr,0);
+    translate_config(block,tr,0);
 
     if(typestr==NULL) {
         fprintf(stderr,"Warning: an object without a type!\n");
@@ -158,19 +158,18 @@ static int name2terrain(const char *name) {
     return terrain;
 }
 
-static void parse_palette_block(struct dllist *values,struct LSB_Palette *palette) {
+static void parse_palette_block(const struct ConfigBlock *block,struct LSB_Palette *palette) {
+    int r;
 
     memset(palette->entries,0,256);
-    while(values) {
-        struct KeyValue *pair = values->data;
+    for(r=0;r<block->count;r++) {
+        const struct KeyValue *pair = &block->values[r];
         int mapto;
-        if(pair==NULL || pair->key==NULL || pair->value==NULL) {
+        if(pair->key==NULL || pair->value==NULL) {
             fprintf(stderr,"Malformed palette entry:\n");
             fprintf(stderr,"\t\"%s\" = \"%s\"\n",pair->key?pair->key:"(null)",
                     pair->value?pair->value:"(null)");
-            values = values->next;
             continue;
-
         }
         mapto = name2terrain(pair->value);
         if(strchr(pair->key,'-')) { /* Range */
@@ -178,7 +177,6 @@ static void parse_palette_block(struct dllist *values,struct LSB_Palette *palett
             if(sscanf(pair->key,"%d - %d",&from,&to)!=2) {
                 fprintf(stderr,"Malformed palette entry:\n");
                 fprintf(stderr,"\t\"%s\" = \"%s\"\n",pair->key,pair->value);
-                values = values->next;
                 continue;
             }
             if(from<0 || from>255 || to<0 || to>255) {
@@ -199,7 +197,6 @@ static void parse_palette_block(struct dllist *values,struct LSB_Palette *palett
                 palette->entries[index] = mapto;
             }
         }
-        values = values->next;
     }
 }
 
@@ -230,11 +227,11 @@ static void set_default_palette(struct LSB_Palette *palette) {
 }
 
 /* Load the configuration file from file */
-static struct LevelSettings *parse_level_config(struct dllist *config,
+static struct LevelSettings *parse_level_config(struct ConfigFile *config,
         const char *filename)
 {
     struct LevelSettings *settings;
-    struct dllist *cfgptr;
+    int b;
 
     settings = malloc (sizeof (struct LevelSettings));
 
@@ -242,7 +239,7 @@ static struct LevelSettings *parse_level_config(struct dllist *config,
     settings->mainblock.artwork = NULL;
     settings->mainblock.thumbnail = NULL;
     settings->mainblock.name = NULL;
-    settings->mainblock.thumbnail = NULL;
+    settings->mainblock.collmap = NULL;
     settings->mainblock.aspect = 1;
     settings->mainblock.zoom = 1;
     settings->mainblock.music = NULL;
@@ -251,38 +248,34 @@ static struct LevelSettings *parse_level_config(struct dllist *config,
 
     settings->override = NULL;
     settings->objects = NULL;
-    settings->thumbnail = NULL;
 
-    cfgptr = config;
-    while(cfgptr) {
-        struct ConfigBlock *block=cfgptr->data;
+    for(b=0;b<config->count;b++) {
+        const struct ConfigBlock *block=&config->blocks[b];
         if(block->title==NULL || strcmp(block->title,"main")==0)
-            parse_main_block(block->values,&settings->mainblock);
+            parse_main_block(block,&settings->mainblock);
         else if(strcmp(block->title,"override")==0) {
             settings->override = malloc(sizeof(struct LSB_Override));
             if(!settings->override) {
                 perror("parse_level_config");
                 return NULL;
             }
-            parse_override_block(block->values,settings->override);
+            parse_override_block(block,settings->override);
         } else if(strcmp(block->title,"object")==0) {
             struct LSB_Object *newobj = malloc(sizeof(struct LSB_Object));
             if(!newobj) {
                 perror("parse_level_config");
                 return NULL;
             }
-            parse_object_block(block->values,newobj);
+            parse_object_block(block,newobj);
             if(settings->objects)
                 dllist_append(settings->objects,newobj);
             else
                 settings->objects=dllist_append(NULL,newobj);
         } else if(strcmp(block->title,"palette")==0)
-            parse_palette_block(block->values,&settings->palette);
+            parse_palette_block(block,&settings->palette);
         else if(strncmp(block->title,"end",3)==0 || strcmp(block->title,"objects")==0) {
             /* Silently ignore [end*] and [objects] blocks for now */
         } else fprintf(stderr,"%s: Unknown block \"%s\"\n",filename,block->title);
-            
-        cfgptr = cfgptr->next;
     }
 
     return settings;
@@ -291,7 +284,7 @@ static struct LevelSettings *parse_level_config(struct dllist *config,
 /* Load the configuration file from file */
 struct LevelSettings *load_level_config (const char *filename) {
     struct LevelSettings *settings;
-    struct dllist *config;
+    struct ConfigFile *config;
 
     config = read_config_file(filename,0);
     if(!config) {
@@ -300,7 +293,7 @@ struct LevelSettings *load_level_config (const char *filename) {
     }
 
     settings = parse_level_config(config,filename);
-    dllist_free(config,free_config_file);
+    free_config_file(config);
 
     return settings;
 }
@@ -310,7 +303,7 @@ struct LevelSettings *load_level_config_rw (SDL_RWops * rw, size_t len,
         const char *filename)
 {
     struct LevelSettings *settings;
-    struct dllist *config;
+    struct ConfigFile *config;
 
     if(rw==NULL) return NULL;
 
@@ -321,8 +314,19 @@ struct LevelSettings *load_level_config_rw (SDL_RWops * rw, size_t len,
     }
 
     settings = parse_level_config(config,filename);
-    dllist_free(config,free_config_file);
+    free_config_file(config);
 
     return settings;
 }
 
+/* Free level settings */
+void free_level_config (struct LevelSettings *settings) {
+    free(settings->mainblock.artwork);
+    free(settings->mainblock.collmap);
+    free(settings->mainblock.name);
+    free(settings->mainblock.thumbnail);
+    dllist_free(settings->mainblock.music,free);
+    free(settings->override);
+    dllist_free(settings->objects,free);
+    free(settings);
+}
@@ -80,8 +80,6 @@ struct LevelSettings {
     struct LSB_Palette palette;     /* All levels define a palette */
     struct LSB_Override *override;  /* Some levels may override settings */
     struct dllist *objects;         /* Some levels may specify objects */
-    /* Thumbnail is loaded afterwards from the file named in mainblock */
-    SDL_Surface *thumbnail;
 };
 
 /* Load level configuration from a file */
@@ -91,6 +89,9 @@ struct LevelSettings *load_level_config (const char *filename);
 /* The filename is used just for error messages */
 struct LevelSettings *load_level_config_rw (SDL_RWops * rw, size_t len, const char *filename);
 
+/* Free level settings */
+extern void free_level_config (struct LevelSettings *settings);
+
 /* Object type string */
 extern const char *obj2str(ObjectType obj);
 
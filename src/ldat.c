@@ -24,15 +24,31 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "SDL.h"
 #include "SDL_endian.h"
+#include <zlib.h>
 
 #include "ldat.h"
 
 #define LDAT_MAGIC_LEN 6
 #define LDAT_HEADER_LEN 8
 
+/* Catalog entry length without the ID string */
+#define LDAT1_ENTRY_LEN 11
+#define LDAT2_ENTRY_LEN 20
+
+/* Item data alignment. Items larger than a page start at a page boundary */
+#define LDAT_ITEM_ALIGN 16
+#define LDAT_PAGE_SIZE 4096
+
 /* Utility functions, equivalent to SDL_ReadLE??, except
  * with error checking
  */
@@ -59,6 +75,83 @@ int Luola_ReadLE32(SDL_RWops *src,Uint32 *value)
 
 #endif
 
+/* Hash an item ID string */
+static Uint32 ldat_hash_id (const char *id)
+{
+    Uint32 hash = 5381;
+    while (*id)
+        hash = hash * 33 + (Uint8) *id++;
+    return hash;
+}
+
+/* Free the catalog index */
+static void ldat_free_index (LDAT * ldat)
+{
+    Uint32 i;
+    if (ldat->idcount) {
+        for (i = 0; i < ldat->index_size; i++) {
+            while (ldat->idcount[i]) {
+                LDAT_IDCount *next = ldat->idcount[i]->hashnext;
+                free (ldat->idcount[i]);
+                ldat->idcount[i] = next;
+            }
+        }
+        free (ldat->idcount);
+    }
+    free (ldat->index);
+    ldat->index = NULL;
+    ldat->idcount = NULL;
+    ldat->index_size = 0;
+}
+
+/* Build a hash index of the catalog for fast lookups. */
+/* If this fails, lookups fall back to walking the catalog */
+static void ldat_build_index (LDAT * ldat)
+{
+    LDAT_Block *block;
+    Uint32 size = 16;
+    while (size < ldat->items * 2u)
+        size <<= 1;
+
+    ldat->index = calloc (size, sizeof (LDAT_Block *));
+    ldat->idcount = calloc (size, sizeof (LDAT_IDCount *));
+    if (ldat->index == NULL || ldat->idcount == NULL) {
+        perror (__func__);
+        free (ldat->index);
+        free (ldat->idcount);
+        ldat->index = NULL;
+        ldat->idcount = NULL;
+        return;
+    }
+    ldat->index_size = size;
+
+    for (block = ldat->catalog; block; block = block->next) {
+        Uint32 hash = ldat_hash_id (block->ID);
+        Uint32 bucket = (hash + block->index * 2654435761u) & (size - 1);
+        LDAT_IDCount *idc;
+        block->hashnext = ldat->index[bucket];
+        ldat->index[bucket] = block;
+
+        bucket = hash & (size - 1);
+        for (idc = ldat->idcount[bucket]; idc; idc = idc->hashnext)
+            if (strcmp (idc->ID, block->ID) == 0)
+                break;
+        if (idc == NULL) {
+            idc = malloc (sizeof (LDAT_IDCount));
+            if (idc == NULL) {
+                perror (__func__);
+                ldat_free_index (ldat);
+                return;
+            }
+            idc->ID = block->ID;
+            idc->count = 0;
+            idc->hashnext = ldat->idcount[bucket];
+            ldat->idcount[bucket] = idc;
+        }
+        idc->count++;
+    }
+}
+
 /* Check if a file is an LDAT archive */
 int is_ldat(const char *filename)
 {
@@ -104,7 +197,7 @@ LDAT *ldat_open_rw (SDL_RWops * rw)
         fprintf (stderr,"Error: this is not an LDAT archive !\n");
         return NULL;
     }
-    if (header[4] != LDAT_MAJOR) {
+    if (header[4] < 1 || header[4] > LDAT_MAJOR) {
         fprintf (stderr, "Error: Unsupported version (%d.%d) !\n", header[4],
                 header[5]);
         fprintf (stderr, "Latest supported version is %d.%d\n", LDAT_MAJOR,
@@ -138,10 +231,25 @@ LDAT *ldat_open_rw (SDL_RWops * rw)
             fprintf (stderr, "(%d) Error occured while reading position!\n", i);
             return NULL;
         }
-        if (Luola_ReadLE32(newldat->data, &newblock->size) == -1) {
+        if (Luola_ReadLE32(newldat->data, &newblock->stored) == -1) {
             fprintf (stderr, "(%d) Error occured while reading size!\n", i);
             return NULL;
         }
+        newblock->size = newblock->stored;
+        if (header[4] >= 2) {
+            if (Luola_ReadLE32(newldat->data, &newblock->size) == -1 ||
+                    SDL_RWread (newldat->data, &newblock->codec, 1, 1) == -1 ||
+                    Luola_ReadLE32(newldat->data, &newblock->crc) == -1) {
+                fprintf (stderr, "(%d) Error occured while reading codec!\n", i);
+                return NULL;
+            }
+            newblock->unverified = 1;
+            if (newblock->codec > LDAT_CODEC_ZLIB) {
+                fprintf (stderr, "(%d) Unsupported codec %d!\n", i,
+                        newblock->codec);
+                return NULL;
+            }
+        }
         if (newldat->catalog == NULL)
             newldat->catalog = newblock;
         else {
@@ -151,9 +259,11 @@ LDAT *ldat_open_rw (SDL_RWops * rw)
         }
     }
     newldat->catalog_size = SDL_RWtell (newldat->data) - LDAT_HEADER_LEN;
+    newldat->items = itemcount;
     /* Rewing catalog */
     while (newldat->catalog->prev)
         newldat->catalog = newldat->catalog->prev;
+    ldat_build_index (newldat);
     return newldat;
 }
 
@@ -169,11 +279,60 @@ LDAT *ldat_open_file (const char *filename)
     return ldat_open_rw (rw);
 }
 
+/* Open a file for reading by mapping it to memory */
+LDAT *ldat_map_file (const char *filename)
+{
+#ifndef WIN32
+    struct stat st;
+    SDL_RWops *rw;
+    LDAT *ldat;
+    void *map;
+    int fd;
+    fd = open (filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf (stderr, "Could not open file \"%s\"\n", filename);
+        return NULL;
+    }
+    if (fstat (fd, &st) || st.st_size == 0) {
+        close (fd);
+        return ldat_open_file (filename);
+    }
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        perror (filename);
+        return ldat_open_file (filename);
+    }
+    rw = SDL_RWFromConstMem (map, st.st_size);
+    if (rw == NULL) {
+        munmap (map, st.st_size);
+        return ldat_open_file (filename);
+    }
+    ldat = ldat_open_rw (rw);
+    if (ldat == NULL) {
+        SDL_RWclose (rw);
+        munmap (map, st.st_size);
+        return NULL;
+    }
+    ldat->map = map;
+    ldat->map_len = st.st_size;
+    return ldat;
+#else
+    return ldat_open_file (filename);
+#endif
+}
+
 /* Close the LDAT (read/write only to cache) */
 void ldat_close (LDAT * ldat)
 {
     if (ldat->data)
         SDL_RWclose (ldat->data);
+    ldat->data = NULL;
+#ifndef WIN32
+    if (ldat->map)
+        munmap (ldat->map, ldat->map_len);
+#endif
+    ldat->map = NULL;
 }
 
 /* Close and free the LDAT structure */
@@ -181,11 +340,13 @@ void ldat_free (LDAT * ldat)
 {
     LDAT_Block *next;
     ldat_close (ldat);
+    ldat_free_index (ldat);
     while (ldat->catalog) {
         next = ldat->catalog->next;
         free(ldat->catalog->ID);
         if (ldat->catalog->data)
             SDL_FreeRW (ldat->catalog->data);
+        free (ldat->catalog->buffer);
         free (ldat->catalog);
         ldat->catalog = next;
     }
@@ -197,6 +358,8 @@ void ldat_put_item (LDAT * ldat,char *id, int item, SDL_RWops * data,
                     Uint32 len)
 {
     LDAT_Block *newitem, *catalog;
+    /* The index is only used for reading */
+    ldat_free_index (ldat);
     catalog = ldat->catalog;
     if (catalog)
         while (catalog->next) {
@@ -216,43 +379,70 @@ void ldat_put_item (LDAT * ldat,char *id, int item, SDL_RWops * data,
     else
         ldat->catalog = newitem;
     ldat->items++;
-    ldat->catalog_size += 11 + strlen (id);
+    ldat->catalog_size += LDAT2_ENTRY_LEN + strlen (id);
 }
 
-/* Fix things before saving */
-/* Set the correct positions for files */
-static void ldat_fixup (LDAT * ldat)
+/* Get the position of an item of the given size */
+static Uint32 ldat_align (Uint32 pos, Uint32 size)
 {
-    LDAT_Block *block = ldat->catalog;
-    Uint32 latest;
-    latest = LDAT_HEADER_LEN + ldat->catalog_size;
-    while (block) {
-        block->pos = latest;
-        latest += block->size;
-        block = block->next;
-    }
+    Uint32 align = size >= LDAT_PAGE_SIZE ? LDAT_PAGE_SIZE : LDAT_ITEM_ALIGN;
+    return (pos + align - 1) & ~(align - 1);
 }
 
-/* Copy from one SDL_RWops to another */
-static int rw_to_rw_copy (SDL_RWops * dest, SDL_RWops * src, Uint32 len)
+/* Read an item into memory, checksum it and compress it if requested */
+static int ldat_pack_item (LDAT * ldat, LDAT_Block * block)
 {
-    Uint8 buffer[1024];
-    Uint32 copied = 0, read, toread;
-    while (copied < len) {
-        if (len - copied < sizeof(buffer))
-            toread = len - copied;
-        else
-            toread = sizeof(buffer);
-        read = SDL_RWread (src, buffer, 1, toread);
-        if(read==0) {
-            fprintf(stderr,"rw_to_rw_copy:%d: %s\n",read, SDL_GetError());
-            return 1;
+    Uint8 *raw, *packed;
+    uLongf len;
+    raw = malloc (block->size ? block->size : 1);
+    if (raw == NULL) {
+        perror (__func__);
+        return 1;
+    }
+    if (block->size &&
+            SDL_RWread (block->data, raw, 1, block->size) != block->size) {
+        fprintf (stderr, "%s: %s\n", __func__, SDL_GetError ());
+        free (raw);
+        return 1;
+    }
+    block->crc = crc32 (0L, raw, block->size);
+    block->codec = LDAT_CODEC_NONE;
+    block->stored = block->size;
+    block->buffer = raw;
+    if (ldat->compress && block->size > 0) {
+        len = compressBound (block->size);
+        packed = malloc (len);
+        if (packed && compress2 (packed, &len, raw, block->size,
+                    Z_BEST_COMPRESSION) == Z_OK && len < block->size) {
+            free (raw);
+            block->buffer = packed;
+            block->stored = len;
+            block->codec = LDAT_CODEC_ZLIB;
+        } else {
+            free (packed);
         }
-        if(SDL_RWwrite (dest, buffer, 1, read)==0) {
-            fprintf(stderr,"rw_to_rw_copy:%d: %s\n",read, SDL_GetError());
+    }
+    return 0;
+}
+
+/* Fix things before saving */
+/* Pack the items and set the correct positions for them */
+static int ldat_fixup (LDAT * ldat)
+{
+    LDAT_Block *block;
+    Uint32 latest;
+    ldat->catalog_size = 0;
+    for (block = ldat->catalog; block; block = block->next)
+        ldat->catalog_size += LDAT2_ENTRY_LEN + strlen (block->ID);
+    latest = LDAT_HEADER_LEN + ldat->catalog_size;
+    for (block = ldat->catalog; block; block = block->next) {
+        if (block->buffer == NULL && ldat_pack_item (ldat, block)) {
+            fprintf(stderr,"Error occured in block \"%s\" %d\n",
+                    block->ID,block->index);
             return 1;
         }
-        copied += read;
+        block->pos = ldat_align (latest, block->stored);
+        latest = block->pos + block->stored;
     }
     return 0;
 }
@@ -260,34 +450,44 @@ static int rw_to_rw_copy (SDL_RWops * dest, SDL_RWops * src, Uint32 len)
 /* Save LDAT into an SDL_RWops */
 int ldat_save_rw (LDAT * ldat, SDL_RWops * rw)
 {
-    LDAT_Block *block = ldat->catalog;
+    static const Uint8 padding[LDAT_PAGE_SIZE];
+    LDAT_Block *block;
     char header[LDAT_MAGIC_LEN] = "LDAT00";
+    Uint32 written;
     Uint8 idlen;
+    if (ldat_fixup (ldat))
+        return 1;
     /* Write header */
     header[4] = LDAT_MAJOR;
     header[5] = LDAT_MINOR;
     SDL_RWwrite (rw, &header, 1, LDAT_MAGIC_LEN);
-    SDL_RWwrite (rw, &ldat->items, 2, 1);
+    SDL_WriteLE16 (rw, ldat->items);
     /* Write catalog */
-    ldat_fixup (ldat);
-    while (block) {
+    for (block = ldat->catalog; block; block = block->next) {
         idlen = strlen (block->ID);
         SDL_RWwrite (rw, &idlen, 1, 1);
         SDL_RWwrite (rw, block->ID, 1, idlen);
-        SDL_RWwrite (rw, &block->index, 2, 1);
-        SDL_RWwrite (rw, &block->pos, 4, 1);
-        SDL_RWwrite (rw, &block->size, 4, 1);
-        block = block->next;
+        SDL_WriteLE16 (rw, block->index);
+        SDL_WriteLE32 (rw, block->pos);
+        SDL_WriteLE32 (rw, block->stored);
+        SDL_WriteLE32 (rw, block->size);
+        SDL_RWwrite (rw, &block->codec, 1, 1);
+        SDL_WriteLE32 (rw, block->crc);
     }
     /* Write data */
-    block = ldat->catalog;
-    while (block) {
-        if(rw_to_rw_copy (rw, block->data, block->size)) {
-            fprintf(stderr,"Error occured in block \"%s\" %d\n",
-                    block->ID,block->index);
+    written = LDAT_HEADER_LEN + ldat->catalog_size;
+    for (block = ldat->catalog; block; block = block->next) {
+        if ((block->pos > written && SDL_RWwrite (rw, padding, 1,
+                            block->pos - written) == 0) ||
+                (block->stored && SDL_RWwrite (rw, block->buffer, 1,
+                                               block->stored) == 0)) {
+            fprintf(stderr,"Error occured in block \"%s\" %d: %s\n",
+                    block->ID,block->index,SDL_GetError());
             return 1;
         }
-        block = block->next;
+        written = block->pos + block->stored;
+        free (block->buffer);
+        block->buffer = NULL;
     }
     return 0;
 }
@@ -312,6 +512,14 @@ int ldat_save_file (LDAT * ldat,const char *filename)
 LDAT_Block *ldat_find_item (const LDAT * ldat, const char *id, int item)
 {
     LDAT_Block *block = ldat->catalog;
+    if (ldat->index) {
+        Uint32 bucket = (ldat_hash_id (id) + item * 2654435761u) &
+            (ldat->index_size - 1);
+        for (block = ldat->index[bucket]; block; block = block->hashnext)
+            if (block->index == item && strcmp (block->ID, id) == 0)
+                return block;
+        return NULL;
+    }
     while (block) {
         if (block->index == item && strcmp (block->ID, id) == 0)
             return block;
@@ -325,6 +533,14 @@ int ldat_get_item_count (const LDAT * ldat, const char *id)
 {
     LDAT_Block *block = ldat->catalog;
     int count=0;
+    if (ldat->idcount) {
+        LDAT_IDCount *idc = ldat->idcount[ldat_hash_id (id) &
+            (ldat->index_size - 1)];
+        for (; idc; idc = idc->hashnext)
+            if (strcmp (idc->ID, id) == 0)
+                return idc->count;
+        return 0;
+    }
     while (block) {
         if (strcmp (block->ID, id) == 0)
             count++;
@@ -333,6 +549,93 @@ int ldat_get_item_count (const LDAT * ldat, const char *id)
     return count;
 }
 
+/* Decompress an item and verify its checksum. */
+/* The unpacked data is cached in the block */
+static SDL_RWops *ldat_unpack_item (const LDAT * ldat, LDAT_Block * block)
+{
+    Uint8 *packed, *unpacked;
+    uLongf len = block->size;
+    int ok;
+    if (ldat->map) {
+        if (block->pos + block->stored > ldat->map_len) {
+            fprintf (stderr,"Item \"%s\" %d is past the end of the archive\n",
+                    block->ID, block->index);
+            return NULL;
+        }
+        packed = (Uint8 *) ldat->map + block->pos;
+    } else {
+        packed = malloc (block->stored);
+        if (packed == NULL) {
+            perror (__func__);
+            return NULL;
+        }
+        SDL_RWseek (ldat->data, block->pos, SEEK_SET);
+        if (SDL_RWread (ldat->data, packed, 1, block->stored) !=
+                block->stored) {
+            fprintf (stderr,"Could not read item \"%s\" %d\n",
+                    block->ID, block->index);
+            free (packed);
+            return NULL;
+        }
+    }
+    unpacked = malloc (block->size ? block->size : 1);
+    if (unpacked == NULL) {
+        perror (__func__);
+        ok = 0;
+    } else {
+        ok = uncompress (unpacked, &len, packed, block->stored) == Z_OK &&
+            len == block->size;
+        if (!ok)
+            fprintf (stderr,"Item \"%s\" %d is corrupt\n",
+                    block->ID, block->index);
+        else if (crc32 (0L, unpacked, len) != block->crc) {
+            fprintf (stderr,"Checksum mismatch in item \"%s\" %d\n",
+                    block->ID, block->index);
+            ok = 0;
+        }
+    }
+    if (ldat->map == NULL)
+        free (packed);
+    if (!ok) {
+        free (unpacked);
+        return NULL;
+    }
+    block->buffer = unpacked;
+    block->data = SDL_RWFromConstMem (unpacked, block->size);
+    return block->data;
+}
+
+/* Verify the checksum of an uncompressed item */
+/* Returns 0 if the item is intact */
+static int ldat_verify_item (const LDAT * ldat, LDAT_Block * block)
+{
+    uLong crc = crc32 (0L, Z_NULL, 0);
+    if (ldat->map) {
+        crc = crc32 (crc, (Uint8 *) ldat->map + block->pos, block->size);
+    } else {
+        Uint8 buf[4096];
+        Uint32 left = block->size;
+        SDL_RWseek (ldat->data, block->pos, SEEK_SET);
+        while (left > 0) {
+            Uint32 len = left < sizeof (buf) ? left : sizeof (buf);
+            if (SDL_RWread (ldat->data, buf, 1, len) != len) {
+                fprintf (stderr,"Could not read item \"%s\" %d\n",
+                        block->ID, block->index);
+                return 1;
+            }
+            crc = crc32 (crc, buf, len);
+            left -= len;
+        }
+    }
+    if (crc != block->crc) {
+        fprintf (stderr,"Checksum mismatch in item \"%s\" %d\n",
+                block->ID, block->index);
+        return 1;
+    }
+    block->unverified = 0;
+    return 0;
+}
+
 /* Get a file from the archive */
 SDL_RWops *ldat_get_item (const LDAT * ldat,const char *id, int item)
 {
@@ -344,13 +647,48 @@ SDL_RWops *ldat_get_item (const LDAT * ldat,const char *id, int item)
                 id, item);
         return NULL;
     }
-    if (block->data)
+    if (block->data) {
+        if (ldat->map || block->buffer)
+            SDL_RWseek (block->data, 0, SEEK_SET);
         return block->data;
+    }
+    if (block->codec == LDAT_CODEC_ZLIB)
+        return ldat_unpack_item (ldat, block);
+    if (ldat->map) {
+        /* Each item gets its own view of the mapped file */
+        if (block->pos + block->size > ldat->map_len) {
+            fprintf (stderr,"Item \"%s\" %d is past the end of the archive\n",
+                    id, item);
+            return NULL;
+        }
+        if (block->unverified && ldat_verify_item (ldat, block))
+            return NULL;
+        block->data = SDL_RWFromConstMem ((Uint8 *) ldat->map + block->pos,
+                block->size);
+        return block->data;
+    }
+    if (block->unverified && ldat_verify_item (ldat, block))
+        return NULL;
     data = ldat->data;
     SDL_RWseek (data, block->pos, SEEK_SET);
     return data;
 }
 
+/* Get a new SDL_RWops for an item that is in memory */
+SDL_RWops *ldat_open_item (const LDAT * ldat, const char *id, int item)
+{
+    LDAT_Block *block;
+    if (ldat_get_item (ldat, id, item) == NULL)
+        return NULL;
+    block = ldat_find_item (ldat, id, item);
+    if (block->buffer)
+        return SDL_RWFromConstMem (block->buffer, block->size);
+    if (ldat->map)
+        return SDL_RWFromConstMem ((Uint8 *) ldat->map + block->pos,
+                block->size);
+    return NULL;
+}
+
 /* Get the length of the item */
 int ldat_get_item_length (const LDAT * ldat,const char *id, int item)
 {
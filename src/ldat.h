@@ -26,27 +26,54 @@
 
 #include "SDL_rwops.h"
 
-#define LDAT_MAJOR	0x01
+#define LDAT_MAJOR	0x02
 #define LDAT_MINOR	0x00
 
+/* Item compression codecs */
+#define LDAT_CODEC_NONE	0x00
+#define LDAT_CODEC_ZLIB	0x01
+
 /* A structure to hold a catalog item */
 typedef struct LDAT_Block {
     char *ID;
     Uint16 index;
-    Uint32 size;
+    Uint32 size;                /* Unpacked size */
     Uint32 pos;
+    Uint32 stored;              /* Size inside the archive */
+    Uint8 codec;
+    Uint32 crc;                 /* CRC32 of the unpacked data */
+    Uint8 unverified;           /* CRC32 has not been checked yet */
     SDL_RWops *data;            /* cache */
+    Uint8 *buffer;              /* Unpacked or packed item data */
 
     struct LDAT_Block *prev;
     struct LDAT_Block *next;
+    struct LDAT_Block *hashnext; /* Next block in the same hash bucket */
 } LDAT_Block;
 
+/* Number of items with the same ID */
+typedef struct LDAT_IDCount {
+    const char *ID;
+    int count;
+    struct LDAT_IDCount *hashnext;
+} LDAT_IDCount;
+
 /* A structure to handle the LDAT file */
 typedef struct {
     LDAT_Block *catalog;
     Uint16 items;
     Uint32 catalog_size;
     SDL_RWops *data;
+    int compress;               /* Compress items when saving */
+
+    /* Catalog index. Built when an archive is opened for reading */
+    LDAT_Block **index;         /* Blocks hashed by ID and index */
+    LDAT_IDCount **idcount;     /* Item counts hashed by ID */
+    Uint32 index_size;          /* Number of buckets (a power of two) */
+
+    /* Memory mapped archive */
+    void *map;
+    Uint32 map_len;
 } LDAT;
 
 
@@ -60,6 +87,11 @@ extern LDAT *ldat_open_rw (SDL_RWops * rw);
 /* Open a file for reading */
 extern LDAT *ldat_open_file (const char *filename);
 
+/* Open a file for reading by mapping it to memory. Each item gets */
+/* its own read only SDL_RWops, so several items can be read at once. */
+/* Falls back to ldat_open_file if mapping is not possible */
+extern LDAT *ldat_map_file (const char *filename);
+
 /* Creates an empty LDAT structure */
 extern LDAT *ldat_create (void);
 
@@ -76,9 +108,17 @@ extern void ldat_close (LDAT * ldat);
 extern void ldat_free (LDAT * ldat);
 
 /** LDAT reading functions **/
-/* Get a file from the archive */
+/* Get a file from the archive. The returned SDL_RWops belongs to the */
+/* LDAT and must not be closed. Unless the archive is memory mapped */
+/* or the item is compressed, all items share the same SDL_RWops */
 extern SDL_RWops *ldat_get_item (const LDAT * ldat, const char *id, int item);
 
+/* Get a new SDL_RWops of its own for a memory mapped or compressed item, */
+/* so that several threads can read items at once. The caller must free */
+/* it with SDL_FreeRW. Returns NULL if the item has no data in memory. */
+/* Must not be called at the same time as ldat_get_item */
+extern SDL_RWops *ldat_open_item (const LDAT * ldat, const char *id, int item);
+
 /* Get the length of the item */
 extern int ldat_get_item_length (const LDAT * ldat, const char *id, int item);
 
@@ -34,8 +34,12 @@
 #include "decor.h"
 #include "animation.h"
 #include "ship.h"   /* for bump_ship() */
+#include "jobs.h"
+#include "nav.h"
+#include "walker.h"
 
 #define BASE_REGEN_SPEED 9 /* Delay between each regenerated pixel */
+#define LEVEL_CACHE_SIZE 3 /* How many decoded levels are kept */
 
 /* Level effects */
 typedef struct {
@@ -60,8 +64,46 @@ typedef struct {
     int x, y;
 } Star;
 
+/* Cached viewport terrain */
+typedef struct {
+    SDL_Surface *surface;   /* Terrain and stars as seen by the camera */
+    int x, y;               /* Camera position the cache was drawn at */
+    Uint32 stamp;           /* Tiles changed at or after this are stale */
+    int valid;
+} ViewCache;
+
+#define TILE_SHIFT 5        /* Terrain cache tiles are 32x32 pixels */
+
+/* A level decoded into the form load_level needs. Decoded levels are */
+/* kept in a small cache and may be decoded by a worker thread */
+typedef struct {
+    struct LevelFile *level;    /* Which level this is */
+    struct LevelFile file;      /* Private copy for the decoder */
+    SDL_PixelFormat format;     /* Screen format when decoding started */
+    Job *job;                   /* Decoding job, if not finished yet */
+    int speculative;            /* Prefetched but not played yet */
+    unsigned int used;          /* For least recently used eviction */
+    int failed;
+
+    SDL_Surface *art;           /* Terrain graphics in screen format */
+    Uint8 *solid;               /* Terrain types, column by column */
+    int width, height;
+    int freepix, otherpix;
+    SDL_Color water;
+    SDL_Color snow;
+    int has_snow;               /* Set if the palette has a snow colour */
+    RegenCoord *base;           /* Base pixels, sorted */
+    int base_area;
+} DecodedLevel;
+
 /* Internally used globals */
 static Star lev_stars[15];
+static ViewCache lev_viewcache[4];
+static Uint32 *lev_tilestamp;   /* When was each tile last changed */
+static int lev_tiles_w, lev_tiles_h;
+static Uint32 lev_frame = 1;
+static DecodedLevel lev_cache[LEVEL_CACHE_SIZE];
+static unsigned int lev_cache_clock;
 
 /* Exported globals */
 Uint32 burncolor[FIRE_FRAMES];
@@ -70,20 +112,9 @@ SDL_Rect cam_rects[4];
 SDL_Rect viewport_rects[4]; /* Use only x and y. w and h get overwritten by SDL_BlitSurface */
 Level lev_level;
 
-/* Bullet hole bitmap */
-#define HOLE_W 9
-#define HOLE_H 9
-static const Uint8 hole_bm[HOLE_H][HOLE_W] = {
-    {1, 1, 1, 1, 0, 1, 1, 1, 1},
-    {1, 1, 1, 0, 0, 0, 1, 1, 1},
-    {1, 0, 0, 0, 0, 0, 0, 0, 1},
-    {1, 0, 0, 0, 0, 0, 0, 0, 1},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {1, 0, 0, 0, 0, 0, 0, 0, 1},
-    {1, 0, 0, 0, 0, 0, 0, 0, 1},
-    {1, 1, 1, 0, 0, 0, 1, 1, 1},
-    {1, 1, 1, 1, 0, 1, 1, 1, 1}
-};
+/* Brush masks. Each holds the half widths of the rows of a circle */
+/* in 1/16 pixels, indexed by distance from the centre row */
+static Uint16 *brush_masks[BRUSH_MAX_RADIUS + 1];
 
 static int touch_wall (int x, int y)
 {
@@ -106,36 +137,180 @@ static int touch_wall (int x, int y)
     return 0;
 }
 
-static void draw_stars (SDL_Rect * cam, SDL_Rect * targ)
+/* Draw stars on the free parts of a cached viewport */
+static void draw_stars (ViewCache *cache)
 {
     int r, x, y;
     Uint8 *col;
     for (r = 0; r < sizeof(lev_stars)/sizeof(Star); r++) {
-        x = cam->x + lev_stars[r].x;
-        y = cam->y + lev_stars[r].y;
+        x = cache->x + lev_stars[r].x;
+        y = cache->y + lev_stars[r].y;
+        if (x >= lev_level.width || y >= lev_level.height)
+            continue;
         col =
             (Uint8 *) lev_level.terrain->pixels +
             y * lev_level.terrain->pitch +
             x * lev_level.terrain->format->BytesPerPixel;
-        if (x < lev_level.width && y < lev_level.height)
-          if (lev_level.solid[x][y] == TER_FREE && col[0] < 5 && col[1] < 5 && col[2] < 5)
-            putpixel (screen, targ->x + lev_stars[r].x,
-                      targ->y + lev_stars[r].y, col_white);
+        if (lev_level.solid[x][y] == TER_FREE && col[0] < 5 && col[1] < 5 && col[2] < 5)
+            putpixel (cache->surface, lev_stars[r].x, lev_stars[r].y,
+                    col_white);
+    }
+}
+
+/* Copy a part of the terrain to a cached viewport. */
+/* Coordinates are relative to the cache */
+static void refresh_cache (ViewCache *cache, int x, int y, int w, int h)
+{
+    SDL_Rect src, dst;
+    if (w <= 0 || h <= 0)
+        return;
+    src.x = cache->x + x;
+    src.y = cache->y + y;
+    src.w = w;
+    src.h = h;
+    dst.x = x;
+    dst.y = y;
+    SDL_BlitSurface (lev_level.terrain, &src, cache->surface, &dst);
+}
+
+/* Move the contents of a cached viewport by dx,dy pixels */
+static void scroll_cache (ViewCache *cache, int dx, int dy)
+{
+    SDL_Surface *s = cache->surface;
+    int bpp = s->format->BytesPerPixel;
+    int w = s->w - abs (dx), h = s->h - abs (dy);
+    int sx = dx < 0 ? -dx : 0, sy = dy < 0 ? -dy : 0;
+    int tx = dx > 0 ? dx : 0, ty = dy > 0 ? dy : 0;
+    int row;
+    Uint8 *pixels = s->pixels;
+
+    if (dy > 0) {
+        /* Rows move down, so copy from the bottom up */
+        for (row = h - 1; row >= 0; row--)
+            memmove (pixels + (ty + row) * s->pitch + tx * bpp,
+                     pixels + (sy + row) * s->pitch + sx * bpp, w * bpp);
+    } else {
+        for (row = 0; row < h; row++)
+            memmove (pixels + (ty + row) * s->pitch + tx * bpp,
+                     pixels + (sy + row) * s->pitch + sx * bpp, w * bpp);
+    }
+}
+
+/* Bring a cached viewport up to date with the camera and terrain */
+static void update_viewcache (ViewCache *cache, SDL_Rect *cam)
+{
+    int dx, dy, tx, ty, tx1, ty1, tx2, ty2, r;
+
+    if (cache->surface == NULL || cache->surface->w != cam->w
+            || cache->surface->h != cam->h) {
+        if (cache->surface)
+            SDL_FreeSurface (cache->surface);
+        cache->surface = make_surface (lev_level.terrain, cam->w, cam->h);
+        cache->valid = 0;
+    }
+
+    dx = cache->x - cam->x;
+    dy = cache->y - cam->y;
+    if (!cache->valid || abs (dx) >= cam->w || abs (dy) >= cam->h) {
+        /* Redraw everything */
+        cache->x = cam->x;
+        cache->y = cam->y;
+        SDL_FillRect (cache->surface, NULL, 0);
+        refresh_cache (cache, 0, 0, cam->w, cam->h);
+        cache->valid = 1;
+    } else {
+        if (dx || dy) {
+            /* Erase stars from their old places */
+            if (level_settings.stars)
+                for (r = 0; r < sizeof(lev_stars)/sizeof(Star); r++)
+                    refresh_cache (cache, lev_stars[r].x, lev_stars[r].y, 1, 1);
+            /* Scroll and fill in the newly exposed strips */
+            scroll_cache (cache, dx, dy);
+            cache->x = cam->x;
+            cache->y = cam->y;
+            if (dx > 0)
+                refresh_cache (cache, 0, 0, dx, cam->h);
+            else if (dx < 0)
+                refresh_cache (cache, cam->w + dx, 0, -dx, cam->h);
+            if (dy > 0)
+                refresh_cache (cache, 0, 0, cam->w, dy);
+            else if (dy < 0)
+                refresh_cache (cache, 0, cam->h + dy, cam->w, -dy);
+        }
+        /* Copy terrain tiles that have changed */
+        tx1 = cam->x >> TILE_SHIFT;
+        ty1 = cam->y >> TILE_SHIFT;
+        tx2 = (cam->x + cam->w - 1) >> TILE_SHIFT;
+        ty2 = (cam->y + cam->h - 1) >> TILE_SHIFT;
+        if (tx2 >= lev_tiles_w) tx2 = lev_tiles_w - 1;
+        if (ty2 >= lev_tiles_h) ty2 = lev_tiles_h - 1;
+        for (ty = ty1; ty <= ty2; ty++) {
+            for (tx = tx1; tx <= tx2; tx++) {
+                if (lev_tilestamp[ty * lev_tiles_w + tx] >= cache->stamp) {
+                    SDL_Rect tr = cliprect ((tx << TILE_SHIFT) - cam->x,
+                            (ty << TILE_SHIFT) - cam->y,
+                            1 << TILE_SHIFT, 1 << TILE_SHIFT,
+                            0, 0, cam->w, cam->h);
+                    refresh_cache (cache, tr.x, tr.y, tr.w, tr.h);
+                }
+            }
+        }
     }
+    if (level_settings.stars)
+        draw_stars (cache);
+    cache->stamp = lev_frame + 1;
+}
+
+/* Update the structures derived from the collision map */
+static void solid_changed (int x, int y, int w, int h)
+{
+    nav_terrain_changed (x, y, w, h);
+    footholds_changed (x, y, w, h);
+}
+
+/* Mark an area of the terrain as changed */
+void mark_terrain_dirty (int x, int y, int w, int h)
+{
+    int tx, ty, tx1, ty1, tx2, ty2;
+    if (lev_tilestamp == NULL)
+        return;
+    tx1 = x < 0 ? 0 : x >> TILE_SHIFT;
+    ty1 = y < 0 ? 0 : y >> TILE_SHIFT;
+    tx2 = (x + w - 1) >> TILE_SHIFT;
+    ty2 = (y + h - 1) >> TILE_SHIFT;
+    if (tx2 >= lev_tiles_w) tx2 = lev_tiles_w - 1;
+    if (ty2 >= lev_tiles_h) ty2 = lev_tiles_h - 1;
+    for (ty = ty1; ty <= ty2; ty++)
+        for (tx = tx1; tx <= tx2; tx++)
+            lev_tilestamp[ty * lev_tiles_w + tx] = lev_frame;
+    solid_changed (x, y, w, h);
+}
+
+/* Change a single pixel of the level graphics */
+void put_terrain_pixel (int x, int y, Uint32 color)
+{
+    if (x < 0 || y < 0 || x >= lev_level.width || y >= lev_level.height)
+        return;
+    putpixel (lev_level.terrain, x, y, color);
+    lev_tilestamp[(y >> TILE_SHIFT) * lev_tiles_w + (x >> TILE_SHIFT)] =
+        lev_frame;
+    solid_changed (x, y, 1, 1);
 }
 
 /* Draw the level for all players */
+/* Each viewport keeps a cached copy of the terrain it shows, */
+/* so only scrolled in strips and changed tiles need to be copied */
 static inline void draw_level (void)
 {
     int p;
     for (p = 0; p < 4; p++) {
         if (players[p].state==ALIVE || players[p].state==DEAD) {
-            SDL_BlitSurface (lev_level.terrain, &cam_rects[p], screen,
+            update_viewcache (&lev_viewcache[p], &cam_rects[p]);
+            SDL_BlitSurface (lev_viewcache[p].surface, NULL, screen,
                              &viewport_rects[p]);
-            if(level_settings.stars)
-                draw_stars (&cam_rects[p], &viewport_rects[p]);
         }
     }
+    lev_frame++;
 }
 
 /* Initialize level subsystem */
@@ -167,6 +342,8 @@ void reinit_stars(void) {
         lev_stars[r].x = rand () % size.w;
         lev_stars[r].y = rand () % size.h;
     }
+    for (r = 0; r < 4; r++)
+        lev_viewcache[r].valid = 0;
 }
 
 /* Find the first occurance of a color in the level palette */
@@ -189,110 +366,246 @@ static int sort_regen(const void *ptr1,const void *ptr2) {
     else return -1;
 }
 
-/* Load level and prepare for new game */
-void load_level (struct LevelFile *lev) {
-    SDL_Surface *collmap;
-    int x, y, p, r;
-    int freepix, otherpix;
-    SDL_Color *tmpcol, defaultwater;
-    Uint8 *bits;
-    int basebufsize;
-
-    defaultwater.r = 0;
-    defaultwater.g = 0;
-    defaultwater.b = 255;
+/* Decode a level. Run by a worker thread or by load_level */
+static void decode_level (void *arg)
+{
+    DecodedLevel *dl = arg;
+    LCMAP_Grid grid;
+    SDL_Palette collpal;
+    SDL_Color *tmpcol;
+    Uint8 *palette;
+    int x, y, r;
 
+    if (open_level (&dl->file)) {
+        dl->failed = 1;
+        return;
+    }
     /* Load level artwork */
-    lev_level.terrain = load_level_art (lev);
-    lev_level.width = lev_level.terrain->w;
-    lev_level.height = lev_level.terrain->h;
-    /* Load level collisionmap */
-    collmap = load_level_coll (lev);
-    if (!collmap) {
+    dl->art = load_level_art (&dl->file, &dl->format);
+    if (dl->art == NULL) {
+        dl->failed = 1;
+        close_level (&dl->file);
+        return;
+    }
+    dl->width = dl->art->w;
+    dl->height = dl->art->h;
+    /* Load level collisionmap straight into a terrain type grid */
+    if (load_level_grid (&dl->file, TER_BASE, &grid)) {
         printf ("An error occured while loading collisionmap\n");
-        exit (1);
+        dl->failed = 1;
+        close_level (&dl->file);
+        return;
     }
-    if (collmap->w != lev_level.width || collmap->h != lev_level.height) {
+    if (grid.width != dl->width || grid.height != dl->height) {
         printf
             ("Error Collision map image \"%s\" has incorrect size (%dx%d), should be %dx%d!\n",
-             lev->settings->mainblock.collmap, collmap->w, collmap->h,
-             lev_level.width, lev_level.height);
-        exit (1);
+             dl->file.settings->mainblock.collmap, grid.width, grid.height,
+             dl->width, dl->height);
+        dl->failed = 1;
+        lcmap_free_grid (&grid);
+        close_level (&dl->file);
+        return;
     }
     /* Get palette entries */
+    palette = dl->file.settings->palette.entries;
+    collpal.ncolors = grid.ncolors;
+    collpal.colors = grid.palette;
     /* Get water colour */
-    tmpcol = &defaultwater;
-    find_color(TER_WATER,lev->settings->palette.entries,
-            collmap->format->palette,&tmpcol);
-    lev_watercol = map_rgba(tmpcol->r, tmpcol->g, tmpcol->b,0xff);
-    /* Calculate underwater clay colour */
-    col_clay_uw = map_rgba((tmpcol->r+255)/2, (tmpcol->r+200)/2, (tmpcol->r+128)/2, 0xff);
+    dl->water.r = 0;
+    dl->water.g = 0;
+    dl->water.b = 255;
+    tmpcol = &dl->water;
+    find_color(TER_WATER,palette,&collpal,&tmpcol);
+    dl->water = *tmpcol;
     /* Get snow colour */
     tmpcol = NULL;
-    find_color(TER_SNOW,lev->settings->palette.entries,
-            collmap->format->palette,&tmpcol);
-    if (tmpcol) {
-        col_snow = map_rgba(tmpcol->r, tmpcol->g, tmpcol->b,0xff);
+    find_color(TER_SNOW,palette,&collpal,&tmpcol);
+    dl->has_snow = tmpcol != NULL;
+    if (tmpcol)
+        dl->snow = *tmpcol;
+    /* The grid is the data map */
+    dl->solid = grid.grid;
+    grid.grid = NULL;
+    dl->freepix = grid.count[TER_FREE] + grid.count[TER_WATER];
+    dl->otherpix = dl->width * dl->height - dl->freepix;
+    /* Take the colours of the bases from the artwork */
+    dl->base_area = grid.markcount;
+    dl->base = malloc (sizeof (RegenCoord) * (dl->base_area + 1));
+    if (!dl->base) {
+        perror ("decode_level");
+        dl->failed = 1;
+        lcmap_free_grid (&grid);
+        close_level (&dl->file);
+        return;
     }
-    /* Prepare base regeneration array */
-    if(game_settings.base_regen) {
-        basebufsize=512;   /* Some arbitary size */
-        lev_level.base = malloc(sizeof(RegenCoord)*basebufsize);
-    } else {
-        basebufsize=0;
-        lev_level.base = NULL;
+    for (r = 0; r < dl->base_area; r++) {
+        Uint8 red, green, blue;
+        x = grid.marks[r * 2];
+        y = grid.marks[r * 2 + 1];
+        dl->base[r].x = x;
+        dl->base[r].y = y;
+        SDL_GetRGB(getpixel(dl->art,x,y),&dl->format,&red,&green,&blue);
+#if HAVE_LIBSDL_GFX
+        dl->base[r].c = map_rgba(red, green, blue, 0xff);
+#else
+        /* Same as map_rgba, but without reading the screen format */
+        dl->base[r].c = SDL_MapRGB(&dl->format, red, green, blue);
+#endif
+    }
+    lcmap_free_grid (&grid);
+    qsort(dl->base,dl->base_area,sizeof(RegenCoord),sort_regen);
+    close_level (&dl->file);
+}
+
+/* Free a decoded level. If wait is 0, nothing is done if the level */
+/* is being decoded right now. Returns nonzero if the level was freed */
+static int free_decoded_level (DecodedLevel *dl, int wait)
+{
+    if (dl->job) {
+        if (cancel_job (dl->job) == 0) {
+            if (wait == 0 && job_done (dl->job) == 0)
+                return 0;
+            finish_job (dl->job);
+        }
+        dl->job = NULL;
     }
+    if (dl->art)
+        SDL_FreeSurface (dl->art);
+    free (dl->solid);
+    free (dl->base);
+    memset (dl, 0, sizeof (DecodedLevel));
+    return 1;
+}
+
+/* Start decoding a level into a cache slot */
+static void start_decoding (DecodedLevel *dl, struct LevelFile *lev,
+        int speculative)
+{
+    dl->level = lev;
+    dl->file = *lev;
+    dl->file.ldat = NULL;
+    dl->file.settings = NULL;
+    dl->format = *screen->format;
+    dl->format.palette = NULL;
+    dl->speculative = speculative;
+    dl->used = ++lev_cache_clock;
+    dl->job = add_job (decode_level, dl);
+}
+
+/* Find a level from the level cache */
+static DecodedLevel *find_decoded_level (struct LevelFile *lev)
+{
+    int r;
+    for (r = 0; r < LEVEL_CACHE_SIZE; r++)
+        if (lev_cache[r].level == lev)
+            return lev_cache + r;
+    return NULL;
+}
+
+/* Start decoding a level in the background */
+void prefetch_level (struct LevelFile *lev)
+{
+    DecodedLevel *dl = NULL;
+    int r;
+    if (find_decoded_level (lev))
+        return;
+    /* Replace the previous prefetch if it was not played, */
+    /* otherwise the least recently used level */
+    for (r = 0; r < LEVEL_CACHE_SIZE; r++)
+        if (lev_cache[r].speculative && free_decoded_level (lev_cache + r, 0))
+            dl = lev_cache + r;
+    for (r = 0; r < LEVEL_CACHE_SIZE && dl == NULL; r++)
+        if (lev_cache[r].level == NULL)
+            dl = lev_cache + r;
+    if (dl == NULL) {
+        DecodedLevel *oldest = NULL;
+        for (r = 0; r < LEVEL_CACHE_SIZE; r++)
+            if (lev_cache[r].job == NULL &&
+                    (oldest == NULL || lev_cache[r].used < oldest->used))
+                oldest = lev_cache + r;
+        if (oldest == NULL || free_decoded_level (oldest, 0) == 0)
+            return; /* Everything is busy */
+        dl = oldest;
+    }
+    start_decoding (dl, lev, 1);
+}
+
+/* Load level and prepare for new game */
+void load_level (struct LevelFile *lev) {
+    DecodedLevel *dl;
+    int x, y, p, r;
+
+    /* Get the decoded level from the cache or decode it now */
+    dl = find_decoded_level (lev);
+    if (dl == NULL) {
+        dl = lev_cache;
+        for (r = 1; r < LEVEL_CACHE_SIZE; r++)
+            if (lev_cache[r].used < dl->used)
+                dl = lev_cache + r;
+        free_decoded_level (dl, 1);
+        start_decoding (dl, lev, 0);
+    }
+    if (dl->job) {
+        finish_job (dl->job);
+        dl->job = NULL;
+    }
+    dl->speculative = 0;
+    dl->used = ++lev_cache_clock;
+    if (dl->failed) {
+        free_decoded_level (dl, 1);
+        exit (1);
+    }
+
+    /* The game modifies the level, so take copies */
+    lev_level.terrain = SDL_DisplayFormat (dl->art);
+    if (!lev_level.terrain) {
+        fprintf (stderr,"Could not copy level artwork! %s\n",
+                SDL_GetError ());
+        exit (1);
+    }
+    lev_level.width = dl->width;
+    lev_level.height = dl->height;
+    /* Prepare terrain cache tiles */
+    lev_tiles_w = (lev_level.width >> TILE_SHIFT) + 1;
+    lev_tiles_h = (lev_level.height >> TILE_SHIFT) + 1;
+    lev_tilestamp = calloc (lev_tiles_w * lev_tiles_h, sizeof (Uint32));
+    if (!lev_tilestamp) {
+        perror ("load_level");
+        exit (1);
+    }
+    for (p = 0; p < 4; p++)
+        lev_viewcache[p].valid = 0;
+    /* Get palette entries */
+    lev_watercol = map_rgba(dl->water.r, dl->water.g, dl->water.b,0xff);
+    /* Calculate underwater clay colour */
+    col_clay_uw = map_rgba((dl->water.r+255)/2, (dl->water.r+200)/2,
+            (dl->water.r+128)/2, 0xff);
+    if (dl->has_snow)
+        col_snow = map_rgba(dl->snow.r, dl->snow.g, dl->snow.b,0xff);
     /* Load data map */
-    lev_level.base_area = 0;
-    lev_level.regen_area = 0;
     lev_level.solid = malloc (sizeof (char *) * lev_level.width);
-    freepix = 0;
-    otherpix = 0;
     for (x = 0; x < lev_level.width; x++) {
-        bits = ((Uint8 *) collmap->pixels)+x;
         lev_level.solid[x] = malloc (lev_level.height);
-        for (y = 0; y < lev_level.height; y++,bits+=collmap->pitch) {
-            lev_level.solid[x][y] = lev->settings->palette.entries[*bits];
-            if (lev_level.solid[x][y] == TER_FREE
-                || lev_level.solid[x][y] == TER_WATER)
-                freepix++;
-            else {
-                otherpix++;
-                if (lev_level.solid[x][y] == TER_BASE) {
-                    if(lev_level.base) {
-                        Uint8 r,g,b;
-                        lev_level.base[lev_level.base_area].x=x;
-                        lev_level.base[lev_level.base_area].y=y;
-                        SDL_GetRGB(getpixel(lev_level.terrain,x,y),
-                                screen->format,
-                                &r,
-                                &g,
-                                &b);
-                        lev_level.base[lev_level.base_area].c=
-                            map_rgba(r, g, b, 0xff);
-
-                        if(lev_level.base_area==basebufsize-1) {
-                            basebufsize+=512;
-                            lev_level.base=realloc(lev_level.base,
-                                    sizeof(RegenCoord)*basebufsize);
-                        }
-                    }
-                    lev_level.base_area++;
-                }
-            }
-        }
+        memcpy (lev_level.solid[x], dl->solid + x * lev_level.height,
+                lev_level.height);
     }
-    SDL_FreeSurface (collmap);
-    /* Finalize the base regeneration buffer */
-    if(lev_level.base) {
+    /* Critter navigation and walkers follow the collision map */
+    init_nav ();
+    init_footholds ();
+    /* Prepare base regeneration array */
+    lev_level.base_area = 0;
+    lev_level.regen_area = 0;
+    lev_level.base = NULL;
+    if(game_settings.base_regen && dl->base_area > 0) {
+        lev_level.base = malloc(sizeof(RegenCoord)*dl->base_area);
+        if (!lev_level.base) {
+            perror ("load_level");
+            exit (1);
+        }
+        memcpy(lev_level.base,dl->base,sizeof(RegenCoord)*dl->base_area);
+        lev_level.base_area = dl->base_area;
         lev_level.regen_timer = 0;
         lev_level.regen_area = lev_level.base_area;
-        if(lev_level.base_area<basebufsize) {
-            basebufsize=lev_level.base_area;
-            lev_level.base=realloc(lev_level.base,
-                    sizeof(RegenCoord)*basebufsize);
-        }
-        qsort(lev_level.base,lev_level.base_area,sizeof(RegenCoord),sort_regen);
     }
     /* Position players */
     if (game_settings.playmode == OutsideShip
@@ -314,10 +627,10 @@ void load_level (struct LevelFile *lev) {
                              p);
                         fprintf(stderr,
                             "Number of free space (including water) pixels: %d, number of other pixels: %d\n",
-                             freepix, otherpix);
+                             dl->freepix, dl->otherpix);
                         fprintf (stderr,
                                 "%0.3f%% of the surface area is available\n",
-                                ((double) freepix / (double) otherpix) * 100);
+                                ((double) dl->freepix / (double) dl->otherpix) * 100);
                         exit (0);
                     }
                 } while (lev_level.
@@ -335,6 +648,10 @@ void unload_level (void)
     int x;
     struct LevelEffects *next;
     SDL_FreeSurface (lev_level.terrain);
+    free (lev_tilestamp);
+    lev_tilestamp = NULL;
+    free_nav ();
+    free_footholds ();
     for (x = 0; x < lev_level.width; x++)
         free (lev_level.solid[x]);
     free (lev_level.solid);
@@ -443,6 +760,7 @@ void start_burning (int x, int y)
         lev_level.solid[x][y] = TER_GROUND;
     else
         lev_level.solid[x][y] = TER_FREE;
+    solid_changed (x, y, 1, 1);
     newentry->fx = fx;
     if (lev_lastfx == NULL)
         level_effects = newentry;
@@ -472,7 +790,7 @@ void start_melting (int x, int y, unsigned int recurse)
     if(game_settings.base_regen && lev_level.solid[x][y]==TER_BASE)
         lev_level.base_area--;
     lev_level.solid[x][y] = TER_FREE;
-    putpixel (lev_level.terrain, x, y, col_green);
+    put_terrain_pixel (x, y, col_green);
     newentry->fx = fx;
     if (lev_lastfx == NULL)
         level_effects = newentry;
@@ -516,6 +834,7 @@ void alter_level (int x, int y, int recurse, LevelFXType type)
         else if (lev_level.solid[x][y] == TER_WATER)
             lev_level.solid[x][y] = TER_UNDERWATER;
     }
+    solid_changed (x, y, 1, 1);
     newentry->fx = fx;
     if (lev_lastfx == NULL)
         level_effects = newentry;
@@ -524,65 +843,111 @@ void alter_level (int x, int y, int recurse, LevelFXType type)
     lev_lastfx = newentry;
 }
 
-/* Make a bullet hole in the ground */
-void make_hole(int x,int y) {
-    if (lev_level.solid[x][y] != TER_INDESTRUCT
-        && !(level_settings.indstr_base
-             && (lev_level.solid[x][y] == TER_BASE
-                 || lev_level.solid[x][y] == TER_BASEMAT))) {
-        int fx,fy;
-        for (fx = 0; fx < HOLE_W; fx++) {
-            for (fy = 0; fy < HOLE_H; fy++) {
-                int terrain;
-                int rx,ry;
-                if (hole_bm[fx][fy])
-                    continue;
-                rx = fx - HOLE_W/2 + x;
-                ry = fy - HOLE_H/2 + y;
-                if (rx < 0 || ry < 0 || rx >= lev_level.width
-                    || ry >= lev_level.height)
-                    continue;
-                terrain = lev_level.solid[rx][ry];
-                if((ter_semisolid(terrain) || ter_solid(terrain))
-                    && ter_indestructable(terrain)==0)
-                {
-                    if(terrain == TER_BASE)
-                        lev_level.base_area--;
-                    if (terrain == TER_UNDERWATER || terrain == TER_ICE) {
-                        lev_level.solid[rx][ry] = TER_WATER;
-                        putpixel (lev_level.terrain, rx, ry, lev_watercol);
-                    } else {
-                        lev_level.solid[rx][ry] = TER_FREE;
-                        putpixel (lev_level.terrain, rx, ry, col_black);
-                    }
+/* Get the cached mask for a circle of the given radius */
+static const Uint16 *get_brush_mask (int r)
+{
+    Uint16 *mask = brush_masks[r];
+    int dy;
+    if (mask)
+        return mask;
+    mask = malloc (sizeof (Uint16) * (r + 1));
+    if (!mask) {
+        perror ("get_brush_mask");
+        exit (1);
+    }
+    for (dy = 0; dy <= r; dy++)
+        mask[dy] = sqrt (r * r - dy * dy) * 16;
+    brush_masks[r] = mask;
+    return mask;
+}
+
+/* Convert a color from map_rgba() to a pixel of the terrain surface */
+static Uint32 terrain_color (Uint32 color)
+{
+#if HAVE_LIBSDL_GFX
+    return SDL_MapRGB (lev_level.terrain->format, color >> 24, color >> 16,
+                       color >> 8);
+#else
+    return color;
+#endif
+}
+
+/* Stamp an elliptical brush into the terrain. Each row is one span of */
+/* the terrain surface, and the whole stamp is marked dirty at once */
+void stamp_terrain (int x, int y, int rx, int ry, TerrainBrush brush)
+{
+    const Uint16 *mask;
+    Uint32 burncol, watercol, freecol;
+    int changed = 0;
+    int py, py1, py2;
+    if (rx < 0 || ry < 0)
+        return;
+    /* The pixels are written directly, so convert the colors first */
+    burncol = terrain_color (col_gray);
+    watercol = terrain_color (lev_watercol);
+    freecol = terrain_color (col_black);
+    if (rx > BRUSH_MAX_RADIUS)
+        rx = BRUSH_MAX_RADIUS;
+    if (ry > BRUSH_MAX_RADIUS)
+        ry = BRUSH_MAX_RADIUS;
+    mask = get_brush_mask (ry);
+    py1 = y - ry < 0 ? 0 : y - ry;
+    py2 = y + ry >= lev_level.height ? lev_level.height - 1 : y + ry;
+    for (py = py1; py <= py2; py++) {
+        Uint32 *row;
+        int hw, px, px1, px2;
+        if (ry > 0)
+            hw = mask[abs (py - y)] * rx / (16 * ry);
+        else
+            hw = rx;
+        px1 = x - hw < 0 ? 0 : x - hw;
+        px2 = x + hw >= lev_level.width ? lev_level.width - 1 : x + hw;
+        row = (Uint32 *) ((Uint8 *) lev_level.terrain->pixels +
+                          py * lev_level.terrain->pitch);
+        for (px = px1; px <= px2; px++) {
+            Uint8 *ter = &lev_level.solid[px][py];
+            if ((ter_semisolid (*ter) || ter_solid (*ter)) == 0
+                || ter_indestructable (*ter))
+                continue;
+            if (brush == BrushBurn) {
+                row[px] = burncol;
+            } else {
+                if (*ter == TER_BASE)
+                    lev_level.base_area--;
+                if (*ter == TER_UNDERWATER || *ter == TER_ICE) {
+                    *ter = TER_WATER;
+                    row[px] = watercol;
+                } else {
+                    *ter = TER_FREE;
+                    row[px] = freecol;
                 }
             }
+            changed = 1;
         }
     }
+    if (changed)
+        mark_terrain_dirty (x - rx, y - ry, rx * 2 + 1, ry * 2 + 1);
+}
+
+/* Blast a round crater into the ground */
+void make_crater (int x, int y, int radius)
+{
+    if (x < 0 || y < 0 || x >= lev_level.width || y >= lev_level.height)
+        return;
+    if (ter_indestructable (lev_level.solid[x][y]) == 0)
+        stamp_terrain (x, y, radius, radius, BrushDig);
+}
+
+/* Make a bullet hole in the ground */
+void make_hole(int x,int y) {
+    make_crater (x, y, HOLE_RADIUS);
 }
 
 /* Burn a patch of ground */
 void burn_hole(int x,int y) {
-    int fx,fy;
     if(is_burnable(x,y))
         start_burning(x,y);
-    for (fx = 0; fx < HOLE_W; fx++)
-        for (fy = 0; fy < HOLE_H; fy++) {
-            int rx,ry,terrain;
-            if (hole_bm[fx][fy])
-                continue;
-            rx = fx - HOLE_W/2 + x;
-            ry = fy - HOLE_H/2 + y;
-            if (rx < 0 || ry < 0 || rx >= lev_level.width
-                || ry >= lev_level.height)
-                continue;
-            terrain = lev_level.solid[rx][ry];
-            if((ter_semisolid(terrain) || ter_solid(terrain))
-                && ter_indestructable(terrain)==0)
-            {
-                putpixel (lev_level.terrain, rx, ry, col_gray);
-            }
-        }
+    stamp_terrain (x, y, HOLE_RADIUS, HOLE_RADIUS, BrushBurn);
 }
 
 void animate_level (void)
@@ -604,8 +969,8 @@ void animate_level (void)
                 if(lev_level.solid[x][y]==TER_FREE) {
                     bump_ship(x,y);
                     lev_level.solid[x][y]=TER_BASE;
-                    putpixel (lev_level.terrain, x, y, lev_level.base[r].c);
-                    putpixel (lev_level.terrain, x, y, lev_level.base[r].c);
+                    put_terrain_pixel (x, y, lev_level.base[r].c);
+                    put_terrain_pixel (x, y, lev_level.base[r].c);
                     lev_level.base_area++;
                     break;
                 }
@@ -638,10 +1003,10 @@ void animate_level (void)
                     && lev_level.solid[list->fx->x][list->fx->y + 1] ==
                     TER_FREE && list->fx->value < FIRE_SPREAD) {
                     if (lev_level.solid[list->fx->x][list->fx->y] == TER_GROUND)        /* Combustable2 turns into ground, remember ? */
-                        putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                        put_terrain_pixel (list->fx->x, list->fx->y,
                                   col_gray);
                     else
-                        putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                        put_terrain_pixel (list->fx->x, list->fx->y,
                                   burncolor[0]);
                     list->fx->y -= rand () % 3;
                 }
@@ -651,10 +1016,10 @@ void animate_level (void)
                     if (v == 0
                         && lev_level.solid[list->fx->x][list->fx->y] ==
                         TER_GROUND)
-                        putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                        put_terrain_pixel (list->fx->x, list->fx->y,
                                   col_gray);
                     else
-                        putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                        put_terrain_pixel (list->fx->x, list->fx->y,
                                   burncolor[v]);
                 }
                 if (list->fx->value == FIRE_SPREAD) {
@@ -693,14 +1058,14 @@ void animate_level (void)
 #endif
                         } else if (solid == TER_ICE) {
                             lev_level.solid[nx][ny] = TER_WATER;
-                            putpixel (lev_level.terrain, nx, ny,
+                            put_terrain_pixel (nx, ny,
                                       lev_watercol);
                         } else if (solid == TER_SNOW) {
                             lev_level.solid[nx][ny] = TER_FREE;
-                            putpixel (lev_level.terrain, nx, ny,
+                            put_terrain_pixel (nx, ny,
                                       burncolor[0]);
                         } else if (solid == TER_WALKWAY)
-                            putpixel (lev_level.terrain, nx, ny, col_gray);
+                            put_terrain_pixel (nx, ny, col_gray);
                     }
                 }
             }
@@ -709,7 +1074,7 @@ void animate_level (void)
             if (list->fx->value == 1) {
                 if (list->fx->brake)
                     list->fx->brake--;
-                putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                put_terrain_pixel (list->fx->x, list->fx->y,
                           col_black);
                 for (f = -M_PI; f < M_PI; f += M_PI / 4.0) {
                     nx = list->fx->x + Round(sin (f) * 3.0);
@@ -747,22 +1112,22 @@ void animate_level (void)
                 && lev_level.solid[list->fx->x][list->fx->y + 1] ==
                 TER_FREE) {
                 list->fx->y++;
-                putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                put_terrain_pixel (list->fx->x, list->fx->y,
                           col_snow);
             }
             if (list->fx->value == 1) {
                 if (list->fx->type == Earth) {
                     if (solid == TER_UNDERWATER)
-                        putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                        put_terrain_pixel (list->fx->x, list->fx->y,
                                   col_clay_uw);
                     else
-                        putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                        put_terrain_pixel (list->fx->x, list->fx->y,
                                   col_clay);
                 } else if (list->fx->type == Ice)
-                    putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                    put_terrain_pixel (list->fx->x, list->fx->y,
                               col_snow);
                 else
-                    putpixel (lev_level.terrain, list->fx->x, list->fx->y,
+                    put_terrain_pixel (list->fx->x, list->fx->y,
                               col_gray);
                 if (list->fx->brake > 0)
                     list->fx->brake--;
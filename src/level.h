@@ -66,6 +66,11 @@
 
 typedef enum { Fire, Ice, Earth, Explosive, Melt } LevelFXType;
 
+/* Terrain brush types */
+typedef enum { BrushDig, BrushBurn } TerrainBrush;
+#define BRUSH_MAX_RADIUS 64
+#define HOLE_RADIUS     4   /* Radius of a bullet hole */
+
 struct LevelFile;
 
 typedef struct {
@@ -100,10 +105,17 @@ extern Level lev_level;
 extern void init_level (void);
 extern void reinit_stars (void);
 extern void load_level (struct LevelFile *lev);
+/* Start decoding a level in the background so load_level is fast */
+extern void prefetch_level (struct LevelFile *lev);
 extern void unload_level (void);
 
 extern int find_rainy (int x);
 
+/* Terrain graphics modification. Changed areas are redrawn from */
+/* the level to the cached player viewports */
+extern void put_terrain_pixel (int x, int y, Uint32 color);
+extern void mark_terrain_dirty (int x, int y, int w, int h);
+
 /* Pixel perfect collision detection */
 extern int hit_solid_line (int startx, int starty, int endx, int endy,
                             int *newx, int *newy);
@@ -184,6 +196,11 @@ extern void start_melting (int x, int y, unsigned int recurse);
 extern void alter_level (int x, int y, int recurse, LevelFXType type);
 extern void make_hole(int x,int y);
 extern void burn_hole(int x,int y);
+
+/* Terrain brushes. Stamp an elliptical patch of any size into the level */
+extern void stamp_terrain (int x, int y, int rx, int ry, TerrainBrush brush);
+/* Blast a round crater. Nothing happens if the centre is indestructible */
+extern void make_crater (int x, int y, int radius);
 extern void animate_level (void);
 
 #endif
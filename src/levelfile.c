@@ -24,6 +24,9 @@
 #include <dirent.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "SDL.h"
 
@@ -34,6 +37,49 @@
 #include "game.h"
 #include "font.h"
 
+/* The level index remembers the names and thumbnails of the levels, */
+/* so unchanged level files don't have to be opened at startup */
+#define LEVEL_INDEX_FILE "levelindex"
+#define LEVEL_INDEX_VERSION "LUOLA LEVEL INDEX 1"
+#define LEVEL_INDEX_FIELDS 8
+
+static struct dllist *lf_index; /* Indexed levels not yet found */
+static int lf_index_loaded, lf_index_dirty;
+
+/* Load level settings */
+static int level_load_settings (struct LevelFile *level) {
+    if (level->ldat) {
+        const char *config;
+        /* TODO: Use only CONFIG in the next stable release */
+        if(ldat_find_item(level->ldat,"CONFIG",level->index))
+            config = "CONFIG";
+        else
+            config = "SOURCE";
+        level->settings =
+        load_level_config_rw (ldat_get_item
+                             (level->ldat, config, level->index),
+                              ldat_get_item_length (level->ldat,
+                              config, level->index),
+                              level->filename);
+    } else {
+        level->settings =
+            load_level_config (level->filename);
+    }
+    if(level->settings==NULL)
+        return 1;
+
+    if (level->settings->mainblock.name==NULL) {
+        level->settings->mainblock.name = strdup(level->filename);
+        fprintf(stderr,"Warning! Level configuration file \"%s\" has no level name!\n",level->filename);
+    }
+    if(level->type==LEV_NORMAL
+        && level->settings->mainblock.collmap==NULL) {
+        fprintf(stderr,"Warning! Level configuration file \"%s\" has no collisionmap filename!\n",level->filename);
+        return 1;
+    }
+    return 0;
+}
+
 /* Open level for reading */
 int open_level(struct LevelFile *level) {
     if(level->ldat) {
@@ -43,10 +89,14 @@ int open_level(struct LevelFile *level) {
     }
 
     if(level->type == LEV_COMPACT) {
-        level->ldat = ldat_open_file (level->filename);
+        level->ldat = ldat_map_file (level->filename);
         if(level->ldat==NULL)
             return 1;
     }
+    if(level->settings==NULL && level_load_settings(level)) {
+        close_level(level);
+        return 1;
+    }
     return 0;
 }
 
@@ -61,46 +111,87 @@ void close_level(struct LevelFile *level) {
             level->ldat = NULL;
         }
     }
+    if(level->settings) {
+        free_level_config(level->settings);
+        level->settings = NULL;
+    }
 }
 
-/* Load level settings and thumbnail */
-static int level_load_settings (struct LevelFile *level) {
-    if (level->ldat) {
-        const char *config;
-        /* TODO: Use only CONFIG in the next stable release */
-        if(ldat_find_item(level->ldat,"CONFIG",level->index))
-            config = "CONFIG";
-        else
-            config = "SOURCE";
-        level->settings =
-        load_level_config_rw (ldat_get_item
-                             (level->ldat, config, level->index),
-                              ldat_get_item_length (level->ldat,
-                              config, level->index),
-                              level->filename);
-        if(level->settings)
-            level->settings->thumbnail =
-                load_image_ldat(level->ldat,1,T_OPAQUE,"THUMBNAIL",level->index);
-    } else {
-        level->settings =
-            load_level_config (level->filename);
-        if(level->settings && level->settings->mainblock.thumbnail) {
-            level->settings->thumbnail = load_image(samepath(level->filename,
-                        level->settings->mainblock.thumbnail),1,T_OPAQUE);
+/* Load the level thumbnail */
+SDL_Surface *load_level_thumbnail(struct LevelFile *level) {
+    SDL_Surface *thumbnail = NULL;
+    if(level->type == LEV_COMPACT) {
+        if(level->thumbpos > 0) {
+            /* Thumbnail is stored uncompressed, read it directly */
+            SDL_RWops *rw = SDL_RWFromFile(level->filename,"rb");
+            if(rw) {
+                SDL_RWseek(rw,level->thumbpos,SEEK_SET);
+                thumbnail = load_image_rw(rw,1,T_OPAQUE);
+                SDL_RWclose(rw);
+            }
+        } else if(level->thumbpos == 0) {
+            LDAT *ldat = ldat_map_file(level->filename);
+            if(ldat) {
+                thumbnail = load_image_ldat(ldat,1,T_OPAQUE,"THUMBNAIL",
+                        level->index);
+                ldat_free(ldat);
+            }
         }
+    } else if(level->thumbnail) {
+        thumbnail = load_image(samepath(level->filename,level->thumbnail),
+                1,T_OPAQUE);
     }
-    if(level->settings==NULL)
-        return 1;
+    return thumbnail;
+}
 
-    if (level->settings->mainblock.name==NULL) {
-        level->settings->mainblock.name = strdup(level->filename);
-        fprintf(stderr,"Warning! Level configuration file \"%s\" has no level name!\n",level->filename);
+/* Free a level entry */
+static void free_level_file(void *data) {
+    struct LevelFile *level = data;
+    if(level->settings)
+        free_level_config(level->settings);
+    free(level->filename);
+    free(level->name);
+    free(level->thumbnail);
+    free(level);
+}
+
+/* Make a new level entry */
+static struct LevelFile *new_level_file(const char *filename,
+        LevelFormat type, int index, const struct stat *st) {
+    struct LevelFile *newentry = malloc(sizeof(struct LevelFile));
+    if(!newentry) {
+        perror(__func__);
+        exit(1);
     }
-    if(level->type==LEV_NORMAL
-        && level->settings->mainblock.collmap==NULL) {
-        fprintf(stderr,"Warning! Level configuration file \"%s\" has no collisionmap filename!\n",level->filename);
+    memset(newentry,0,sizeof(struct LevelFile));
+    newentry->filename = strdup(filename);
+    newentry->type = type;
+    newentry->index = index;
+    newentry->mtime = st->st_mtime;
+    newentry->size = st->st_size;
+    return newentry;
+}
+
+/* Read the name and thumbnail location of a level. */
+/* The settings are freed, they are loaded again when the level is opened */
+static int level_scan_info(struct LevelFile *level) {
+    if(level_load_settings(level))
         return 1;
+    level->name = strdup(level->settings->mainblock.name);
+    if(level->type == LEV_COMPACT) {
+        LDAT_Block *block = ldat_find_item(level->ldat,"THUMBNAIL",
+                level->index);
+        if(block==NULL)
+            level->thumbpos = -1;
+        else if(block->codec == LDAT_CODEC_NONE)
+            level->thumbpos = block->pos;
+        else
+            level->thumbpos = 0;
+    } else if(level->settings->mainblock.thumbnail) {
+        level->thumbnail = strdup(level->settings->mainblock.thumbnail);
     }
+    free_level_config(level->settings);
+    level->settings = NULL;
     return 0;
 }
 
@@ -117,24 +208,20 @@ static LevelFormat get_level_format (const char *filename) {
 }
 
 /* Add a normal level */
-static void add_level(const char *filename) {
-    struct LevelFile *newentry = malloc(sizeof(struct LevelFile));
-    newentry->filename = strdup(filename);
-    newentry->ldat = NULL;
-    newentry->type = LEV_NORMAL;
-    if(level_load_settings(newentry)==0) {
+static void add_level(const char *filename, const struct stat *st) {
+    struct LevelFile *newentry = new_level_file(filename,LEV_NORMAL,0,st);
+    if(level_scan_info(newentry)==0) {
         game_settings.levels = dllist_append(game_settings.levels,newentry);
     } else {
-        free(newentry->filename);
-        free(newentry);
+        free_level_file(newentry);
     }
 }
 
 /* Add a compact level file. Might contain multiple levels */
-static void add_compact_level(const char *filename) {
+static void add_compact_level(const char *filename, const struct stat *st) {
     LDAT *ldat;
     int count,r;
-    ldat = ldat_open_file(filename);
+    ldat = ldat_map_file(filename);
     if(!ldat) return;
     count = ldat_get_item_count(ldat,"CONFIG");
     /* TODO: Use only CONFIG in the next stable release */
@@ -142,31 +229,165 @@ static void add_compact_level(const char *filename) {
         count = ldat_get_item_count(ldat,"SOURCE");
 
     for(r=0;r<count;r++) {
-        struct LevelFile *newentry = malloc(sizeof(struct LevelFile));
-        newentry->filename = strdup(filename);
+        struct LevelFile *newentry = new_level_file(filename,LEV_COMPACT,
+                r,st);
         newentry->ldat = ldat;
-        newentry->index= r;
-        newentry->type = LEV_COMPACT;
-        if(level_load_settings(newentry)==0) {
+        if(level_scan_info(newentry)==0) {
             game_settings.levels = dllist_append(game_settings.levels,newentry);
             newentry->ldat = NULL;
         } else {
-            free(newentry->filename);
-            free(newentry);
+            newentry->ldat = NULL;
+            free_level_file(newentry);
         }
     }
 
     ldat_free(ldat);
 }
 
+/* Load the level index */
+static void load_level_index(void) {
+    char line[PATH_MAX * 2 + 256];
+    FILE *fp;
+    lf_index_loaded = 1;
+    fp = fopen(getfullpath(HOME_DIRECTORY,LEVEL_INDEX_FILE),"r");
+    if(!fp)
+        return;
+    if(fgets(line,sizeof(line),fp)==NULL ||
+            strncmp(line,LEVEL_INDEX_VERSION,strlen(LEVEL_INDEX_VERSION))) {
+        fclose(fp);
+        return;
+    }
+    /* Each line is mtime, size, type, index, thumbnail position, */
+    /* filename, thumbnail filename and level name separated by tabs */
+    while(fgets(line,sizeof(line),fp)) {
+        char *field[LEVEL_INDEX_FIELDS], *ptr = line;
+        struct LevelFile *level;
+        int n;
+        line[strcspn(line,"\n")] = '\0';
+        for(n=0;n<LEVEL_INDEX_FIELDS && ptr;n++) {
+            field[n] = ptr;
+            ptr = strchr(ptr,'\t');
+            if(ptr) *ptr++ = '\0';
+        }
+        if(n<LEVEL_INDEX_FIELDS || field[5][0]=='\0') {
+            lf_index_dirty = 1;
+            continue;
+        }
+        level = malloc(sizeof(struct LevelFile));
+        if(!level) {
+            perror(__func__);
+            break;
+        }
+        memset(level,0,sizeof(struct LevelFile));
+        level->mtime = strtol(field[0],NULL,10);
+        level->size = strtol(field[1],NULL,10);
+        level->type = field[2][0]=='C' ? LEV_COMPACT : LEV_NORMAL;
+        level->index = atoi(field[3]);
+        level->thumbpos = strtol(field[4],NULL,10);
+        level->filename = strdup(field[5]);
+        level->thumbnail = field[6][0] ? strdup(field[6]) : NULL;
+        level->name = strdup(field[7]);
+        lf_index = dllist_append(lf_index,level);
+    }
+    fclose(fp);
+    if(lf_index)
+        while(lf_index->prev) lf_index = lf_index->prev;
+}
+
+/* Add the indexed levels of a file if the file hasn't changed. */
+/* Returns the number of levels added */
+static int take_indexed_levels(const char *filename, const struct stat *st) {
+    struct dllist *ptr = lf_index, *next;
+    int found = 0;
+    while(ptr) {
+        struct LevelFile *level = ptr->data;
+        next = ptr->next;
+        if(strcmp(level->filename,filename)==0) {
+            if(level->mtime == st->st_mtime && level->size == st->st_size) {
+                game_settings.levels = dllist_append(game_settings.levels,
+                        level);
+                found++;
+            } else {
+                free_level_file(level);
+                lf_index_dirty = 1;
+            }
+            if(ptr==lf_index)
+                lf_index = next;
+            dllist_remove(ptr);
+        }
+        ptr = next;
+    }
+    return found;
+}
+
+/* Write a string to the level index without field or line separators */
+static void write_index_string(FILE *fp, const char *str) {
+    for(;*str;str++)
+        fputc(*str=='\t' || *str=='\n' ? ' ' : *str, fp);
+}
+
+/* Write the level index if levels were added, changed or removed */
+void save_level_index(void) {
+    char path[PATH_MAX], tmppath[PATH_MAX + 4];
+    struct dllist *ptr;
+    FILE *fp;
+    if(lf_index) {
+        /* These level files were not found anymore */
+        dllist_free(lf_index,free_level_file);
+        lf_index = NULL;
+        lf_index_dirty = 1;
+    }
+    if(lf_index_dirty==0)
+        return;
+    lf_index_dirty = 0;
+    strncpy(path,getfullpath(HOME_DIRECTORY,LEVEL_INDEX_FILE),PATH_MAX-1);
+    path[PATH_MAX-1] = '\0';
+    sprintf(tmppath,"%s.tmp",path);
+    fp = fopen(tmppath,"w");
+    if(!fp) {
+        perror(tmppath);
+        return;
+    }
+    fprintf(fp,"%s\n",LEVEL_INDEX_VERSION);
+    ptr = game_settings.levels;
+    if(ptr)
+        while(ptr->prev) ptr = ptr->prev;
+    for(;ptr;ptr=ptr->next) {
+        struct LevelFile *level = ptr->data;
+        fprintf(fp,"%ld\t%ld\t%c\t%d\t%ld\t",level->mtime,level->size,
+                level->type==LEV_COMPACT?'C':'N',level->index,
+                level->thumbpos);
+        write_index_string(fp,level->filename);
+        fputc('\t',fp);
+        if(level->thumbnail)
+            write_index_string(fp,level->thumbnail);
+        fputc('\t',fp);
+        write_index_string(fp,level->name);
+        fputc('\n',fp);
+    }
+    if(fclose(fp)) {
+        perror(tmppath);
+        remove(tmppath);
+        return;
+    }
+#ifdef WIN32
+    remove(path);
+#endif
+    if(rename(tmppath,path))
+        perror(path);
+}
+
 /* Scan the level directory and make a list of levels */
 int scan_levels (int user) {
     struct dirent *next;
     char fullpath[PATH_MAX];
+    struct stat st;
     int pathlen;
-    LevelFormat format;
     DIR *reading;
 
+    if(lf_index_loaded==0)
+        load_level_index();
+
     /* Which directory to read */
     if (user)
         strcpy(fullpath, getfullpath (USERLEVEL_DIRECTORY, ""));
@@ -181,56 +402,98 @@ int scan_levels (int user) {
     pathlen = strlen(fullpath);
     /* Loop thru the directory */
     while ((next = readdir (reading)) != NULL) {
-        /* Check level type and add it */
+        const char *ext = strrchr(next->d_name,'.');
+        if(ext==NULL || strcasecmp(ext,".lev"))
+            continue;
         strcpy(fullpath+pathlen,next->d_name);
-        format = get_level_format (fullpath);
-        switch(format) {
+        if(stat(fullpath,&st))
+            continue;
+        /* Use the level index if the file is unchanged */
+        if(take_indexed_levels(fullpath,&st))
+            continue;
+        lf_index_dirty = 1;
+        /* Check level type and add it */
+        switch(get_level_format (fullpath)) {
             case LEV_UNKNOWN: continue;
-            case LEV_NORMAL: add_level(fullpath); break;
-            case LEV_COMPACT: add_compact_level(fullpath); break;
+            case LEV_NORMAL: add_level(fullpath,&st); break;
+            case LEV_COMPACT: add_compact_level(fullpath,&st); break;
         }
     }
     closedir(reading);
     return 0;
 }
 
+/* Get the full name of a file in the same directory as the level. */
+/* Unlike samepath, this can be used from worker threads */
+/* Returns NULL if the name does not fit in PATH_MAX */
+static const char *level_path(const struct LevelFile *level,
+        const char *filename, char *path) {
+    const char *ptr = strrchr(level->filename,'/');
+    int len = ptr ? ptr - level->filename + 1 : 0;
+    if(len + strlen(filename) >= PATH_MAX) {
+        fprintf(stderr,"%s: path too long\n",filename);
+        return NULL;
+    }
+    memcpy(path,level->filename,len);
+    strcpy(path+len,filename);
+    return path;
+}
+
 /* Loads the level artwork file from a file */
-/* The surface returned is in the same format as the screen */
-SDL_Surface *load_level_art (struct LevelFile *level) {
-    SDL_Surface *art, *tmpart;
+/* The surface returned is in the given pixel format */
+/* Returns NULL on error. This can be used from worker threads */
+SDL_Surface *load_level_art (struct LevelFile *level,
+        SDL_PixelFormat *format) {
+    SDL_Surface *art, *tmpart = NULL;
     if (level->ldat==NULL) {  /* Level files are seperate */
+        char path[PATH_MAX];
         const char *filename;
         if (level->settings->mainblock.artwork)
             filename = level->settings->mainblock.artwork;
         else /* Use collisionmap if artwork is not available */
             filename = level->settings->mainblock.collmap;
 
-        tmpart = load_image (samepath(level->filename,filename), 0, T_OPAQUE);
+        if (filename && level_path(level,filename,path))
+            tmpart = load_image (path, 1, T_NONE);
     } else { /* Level files are stored in an LDAT file */
         SDL_RWops *rw;
         if (ldat_find_item (level->ldat, "ARTWORK", level->index))
             rw = ldat_get_item (level->ldat, "ARTWORK", level->index);
         else /* If the artwork is not present, get the collisionmap */
             rw = ldat_get_item (level->ldat, "COLLISION", level->index);
-        tmpart = load_image_rw (rw, 0, T_OPAQUE);
+        if (rw)
+            tmpart = load_image_rw (rw, 1, T_NONE);
+    }
+    if (tmpart == NULL) {
+        fprintf (stderr,"%s: could not load level artwork! %s\n",
+                level->filename, SDL_GetError ());
+        return NULL;
+    }
+    /* Convert before zooming, zoom_surface doesn't support all depths */
+    art = SDL_ConvertSurface (tmpart, format, SDL_SWSURFACE);
+    SDL_FreeSurface (tmpart);
+    if (art == NULL) {
+        fprintf (stderr,"Could not convert level artwork! %s\n",
+                SDL_GetError ());
+        return NULL;
     }
     if (level->settings->mainblock.aspect != 1.0 ||
             level->settings->mainblock.zoom != 1.0) {
+        tmpart = art;
         art = zoom_surface(tmpart, level->settings->mainblock.aspect,
                     level->settings->mainblock.zoom);
         SDL_FreeSurface (tmpart);
-    } else {
-        art = tmpart;
     }
     return art;
 }
 
 /* Loads the level collisionmap from a file */
 /* The surface is returned as it is, that is 8bit */
-/* If the image is not 8 bit, NULL is returned */
+/* If the image is not 8 bit or cannot be loaded, NULL is returned */
 SDL_Surface *load_level_coll (struct LevelFile * level) {
-    SDL_Surface *coll, *tmpcoll;
+    SDL_Surface *coll, *tmpcoll = NULL;
     if (level->ldat==NULL) {  /* Level files are seperate */
+        char path[PATH_MAX];
         const char *filename;
         if (level->settings->mainblock.collmap) {
             filename = level->settings->mainblock.collmap;
@@ -238,7 +501,8 @@ SDL_Surface *load_level_coll (struct LevelFile * level) {
             fprintf(stderr,"%s: no collisionmap present\n",level->filename);
             return NULL;
         }
-        tmpcoll = load_image (samepath(level->filename,filename), 0, T_NONE);
+        if (level_path(level,filename,path))
+            tmpcoll = load_image (path, 1, T_NONE);
     } else {                    /* Level files are stored in an LDAT file */
         SDL_RWops *rw;
         rw = ldat_get_item (level->ldat, "COLLISION", level->index);
@@ -246,7 +510,12 @@ SDL_Surface *load_level_coll (struct LevelFile * level) {
             fprintf(stderr,"%s: no collisionmap present\n",level->filename);
             return NULL;
         }
-        tmpcoll = load_image_rw (rw, 0, T_NONE);
+        tmpcoll = load_image_rw (rw, 1, T_NONE);
+    }
+    if(tmpcoll==NULL) {
+        fprintf(stderr,"%s: could not load collisionmap! %s\n",
+                level->filename, SDL_GetError());
+        return NULL;
     }
     if(tmpcoll->format->palette==NULL) {
         fprintf(stderr, "%s: collisionmap doesn't have a palette\n",level->filename);
@@ -263,6 +532,51 @@ SDL_Surface *load_level_coll (struct LevelFile * level) {
     return coll;
 }
 
+/* Loads the collisionmap as a grid of terrain types */
+int load_level_grid (struct LevelFile *level, int mark, LCMAP_Grid *grid) {
+    const Uint8 *map = level->settings->palette.entries;
+    SDL_Surface *coll;
+    int r;
+    if (level->settings->mainblock.aspect == 1.0 &&
+            level->settings->mainblock.zoom == 1.0) {
+        SDL_RWops *rw;
+        char magic[5];
+        if (level->ldat==NULL) {  /* Level files are seperate */
+            char path[PATH_MAX];
+            if (level->settings->mainblock.collmap==NULL) {
+                fprintf(stderr,"%s: no collisionmap present\n",
+                        level->filename);
+                return 1;
+            }
+            if (level_path(level,level->settings->mainblock.collmap,path))
+                rw = SDL_RWFromFile (path, "rb");
+            else
+                rw = NULL;
+        } else {
+            rw = ldat_get_item (level->ldat, "COLLISION", level->index);
+        }
+        if (rw) {
+            int start = SDL_RWtell (rw);
+            if (SDL_RWread (rw, magic, 1, 5) == 5 &&
+                    strncmp (magic, "LCMAP", 5) == 0) {
+                SDL_RWseek (rw, start, SEEK_SET);
+                r = lcmap_to_grid_rw (rw, map, mark, grid);
+                if (level->ldat==NULL)
+                    SDL_FreeRW (rw);
+                return r;
+            }
+            if (level->ldat==NULL)
+                SDL_FreeRW (rw);
+        }
+    }
+    /* Other image formats go through a surface */
+    coll = load_level_coll (level);
+    if (coll==NULL)
+        return 1;
+    r = surface_to_grid (coll, map, mark, grid);
+    SDL_FreeSurface (coll);
+    return r;
+}
 
 #ifdef WIN32
 #undef PACKAGE_DATA_DIR
@@ -26,6 +26,7 @@
 
 #include "lconf.h"
 #include "ldat.h"
+#include "lcmap.h"
 
 typedef enum { LEV_UNKNOWN, LEV_NORMAL, LEV_COMPACT} LevelFormat;
 
@@ -36,33 +37,57 @@ struct LevelFile {
 
     LevelFormat type;           /* Level type (normal or compact) */
 
-    struct LevelSettings *settings;    /* Level settings */
+    char *name;                 /* Level name */
+    char *thumbnail;            /* Thumbnail filename (normal levels) */
+    long thumbpos;              /* Position of an uncompressed thumbnail */
+                                /* in a compact level file. 0 if it must */
+                                /* be read from the LDAT, -1 if none */
+    long mtime, size;           /* Level file modification time and size */
+
+    struct LevelSettings *settings;    /* Level settings (while open) */
 };
 
-/* Scan the directory pointed by 'dirname' for levels */
+/* Scan the directory pointed by 'dirname' for levels. */
+/* Unchanged level files are not opened if they are in the level index */
 extern int scan_levels (int user);
 
+/* Write the level index if it changed. Call after scanning */
+extern void save_level_index (void);
+
 /* Show the "No levels found" error screen and exit */
 extern void no_levels_found (void);
 
-/* Prepare a level for reading (only affects compact levels) */
+/* Prepare a level for reading and load its settings */
 extern int open_level(struct LevelFile *level);
 
-/* Close a level opened with open_level */
+/* Close a level opened with open_level and free its settings */
 extern void close_level(struct LevelFile *level);
 
+/* Load the level thumbnail. Returns NULL if the level has none */
+extern SDL_Surface *load_level_thumbnail(struct LevelFile *level);
+
 /* Load the artwork and collisionmap */
 /* They are automatically scaled according to */
-/* their zoom and aspect values */
+/* their zoom and aspect values. The level must be open. */
+/* These may be called from a worker thread, with a private LevelFile */
 
 /* Loads the level artwork file from a file */
-/* The surface returned is in the same format as the screen */
-extern SDL_Surface *load_level_art (struct LevelFile *level);
+/* The surface returned is in the given pixel format */
+/* Returns NULL on error. This can be used from worker threads */
+extern SDL_Surface *load_level_art (struct LevelFile *level,
+                                    SDL_PixelFormat *format);
 
 /* Loads the level collisionmap from a file */
 /* The surface is returned as it is, that is 8bit */
-/* If the image is not 8 bit, NULL is returned */
+/* If the image is not 8 bit or cannot be loaded, NULL is returned */
 extern SDL_Surface *load_level_coll (struct LevelFile *level);
 
+/* Loads the collisionmap as a grid of terrain types, counting the */
+/* terrain types and listing the pixels of type mark on the way. */
+/* Unscaled LCMAPs are decoded without making a surface first. */
+/* Returns nonzero on error */
+extern int load_level_grid (struct LevelFile *level, int mark,
+                            LCMAP_Grid *grid);
+
 #endif
 
@@ -26,7 +26,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "SDL_image.h"
+
 #include "fs.h"
+#include "jobs.h"
 #include "console.h"
 #include "intro.h"
 #include "game.h"
@@ -35,6 +38,8 @@
 #include "level.h"
 #include "player.h"
 #include "projectile.h"
+#include "bullet.h"
+#include "atlas.h"
 #include "animation.h"
 #include "special.h"
 #include "critter.h"
@@ -79,10 +84,15 @@ static void show_version (void) {
 /* Do initializations that require datafiles */
 static int load_data(void) {
     LDAT *graphics;
-    graphics = ldat_open_file(getfullpath(DATA_DIRECTORY,"gfx.ldat"));
+    graphics = ldat_map_file(getfullpath(DATA_DIRECTORY,"gfx.ldat"));
     if(graphics==NULL)
         return 1;
 
+    /* If there is no image cache, decode the images in the background */
+    /* while the modules are loaded */
+    if(open_image_cache(graphics,getfullpath(DATA_DIRECTORY,"gfx.ldat"))==0)
+        preload_images(graphics);
+
     init_critters(graphics);
     init_intro(graphics);
     init_game(graphics);
@@ -92,7 +102,12 @@ static int load_data(void) {
     init_ships(graphics);
     init_specials(graphics);
     init_projectiles(graphics);
+    init_bullets();
+    if(luola_options.stats)
+        atlas_stats();
 
+    end_preload();
+    close_image_cache();
     ldat_free(graphics);
 
     return 0;
@@ -122,6 +137,11 @@ int main (int argc, char *argv[]) {
     /* Initialize */
     init_sdl ();
     init_video ();
+    init_jobs ();
+#ifdef IMG_INIT_PNG
+    /* SDL_image loads its libraries on first use, which is not thread safe */
+    IMG_Init (IMG_INIT_PNG | IMG_INIT_JPG);
+#endif
 
     if (luola_options.sounds)
         init_audio ();
@@ -131,6 +151,7 @@ int main (int argc, char *argv[]) {
 
     scan_levels(0);
     scan_levels(1);
+    save_level_index();
     if (game_settings.levels == NULL)
         no_levels_found ();
 
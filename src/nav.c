@@ -0,0 +1,337 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : nav.c
+ * Description : Navigation grid and flow fields for critters
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "level.h"
+#include "player.h"
+#include "ship.h"
+#include "nav.h"
+
+#define NAV_UNREACHED       0xffff
+#define NAV_FLOW_RANGE      128 /* How far flow fields reach, in cells */
+#define NAV_FLOW_INTERVAL   4   /* Frames between flow field rebuilds */
+
+/* Distances to a player from every cell within range */
+struct FlowField {
+    Uint16 *dist;
+    int tx, ty;             /* Cell the field leads to */
+    unsigned int version;   /* Grid version the field was built from */
+    unsigned int built;     /* Frame the field was built on */
+};
+
+/* Internally used globals */
+static Uint8 *nav_cells;        /* Cell flags, row by row */
+static Uint8 *nav_dirty;        /* Cell is waiting to be reclassified */
+static int *nav_dirtylist, nav_dirtycount;
+static int *nav_queue;          /* Breadth first search queue */
+static int nav_w, nav_h;
+static unsigned int nav_version;    /* Bumped when any cell changes */
+static unsigned int nav_frame;
+static struct FlowField nav_flow[4][2];
+
+/* Work out the flags of a cell from the collision map */
+static Uint8 classify_cell (int cx, int cy)
+{
+    int x, y, x1, y1, x2, y2;
+    int solid = 0, water = 0, free = 0, ground = 0;
+    x1 = cx << NAV_SHIFT;
+    y1 = cy << NAV_SHIFT;
+    x2 = x1 + NAV_CELL > lev_level.width ? lev_level.width : x1 + NAV_CELL;
+    y2 = y1 + NAV_CELL > lev_level.height ? lev_level.height : y1 + NAV_CELL;
+    for (x = x1; x < x2; x++) {
+        const unsigned char *col = lev_level.solid[x];
+        for (y = y1; y < y2; y++) {
+            int t = col[y];
+            if (ter_solid (t)) {
+                solid++;
+                if (ter_walkable (t) && y > 0 && col[y - 1] <= TER_WALKWAY)
+                    ground = 1;
+            } else if (ter_free (t)) {
+                free++;
+            } else {
+                water++;
+            }
+        }
+    }
+    return (solid == 0 && water == 0 ? NAV_AIR : 0) |
+        (solid == 0 && free == 0 ? NAV_WATER : 0) |
+        (ground ? NAV_GROUND : 0);
+}
+
+/* Build the navigation grid for the current level */
+void init_nav (void)
+{
+    int cx, cy, p, m;
+    free_nav ();
+    nav_w = (lev_level.width + NAV_CELL - 1) >> NAV_SHIFT;
+    nav_h = (lev_level.height + NAV_CELL - 1) >> NAV_SHIFT;
+    nav_cells = malloc (nav_w * nav_h);
+    nav_dirty = calloc (nav_w * nav_h, 1);
+    nav_dirtylist = malloc (nav_w * nav_h * sizeof (int));
+    nav_queue = malloc (nav_w * nav_h * sizeof (int));
+    if (!nav_cells || !nav_dirty || !nav_dirtylist || !nav_queue) {
+        perror ("init_nav");
+        exit (1);
+    }
+    for (cy = 0; cy < nav_h; cy++)
+        for (cx = 0; cx < nav_w; cx++)
+            nav_cells[cy * nav_w + cx] = classify_cell (cx, cy);
+    nav_dirtycount = 0;
+    nav_version = 1;
+    for (p = 0; p < 4; p++)
+        for (m = 0; m < 2; m++)
+            nav_flow[p][m].version = 0;
+}
+
+/* Free the navigation grid */
+void free_nav (void)
+{
+    int p, m;
+    free (nav_cells);
+    free (nav_dirty);
+    free (nav_dirtylist);
+    free (nav_queue);
+    nav_cells = NULL;
+    nav_dirty = NULL;
+    nav_dirtylist = NULL;
+    nav_queue = NULL;
+    for (p = 0; p < 4; p++)
+        for (m = 0; m < 2; m++) {
+            free (nav_flow[p][m].dist);
+            nav_flow[p][m].dist = NULL;
+        }
+}
+
+/* Note that terrain has changed */
+void nav_terrain_changed (int x, int y, int w, int h)
+{
+    int cx, cy, cx1, cy1, cx2, cy2;
+    if (nav_cells == NULL)
+        return;
+    cx1 = x < 0 ? 0 : x >> NAV_SHIFT;
+    cy1 = y < 0 ? 0 : y >> NAV_SHIFT;
+    /* The cell above may have lost or gained a surface too */
+    if (cy1 > 0 && (y & (NAV_CELL - 1)) == 0)
+        cy1--;
+    cx2 = (x + w - 1) >> NAV_SHIFT;
+    cy2 = (y + h - 1) >> NAV_SHIFT;
+    if (cx2 >= nav_w) cx2 = nav_w - 1;
+    if (cy2 >= nav_h) cy2 = nav_h - 1;
+    for (cy = cy1; cy <= cy2; cy++)
+        for (cx = cx1; cx <= cx2; cx++) {
+            int c = cy * nav_w + cx;
+            if (nav_dirty[c] == 0) {
+                nav_dirty[c] = 1;
+                nav_dirtylist[nav_dirtycount++] = c;
+            }
+        }
+}
+
+/* Reclassify changed cells */
+void update_nav (void)
+{
+    int r;
+    nav_frame++;
+    for (r = 0; r < nav_dirtycount; r++) {
+        int c = nav_dirtylist[r];
+        Uint8 flags = classify_cell (c % nav_w, c / nav_w);
+        if (flags != nav_cells[c]) {
+            nav_cells[c] = flags;
+            nav_version++;
+        }
+        nav_dirty[c] = 0;
+    }
+    nav_dirtycount = 0;
+}
+
+/* Get the flags of the cell containing the pixel */
+int nav_flags (int x, int y)
+{
+    if (nav_cells == NULL || x < 0 || y < 0 ||
+            x >= lev_level.width || y >= lev_level.height)
+        return 0;
+    return nav_cells[(y >> NAV_SHIFT) * nav_w + (x >> NAV_SHIFT)];
+}
+
+/* Check if a straight path only passes through cells with the flag set */
+int nav_clear_path (int x1, int y1, int x2, int y2, int flag)
+{
+    int cx, cy, ex, ey, dx, dy, sx, sy, err;
+    if (x1 < 0 || y1 < 0 || x1 >= lev_level.width || y1 >= lev_level.height
+            || (nav_flags (x2, y2) & flag) == 0)
+        return 0;
+    cx = x1 >> NAV_SHIFT;
+    cy = y1 >> NAV_SHIFT;
+    ex = x2 >> NAV_SHIFT;
+    ey = y2 >> NAV_SHIFT;
+    dx = abs (ex - cx);
+    dy = abs (ey - cy);
+    sx = ex < cx ? -1 : 1;
+    sy = ey < cy ? -1 : 1;
+    err = dx - dy;
+    while (cx != ex || cy != ey) {
+        /* Step through the cells the line touches, never corner to corner */
+        if (err * 2 > -dy) {
+            err -= dy;
+            cx += sx;
+        } else {
+            err += dx;
+            cy += sy;
+        }
+        if ((nav_cells[cy * nav_w + cx] & flag) == 0)
+            return 0;
+    }
+    return 1;
+}
+
+/* Fill in distances to cell tx,ty through cells with the flag set */
+static void build_flow (struct FlowField *field, int flag, int tx, int ty)
+{
+    static const int ndx[4] = { 1, -1, 0, 0 };
+    static const int ndy[4] = { 0, 0, 1, -1 };
+    int head = 0, tail = 0;
+    if (field->dist == NULL) {
+        field->dist = malloc (nav_w * nav_h * sizeof (Uint16));
+        if (!field->dist) {
+            perror ("build_flow");
+            exit (1);
+        }
+    }
+    memset (field->dist, 0xff, nav_w * nav_h * sizeof (Uint16));
+    field->tx = tx;
+    field->ty = ty;
+    field->version = nav_version;
+    field->built = nav_frame;
+
+    field->dist[ty * nav_w + tx] = 0;
+    nav_queue[tail++] = ty * nav_w + tx;
+    while (head < tail) {
+        int c = nav_queue[head++];
+        int cx = c % nav_w, cy = c / nav_w;
+        int d = field->dist[c] + 1;
+        int n;
+        if (d > NAV_FLOW_RANGE)
+            continue;
+        for (n = 0; n < 4; n++) {
+            int nx = cx + ndx[n], ny = cy + ndy[n], nc;
+            if (nx < 0 || ny < 0 || nx >= nav_w || ny >= nav_h)
+                continue;
+            nc = ny * nav_w + nx;
+            if (field->dist[nc] == NAV_UNREACHED && (nav_cells[nc] & flag)) {
+                field->dist[nc] = d;
+                nav_queue[tail++] = nc;
+            }
+        }
+    }
+}
+
+/* Find the next waypoint on the way to a player */
+int nav_towards_player (int plr, int flag, int x, int y, float *wx, float *wy)
+{
+    struct FlowField *field = &nav_flow[plr][flag == NAV_WATER];
+    float px, py;
+    int tx, ty, cx, cy, n, best, bestd;
+
+    if (nav_cells == NULL || players[plr].state != ALIVE)
+        return 0;
+    if (players[plr].ship) {
+        px = players[plr].ship->physics.x;
+        py = players[plr].ship->physics.y;
+    } else {
+        px = players[plr].pilot.walker.physics.x;
+        py = players[plr].pilot.walker.physics.y;
+    }
+    if (px < 0 || py < 0 || px >= lev_level.width || py >= lev_level.height
+            || x < 0 || y < 0 || x >= lev_level.width || y >= lev_level.height)
+        return 0;
+    tx = (int)px >> NAV_SHIFT;
+    ty = (int)py >> NAV_SHIFT;
+    cx = x >> NAV_SHIFT;
+    cy = y >> NAV_SHIFT;
+
+    /* Rebuild when the terrain or the target has changed, */
+    /* but not more often than every few frames */
+    if (field->version == 0 || ((field->version != nav_version
+                || field->tx != tx || field->ty != ty)
+            && nav_frame - field->built >= NAV_FLOW_INTERVAL))
+        build_flow (field, flag, tx, ty);
+
+    /* Already there, head straight for the target */
+    if ((cx == tx && cy == ty) || (cx == field->tx && cy == field->ty)) {
+        *wx = px;
+        *wy = py;
+        return 1;
+    }
+
+    /* Go downhill. Diagonal moves are allowed when both */
+    /* cells around the corner are open */
+    best = -1;
+    bestd = field->dist[cy * nav_w + cx];
+    for (n = 0; n < 9; n++) {
+        int nx = cx + n % 3 - 1, ny = cy + n / 3 - 1, nc;
+        if (nx < 0 || ny < 0 || nx >= nav_w || ny >= nav_h)
+            continue;
+        if (nx != cx && ny != cy &&
+                ((nav_cells[cy * nav_w + nx] & flag) == 0 ||
+                 (nav_cells[ny * nav_w + cx] & flag) == 0))
+            continue;
+        nc = ny * nav_w + nx;
+        if (field->dist[nc] < bestd) {
+            bestd = field->dist[nc];
+            best = nc;
+        }
+    }
+    if (best < 0)
+        return 0;
+    *wx = ((best % nav_w) << NAV_SHIFT) + NAV_CELL / 2;
+    *wy = ((best / nav_w) << NAV_SHIFT) + NAV_CELL / 2;
+    return 1;
+}
+
+/* Count how many cells one can walk along the ground */
+int nav_ground_run (int x, int y, int dir, int max)
+{
+    int cx = x >> NAV_SHIFT, cy = y >> NAV_SHIFT;
+    int run = 0;
+    if (nav_cells == NULL || x < 0 || y < 0 || cx < 0 || cy < 0 || cx >= nav_w || cy >= nav_h)
+        return 0;
+    while (run < max) {
+        cx += dir;
+        if (cx < 0 || cx >= nav_w)
+            break;
+        /* Prefer the same row, then allow a step up or down */
+        if (nav_cells[cy * nav_w + cx] & NAV_GROUND)
+            ;
+        else if (cy > 0 && (nav_cells[(cy - 1) * nav_w + cx] & NAV_GROUND))
+            cy--;
+        else if (cy + 1 < nav_h && (nav_cells[(cy + 1) * nav_w + cx] & NAV_GROUND))
+            cy++;
+        else
+            break;
+        run++;
+    }
+    return run;
+}
@@ -0,0 +1,66 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : nav.h
+ * Description : Navigation grid and flow fields for critters
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef NAV_H
+#define NAV_H
+
+/* The level is divided into square cells of 2^NAV_SHIFT pixels */
+#define NAV_SHIFT   3
+#define NAV_CELL    (1<<NAV_SHIFT)
+
+/* Cell flags */
+#define NAV_AIR     0x01    /* No solid terrain or water in the cell */
+#define NAV_WATER   0x02    /* The cell is all water */
+#define NAV_GROUND  0x04    /* The cell has walkable surface */
+
+/* Build the navigation grid for the current level */
+extern void init_nav (void);
+
+/* Free the navigation grid */
+extern void free_nav (void);
+
+/* Note that terrain has changed. The cells are reclassified */
+/* on the next call to update_nav */
+extern void nav_terrain_changed (int x, int y, int w, int h);
+
+/* Reclassify changed cells. Called once per frame */
+extern void update_nav (void);
+
+/* Get the flags of the cell containing the pixel */
+extern int nav_flags (int x, int y);
+
+/* Check if a straight path only passes through cells with the flag */
+/* set. The starting cell is not checked */
+extern int nav_clear_path (int x1, int y1, int x2, int y2, int flag);
+
+/* Find the next waypoint on the way to a player. The flow field is */
+/* shared by everyone going after the same player in the same medium. */
+/* Returns 0 if the player cannot be reached from x,y */
+extern int nav_towards_player (int plr, int flag, int x, int y,
+                               float *wx, float *wy);
+
+/* Count how many cells one can walk along the ground from x,y */
+/* in direction dir (-1 or 1), up to max */
+extern int nav_ground_run (int x, int y, int dir, int max);
+
+#endif
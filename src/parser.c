@@ -57,59 +57,99 @@ char *strip_white_space (const char *str)
     return newstr;
 }
 
-static int split_string (char *str, char delim, char **left, char **right)
+/* Hash a configuration key */
+static unsigned int hash_key (const char *key)
 {
-    int l1;
-    char *tl = NULL, *tr = NULL;
-    tl = strchr (str, delim);
-    if(tl) l1 = tl-str; else return 1;
-    tl = malloc (l1 + 1);
-    strncpy (tl, str, l1);
-    tl[l1] = 0;
-    tr = malloc (strlen (str) - l1);
-    strcpy (tr, str + l1 + 1);
-
-    *left = strip_white_space (tl);
-    *right = strip_white_space (tr);
-    free (tl);
-    free (tr);
-    return 0;
+    unsigned int hash = 5381;
+    while (*key)
+        hash = hash * 33 + (unsigned char) *key++;
+    return hash;
 }
 
-/*** Read a single line from file, removing comments and empty lines ***/
-/* Line is read up to EOL, EOF or len. Number of bytes read is substracted
- * from len. */
-static char *read_line(SDL_RWops *rw,size_t *len) {
-    char tmps[512],*line;
-    size_t limit=sizeof(tmps),read=0;
+/* Strip whitespace from both ends of str..end in place. */
+/* Returns NULL if nothing is left */
+static char *trim_in_place (char *str, char *end)
+{
+    while (str < end && (unsigned char) *str <= ' ')
+        str++;
+    while (end > str && (unsigned char) end[-1] <= ' ')
+        end--;
+    if (str == end)
+        return NULL;
+    *end = '\0';
+    return str;
+}
 
-    if(len && *len<limit)
-        limit = *len;
+/*** Parse a configuration file in place ***/
+/* The text must have room for a terminator at text[len] */
+static struct ConfigFile *parse_config (char *text, size_t len)
+{
+    struct ConfigFile *cfg;
+    struct ConfigBlock *block = NULL;
+    struct KeyValue *pairs;
+    char *line, *end = text + len;
+    size_t lines = 1;
 
-    while(read<limit) {
-        if(SDL_RWread(rw,tmps+read,1,1)!=1) break;
-        read++;
-        if(tmps[read-1]=='\n') break;
+    /* Every line is at most one block or pair, so the whole file */
+    /* fits into one allocation sized by the line count */
+    for (line = text; (line = memchr (line, '\n', end - line)); line++)
+        lines++;
+    cfg = malloc (sizeof (struct ConfigFile) +
+                  lines * (sizeof (struct ConfigBlock) +
+                           sizeof (struct KeyValue)));
+    if (cfg == NULL) {
+        perror ("parse_config");
+        exit (1);
     }
-    if(read==0) return NULL;
-    tmps[read]='\0';
-
-    line=strip_white_space(tmps);
-    if(line==NULL)
-        line="\0";
-    else if(line[0]=='#') {
-        free(line);
-        line="\0";
+    cfg->blocks = (struct ConfigBlock *) (cfg + 1);
+    cfg->count = 0;
+    cfg->text = text;
+    pairs = (struct KeyValue *) (cfg->blocks + lines);
+
+    text[len] = '\0';
+    for (line = text; line < end;) {
+        char *eol = memchr (line, '\n', end - line);
+        char *str, *eq;
+        if (eol == NULL)
+            eol = end;
+        str = trim_in_place (line, eol);
+        line = eol + 1;
+        if (str == NULL || str[0] == '#')
+            continue;
+        if (str[0] == '[') {    /* New block */
+            block = &cfg->blocks[cfg->count++];
+            block->title = str + 1;
+            if (block->title[0])
+                block->title[strlen (block->title) - 1] = '\0';
+            block->values = pairs;
+            block->count = 0;
+            continue;
+        } else if (block == NULL) {     /* Default block */
+            block = &cfg->blocks[cfg->count++];
+            block->title = NULL;
+            block->values = pairs;
+            block->count = 0;
+        }
+        pairs->key = NULL;
+        pairs->value = NULL;
+        pairs->hash = 0;
+        eq = strchr (str, '=');
+        if (eq) {
+            pairs->key = trim_in_place (str, eq);
+            pairs->value = trim_in_place (eq + 1, eq + 1 + strlen (eq + 1));
+            if (pairs->key)
+                pairs->hash = hash_key (pairs->key);
+        }
+        pairs++;
+        block->count++;
     }
-    if(len)
-        *len -= read;
-    return line;
+    return cfg;
 }
 
 /*** Read and parse a configuration file ***/
-struct dllist *read_config_file(const char *filename,int quiet) {
+struct ConfigFile *read_config_file(const char *filename,int quiet) {
     SDL_RWops *rw = SDL_RWFromFile(filename,"r");
-    struct dllist *config;
+    struct ConfigFile *config;
 
     if(!rw) {
         if(!quiet)
@@ -124,101 +164,110 @@ struct dllist *read_config_file(const char *filename,int quiet) {
 }
 
 /*** Read and parse a configuration file from an SDL_RWops ***/
-struct dllist *read_config_rw(SDL_RWops *rw,size_t len,int quiet) {
-	struct ConfigBlock *block=NULL;
-	struct dllist *blocks=NULL;
-    size_t *length;
-	char *str;
-
-    if(len>0)
-        length=&len;
-    else
-        length=NULL;
-
-	while((str=read_line(rw,length))) {
-		struct KeyValue *pair;
-		if(str[0]=='\0') continue;
-		if(str[0]=='[') { /* New block */
-			if(block && block->values)
-				while(block->values->prev)
-					block->values=block->values->prev;
-			block=malloc(sizeof(struct ConfigBlock));
-			block->title=strdup(str+1);
-			block->title[strlen(block->title)-1]='\0';
-			block->values=NULL;
-			blocks=dllist_append(blocks,block);
-            free(str);
-			continue;
-		} else if(block==NULL) { /* Default block */
-			block=malloc(sizeof(struct ConfigBlock));
-            block->title=NULL;
-            block->values=NULL;
-			blocks=dllist_append(blocks,block);
-		}
-		pair=malloc(sizeof(struct KeyValue));
-        pair->key = NULL; pair->value = NULL;
-		split_string(str,'=',&pair->key,&pair->value);
-		block->values=dllist_append(block->values,pair);
-        free(str);
-	}
-	if(block && block->values)
-		while(block->values->prev)
-			block->values=block->values->prev;
-	if(blocks)
-		while(blocks->prev) blocks=blocks->prev;
-	return blocks;
+struct ConfigFile *read_config_rw(SDL_RWops *rw,size_t len,int quiet) {
+    struct ConfigFile *cfg;
+    size_t size, read = 0;
+    char *text;
+
+    /* Read the whole file in one go */
+    size = len > 0 ? len : 4096;
+    text = malloc (size + 1);
+    while (text) {
+        int got = SDL_RWread (rw, text + read, 1, size - read);
+        if (got <= 0)
+            break;
+        read += got;
+        if (read < size)
+            continue;
+        if (len > 0)
+            break;
+        size *= 2;
+        text = realloc (text, size + 1);
+    }
+    if (text == NULL) {
+        perror ("read_config_rw");
+        exit (1);
+    }
+
+    cfg = parse_config (text, read);
+    if (cfg->count == 0) {
+        free_config_file (cfg);
+        return NULL;
+    }
+    return cfg;
 }
 
 /*** Set values ***/
-void translate_config(struct dllist *values,const struct Translate tr[],int quiet) {
-	int r;
-	while(values) {
-		struct KeyValue *pair=values->data;
-        if(pair==NULL || pair->key==NULL || pair->value==NULL) {
+/* The keys of the translation table are hashed into a small open */
+/* addressing table, so each setting is found with one probe or two */
+#define TRANSLATE_SLOTS 128
+
+void translate_config(const struct ConfigBlock *block,const struct Translate tr[],int quiet) {
+    unsigned char slots[TRANSLATE_SLOTS];
+    unsigned int hashes[TRANSLATE_SLOTS / 2];
+    int count, r, v;
+
+    for (count = 0; tr[count].key; count++) {}
+    if (count > TRANSLATE_SLOTS / 2) {
+        fprintf (stderr, "translate_config: too many settings (%d)\n", count);
+        exit (1);
+    }
+    memset (slots, 0, sizeof (slots));
+    for (r = 0; r < count; r++) {
+        unsigned int s;
+        hashes[r] = hash_key (tr[r].key);
+        s = hashes[r] & (TRANSLATE_SLOTS - 1);
+        /* The first of duplicate keys wins */
+        while (slots[s] && strcmp (tr[slots[s] - 1].key, tr[r].key))
+            s = (s + 1) & (TRANSLATE_SLOTS - 1);
+        if (slots[s] == 0)
+            slots[s] = r + 1;
+    }
+
+    for (v = 0; v < block->count; v++) {
+        const struct KeyValue *pair = &block->values[v];
+        if(pair->key==NULL || pair->value==NULL) {
             fprintf(stderr,"Unrecognized setting.\n");
             fprintf(stderr,"\"%s\" = \"%s\"\n",pair->key?pair->key:"(null)",
                     pair->value?pair->value:"(null)");
-        } else {
-            r=0;
-            while(tr[r].key) {
-                if(strcmp(tr[r].key,pair->key)==0) {
-                    switch(tr[r].type) {
-                        case CFG_INT: *((int*)tr[r].ptr)=atoi(pair->value); break;
-                        case CFG_FLOAT: *((float*)tr[r].ptr)=atof(pair->value); break;
-                        case CFG_DOUBLE: *((double*)tr[r].ptr)=atof(pair->value); break;
-                        case CFG_STRING: *((char**)tr[r].ptr)=strdup(pair->value); break;
-                        case CFG_MULTISTRING: {
-                            struct dllist **list = tr[r].ptr;
-                            if(*list)
-                                dllist_append(*list,strdup(pair->value));
-                            else
-                                *list = dllist_append(NULL,strdup(pair->value));
-                            } break;
-
-                    }
+            continue;
+        }
+        r = -1;
+        {
+            unsigned int s = pair->hash & (TRANSLATE_SLOTS - 1);
+            while (slots[s]) {
+                int i = slots[s] - 1;
+                if (hashes[i] == pair->hash
+                    && strcmp (tr[i].key, pair->key) == 0) {
+                    r = i;
                     break;
                 }
-                r++;
+                s = (s + 1) & (TRANSLATE_SLOTS - 1);
             }
-            if(tr[r].key==NULL && quiet==0) {
+        }
+        if (r < 0) {
+            if (quiet == 0)
                 fprintf(stderr,"Unrecognized setting \"%s\"\n",pair->key);
-            }
+            continue;
         }
-		values=values->next;
-	}
-}
-
-/* Used by dllist_free to free a configuration file buffer */
-static void free_config_key_pair(void *data) {
-    free(((struct KeyValue*)data)->key);
-    free(((struct KeyValue*)data)->value);
-	free(data);
+        switch(tr[r].type) {
+            case CFG_INT: *((int*)tr[r].ptr)=atoi(pair->value); break;
+            case CFG_FLOAT: *((float*)tr[r].ptr)=atof(pair->value); break;
+            case CFG_DOUBLE: *((double*)tr[r].ptr)=atof(pair->value); break;
+            case CFG_STRING: *((char**)tr[r].ptr)=strdup(pair->value); break;
+            case CFG_MULTISTRING: {
+                struct dllist **list = tr[r].ptr;
+                if(*list)
+                    dllist_append(*list,strdup(pair->value));
+                else
+                    *list = dllist_append(NULL,strdup(pair->value));
+                } break;
+        }
+    }
 }
 
-void free_config_file(void *data) {
-	struct ConfigBlock *block=data;
-	free(block->title);
-	dllist_free(block->values,free_config_key_pair);
-	free(block);
+/* Free a parsed configuration file */
+void free_config_file(struct ConfigFile *cfg) {
+    free(cfg->text);
+    free(cfg);
 }
-
@@ -26,14 +26,23 @@
 
 #include "list.h"
 
+struct KeyValue {
+    char *key;
+    char *value;
+    unsigned int hash;          /* Hash of the key */
+};
+
 struct ConfigBlock {
     char *title;
-    struct dllist *values;
+    struct KeyValue *values;
+    int count;
 };
 
-struct KeyValue {
-    char *key;
-    char *value;
+/* A parsed configuration file. All strings point into the file text */
+struct ConfigFile {
+    struct ConfigBlock *blocks;
+    int count;
+    char *text;
 };
 
 struct Translate {
@@ -42,18 +51,19 @@ struct Translate {
     void *ptr;
 };
 
-/* Read a configuration file. Returns a list of ConfigBlocks */
-extern struct dllist *read_config_file(const char *filename,int quiet);
+/* Read a configuration file. Returns NULL if the file could not be read */
+/* or has no blocks */
+extern struct ConfigFile *read_config_file(const char *filename,int quiet);
 
 /* Read a configuration file from an SDL_RWops. len is the length of the */
 /* configuration file. If 0, RWops is read until EOF. */
-extern struct dllist *read_config_rw(SDL_RWops *rw,size_t len,int quiet);
+extern struct ConfigFile *read_config_rw(SDL_RWops *rw,size_t len,int quiet);
 
 /* Extract data from a ConfigBlock */
-extern void translate_config(struct dllist *values,const struct Translate tr[],int quiet);
+extern void translate_config(const struct ConfigBlock *block,const struct Translate tr[],int quiet);
 
-/* Free a config block. Pass to dllist_free() */
-extern void free_config_file(void *data);
+/* Free a configuration file */
+extern void free_config_file(struct ConfigFile *cfg);
 
 /* Strip all whitespace characters from beginning and end */
 extern char *strip_white_space (const char *str);
@@ -30,10 +30,12 @@
 #include "level.h"
 #include "player.h"
 #include "particle.h"
+#include "points.h"
 #include "list.h"
 
 /* Internally used globals */
 static struct dllist *particles;
+static struct PointBatch particle_points;
 
 /* Deinitialize */
 void clear_particles (void) {
@@ -60,26 +62,6 @@ struct Particle *make_particle (float x, float y, int age)
     return newpart;
 }
 
-/* Draw a single particle on all viewports */
-static inline void draw_particle (struct Particle * part)
-{
-    Uint32 color;
-    int x, y, p;
-
-    color = map_rgba(part->color[0], part->color[1], part->color[2],
-            part->color[3]);
-    for (p = 0; p < 4; p++) {
-        if (players[p].state==ALIVE || players[p].state==DEAD) {
-            x = Round(part->x) - cam_rects[p].x;
-            y = Round(part->y) - cam_rects[p].y;
-            if ((x > 0 && x < cam_rects[p].w)
-                && (y > 0 && y < cam_rects[p].h))
-                putpixel (screen, viewport_rects[p].x + x,
-                        viewport_rects[p].y + y, color);
-        }
-    }
-}
-
 void animate_particles (void)
 {
     struct dllist *list = particles, *next;
@@ -102,9 +84,12 @@ void animate_particles (void)
                 else
                     dllist_remove(list);
         } else
-            draw_particle (part);
+            add_point (&particle_points, Round(part->x), Round(part->y),
+                    map_rgba(part->color[0], part->color[1],
+                        part->color[2], part->color[3]));
         list = next;
     }
+    draw_points (&particle_points);
 }
 
 /* Calculate color delta values */
@@ -113,15 +113,148 @@ static void object_impact(struct Physics *obj1, struct Physics *obj2) {
     obj1->vel = addVectors(obj1->vel,tmpv2);
 }
 
-/* Animate a physical object for 1 frame */
-void animate_object(struct Physics *object,int lists,struct dllist *objects[]) {
-    struct dllist *ga = gravities;
-    Vector flow = {0,0};
+/* Check if terrain stops an object */
+static inline int blocks_object(const struct Physics *object, int terrain) {
+    if(object->semisolid && ter_semisolid(terrain))
+        return 0;
+    return ter_solid(terrain);
+}
+
+/* Sweep an object through the terrain from its current position to */
+/* (x1,y1). Every pixel the path touches is checked, so the object */
+/* can't slip through thin walls or diagonal gaps. */
+/* Returns nonzero if the path is blocked. terrain, hitx and hity are */
+/* set to the blocking (or the last) pixel and toi to the fraction */
+/* of the path travelled before it. */
+static int sweep_terrain(const struct Physics *object, double x1, double y1,
+        int *terrain, int *hitx, int *hity, double *toi)
+{
+    double x0 = object->x, y0 = object->y;
+    double dx = x1 - x0, dy = y1 - y0;
+    double tmaxx, tmaxy, tdeltax, tdeltay, t = 0;
+    int x = Round(x0), y = Round(y0);
+    int endx = Round(x1), endy = Round(y1);
+    int stepx = dx < 0 ? -1 : 1, stepy = dy < 0 ? -1 : 1;
+    int n = abs(endx - x) + abs(endy - y);
+
+    /* Distances to the next pixel edges, as fractions of the path */
+    if(dx != 0) {
+        tmaxx = (x + 0.5*stepx - x0) / dx;
+        tdeltax = 1.0 / fabs(dx);
+    } else {
+        tmaxx = tdeltax = HUGE_VAL;
+    }
+    if(dy != 0) {
+        tmaxy = (y + 0.5*stepy - y0) / dy;
+        tdeltay = 1.0 / fabs(dy);
+    } else {
+        tmaxy = tdeltay = HUGE_VAL;
+    }
+    while(1) {
+        if(x<0 || x>=lev_level.width || y<0 || y>=lev_level.height)
+            *terrain = TER_INDESTRUCT;
+        else
+            *terrain = lev_level.solid[x][y];
+        if(blocks_object(object,*terrain)) {
+            *hitx = x;
+            *hity = y;
+            *toi = t;
+            return 1;
+        }
+        if(n-- <= 0)
+            break;
+        if(tmaxx < tmaxy) {
+            t = tmaxx;
+            tmaxx += tdeltax;
+            x += stepx;
+        } else {
+            t = tmaxy;
+            tmaxy += tdeltay;
+            y += stepy;
+        }
+    }
+    *terrain = lev_level.solid[endx][endy];
+    *hitx = endx;
+    *hity = endy;
+    *toi = 1.0;
+    return 0;
+}
+
+/* Find the first object the moving object touches along the path */
+/* from its current position to its current position + (dx,dy)*limit. */
+/* The other objects are treated as stationary for the step. */
+/* Returns the object and sets toi to the fraction of the path */
+static struct Physics *sweep_objects(struct Physics *object, double dx,
+        double dy, double limit, int lists, struct dllist *objects[],
+        double *toi)
+{
+    struct Physics *first = NULL;
+    double minx, maxx, miny, maxy;
+    double a = dx*dx + dy*dy;
+    int l;
+
+    /* Bounding box of the path */
+    minx = object->x + (dx<0 ? dx*limit : 0);
+    maxx = object->x + (dx>0 ? dx*limit : 0);
+    miny = object->y + (dy<0 ? dy*limit : 0);
+    maxy = object->y + (dy>0 ? dy*limit : 0);
+    *toi = limit;
+
+    for(l=0;l<lists;l++) {
+        struct dllist *list = objects[l];
+        for(;list;list=list->next) {
+            struct Physics *obj2 = list->data;
+            double r = object->radius + obj2->radius;
+            double fx, fy, b, c, disc, t;
+            if(obj2 == object)
+                continue;
+            /* First, check bounding box collisions */
+            if(obj2->x + r <= minx || obj2->x - r >= maxx ||
+               obj2->y + r <= miny || obj2->y - r >= maxy)
+                continue;
+            /* Then solve the time of impact */
+            fx = object->x - obj2->x;
+            fy = object->y - obj2->y;
+            c = fx*fx + fy*fy - r*r;
+            if(c < 0) {
+                /* Already touching: only a hit if still touching at */
+                /* the end, so objects can leave each other */
+                double ex = fx + dx*limit, ey = fy + dy*limit;
+                if(ex*ex + ey*ey >= r*r)
+                    continue;
+                t = limit;
+            } else {
+                if(a == 0)
+                    continue;
+                b = 2 * (fx*dx + fy*dy);
+                disc = b*b - 4*a*c;
+                if(b >= 0 || disc < 0)
+                    continue;
+                t = (-b - sqrt(disc)) / (2*a);
+                if(t > limit)
+                    continue;
+            }
+            if(first==NULL || t < *toi) {
+                first = obj2;
+                *toi = t;
+            }
+        }
+    }
+    return first;
+}
+
+/* Move an object by its velocity and check collisions. */
+/* The path is swept against terrain and other objects, so fast */
+/* objects can't tunnel through thin walls or small objects. */
+static void move_object(struct Physics *object, int lists,
+        struct dllist *objects[], Vector *flow)
+{
     double newx,newy;
+    double toi = 1.0;
     int ix,iy;
-    double k;
-    Vector Fv;
     int hitx,hity;
+    int terrain = TER_FREE;
+    int blocked = 0;
 
     /* Next position for object */
     newx = object->x + object->vel.x;
@@ -140,16 +273,44 @@ void animate_object(struct Physics *object,int lists,struct dllist *objects[]) {
         object->vel.x = 0.0;
         object->vel.y = 0.0;
     } else if(object->solidity!=IMMATERIAL) {
-        /* Check terrain collision if object is solid */
-        int terrain,solid;
+        /* Find the first terrain pixel in the way */
         object->underwater = 0;
         object->hitground  = 0;
-        if(object->solidity==SOLID) {
-            terrain = hit_solid_line(Round(object->x), Round(object->y),
-                    ix,iy,&hitx,&hity);
-        } else {
+        blocked = sweep_terrain(object,newx,newy,&terrain,&hitx,&hity,&toi);
+        /* Wraiths that are already inside terrain move through it like */
+        /* through air, so only the end point is checked for them */
+        if(blocked && toi==0 && object->solidity==WRAITH) {
+            blocked = 0;
+            toi = 1.0;
             terrain = lev_level.solid[ix][iy];
         }
+    }
+
+    /* Check object collisions */
+    /* Note. collides with only one object at a time, the first one */
+    /* along the path before any terrain in the way */
+    /* Object collision checks are not done if the object is already in */
+    /* the ground. This is to stop bullets from damaging a ship */
+    /* or killing a pilot while burrowing */
+    if(object->obj && object->hitground==0 && !(blocked && toi==0)) {
+        double t;
+        object->hitobj = sweep_objects(object, object->vel.x,
+                object->vel.y, toi, lists, objects, &t);
+        if(object->hitobj) {
+            object_impact(object,object->hitobj);
+            /* The object stops where it touched the other object */
+            newx = object->x + (newx - object->x) * t;
+            newy = object->y + (newy - object->y) * t;
+            ix = Round(newx);
+            iy = Round(newy);
+            if(object->solidity!=IMMATERIAL)
+                terrain = lev_level.solid[ix][iy];
+            blocked = 0;
+        }
+    }
+
+    if(object->solidity!=IMMATERIAL && object->hitground==0) {
+        int solid;
         if(ter_free(terrain)) solid=0;
         else if(object->semisolid && ter_semisolid(terrain)) solid=0;
         else if(terrain==TER_WATER) solid = -1;
@@ -157,16 +318,16 @@ void animate_object(struct Physics *object,int lists,struct dllist *objects[]) {
             solid = -2-(terrain-TER_WATERFU);
         else solid = terrain;
         /* Snow and ice are soft, so things can burrow into them */
-        if((solid==TER_SNOW || solid==TER_ICE) &&
+        if(blocked && (solid==TER_SNOW || solid==TER_ICE) &&
             object->solidity==SOLID && object->mass *
                 hypot(object->hitvel.x,object->hitvel.y) > 4.9) {
             if(solid==TER_SNOW) {
                 Vector sv = multVector(oppositeVector(object->hitvel),0.2);
-                putpixel(lev_level.terrain,hitx,hity,col_black);
+                put_terrain_pixel(hitx,hity,col_black);
                 lev_level.solid[hitx][hity] = TER_FREE;
                 add_decor(make_snowflake(hitx + sv.x,hity + sv.y, sv));
             } else {
-                putpixel(lev_level.terrain,hitx,hity,lev_watercol);
+                put_terrain_pixel(hitx,hity,lev_watercol);
                 lev_level.solid[hitx][hity] = TER_WATER;
             }
         }
@@ -193,6 +354,13 @@ void animate_object(struct Physics *object,int lists,struct dllist *objects[]) {
                 }
                 object->vel.x = 0;
                 object->vel.y = 0;
+            } else if(blocked) {
+                /* Wraiths keep their velocity, but stop where they */
+                /* touched the terrain so it is reported in the right place */
+                newx = hitx;
+                newy = hity;
+                ix = hitx;
+                iy = hity;
             }
         } else {
             if(solid<0) {
@@ -204,10 +372,10 @@ void animate_object(struct Physics *object,int lists,struct dllist *objects[]) {
                             multVector(object->vel,0.5), make_waterdrop);
                 }
                 switch(solid) {
-                        case -2: flow.y = -WATER_FLOW; break;
-                        case -3: flow.x = WATER_FLOW; break;
-                        case -4: flow.y = WATER_FLOW; break;
-                        case -5: flow.x = -WATER_FLOW; break;
+                        case -2: flow->y = -WATER_FLOW; break;
+                        case -3: flow->x = WATER_FLOW; break;
+                        case -4: flow->y = WATER_FLOW; break;
+                        case -5: flow->x = -WATER_FLOW; break;
                     }
             } else if(object->radius>SPLASH_TRESHOLD && is_water(Round(object->x),Round(object->y)) && hypot(object->vel.x,object->vel.y) > SPLASH_SPEED)
             {
@@ -216,50 +384,17 @@ void animate_object(struct Physics *object,int lists,struct dllist *objects[]) {
             }
         }
     }
-    /* Check object collisions */
-    /* Note. collides with only one object at a time */
-    /* Object collision checks are only done if object hasn't already
-     * collided with ground. This is to stop bullets from damaging a ship
-     * or killing a pilot while burrowing */
-    if(object->obj && object->hitground==0) {
-        int l=0;
-        object->hitobj = NULL;
-        while(l<lists && object->hitobj==NULL) {
-            struct dllist *list = objects[l];
-            while(list) {
-                struct Physics *obj2 = list->data;
-                if(obj2 == object) {
-                    list=list->next;
-                    continue;
-                }
-                /* First, check bounding box collisions */
-                if( fabs(newx - obj2->x) < (object->radius + obj2->radius) &&
-                    fabs(newy - obj2->y) < (object->radius + obj2->radius)) {
-                    /* Then do a more accurate check */
-                    double d = hypot(newx-obj2->x, newy-obj2->y);
-                    if(d < (object->radius + obj2->radius)) {
-                        object->hitobj = obj2;
-                        object_impact(object,obj2);
-#if 0
-                        /* Exchange energies. Doesn't work properly yet */
-                        Vector tmpv1,tmpv2;
-                        tmpv1 = multVector(object->vel,1*object->mass/obj2->mass);
-                        tmpv2 = multVector(obj2->vel,1*obj2->mass/object->mass);
-                        obj2->vel = addVectors(obj2->vel,tmpv1);
-                        object->vel = addVectors(object->vel,tmpv2);
-#endif
-                        break;
-                    }
-                }
-                list=list->next;
-            }
-            l++;
-        }
-    }
 
     /* Relocate object to new coordinates */
     object->x = newx;
     object->y = newy;
+}
+
+/* Apply forces to an object for one frame */
+static void apply_forces(struct Physics *object, Vector flow) {
+    struct dllist *ga = gravities;
+    double k;
+    Vector Fv;
 
     /* Gravity anomalies */
     while(ga) {
@@ -297,6 +432,13 @@ void animate_object(struct Physics *object,int lists,struct dllist *objects[]) {
     object->vel = addVectors(object->vel, Fv);
 }
 
+/* Animate a physical object for 1 frame */
+void animate_object(struct Physics *object,int lists,struct dllist *objects[]) {
+    Vector flow = {0,0};
+    move_object(object,lists,objects,&flow);
+    apply_forces(object,flow);
+}
+
 /* Get the mass required for an object of given radius to float in air */
 /* Forces affecting an object are gravity and lift */
 /* Lift must be great enough to counter gravity, but not too great, so
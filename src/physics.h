@@ -75,7 +75,7 @@ struct GravityAnomaly {
     float offset;
 };
 
-/* Clear away old gravity anomalies */
+/* Clear away old gravity anomalies and set the number of physics steps */
 extern void reset_physics(void);
 
 /* Create a new physical object with default values. */
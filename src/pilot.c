@@ -191,7 +191,8 @@ static void make_sweatdrops(const struct Pilot *pilot) {
 
 /*** PILOT ANIMATION ***/
 void animate_pilots (void) {
-    int p;
+    struct Spring *ropes[4];
+    int p, ropecount = 0;
     for(p=0;p<4;p++) {
         struct Pilot *pilot = &players[p].pilot;
         if(players[p].state != ALIVE || players[p].ship)
@@ -218,7 +219,7 @@ void animate_pilots (void) {
             pilot->crosshair_color = col_white;
         }
 
-        /* Rope simulation */
+        /* Rope length control */
         if(pilot->rope) {
             if(pilot->ropectrl<0) {
                 if(pilot->rope->nodelen>pilot_rope_minlen)
@@ -227,8 +228,6 @@ void animate_pilots (void) {
                 if(pilot->rope->nodelen<pilot_rope_maxlen)
                     pilot->rope->nodelen += 0.05;
             }
-
-            animate_spring(pilot->rope);
         }
 
         /* Stop parachuting when hitting something other than air */
@@ -251,6 +250,14 @@ void animate_pilots (void) {
             }
         }
     }
+
+    /* Rope simulation. All ropes are animated in one batch */
+    for(p=0;p<4;p++) {
+        if(players[p].state == ALIVE && players[p].ship==NULL
+                && players[p].pilot.rope)
+            ropes[ropecount++] = players[p].pilot.rope;
+    }
+    animate_springs(ropes, ropecount);
 }
 
 /* Draw the crosshair */
@@ -331,6 +338,8 @@ static void pilot_shoot_rope(struct Pilot *pilot, Vector v) {
     int r;
     v = multVector(v,24.0);
     pilot->rope = create_spring(&pilot->walker.physics,6.0,10);
+    if(!pilot->rope)
+        return;
     pilot->rope->tail->vel = addVectors(pilot->walker.physics.vel,v);
 
 #if 1
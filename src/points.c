@@ -0,0 +1,120 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2001-2006 Calle Laakkonen
+ *
+ * File        : points.c
+ * Description : Batched single pixel drawing
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "SDL.h"
+
+#include "console.h"
+#include "level.h"
+#include "player.h"
+#include "points.h"
+
+/* Grow the batch */
+int grow_points (struct PointBatch *batch)
+{
+    int newsize = batch->size ? batch->size * 2 : 256;
+    struct Point *points = realloc (batch->points,
+            sizeof (struct Point) * newsize);
+    if (!points) {
+        perror (__func__);
+        return 0;
+    }
+    batch->points = points;
+    batch->size = newsize;
+    return 1;
+}
+
+/* Free the memory used by a batch */
+void free_points (struct PointBatch *batch)
+{
+    free (batch->points);
+    batch->points = NULL;
+    batch->count = 0;
+    batch->size = 0;
+}
+
+/* Convert a map_rgba color to a screen pixel value and alpha */
+static inline Uint32 point_pixel (Uint32 color, Uint8 *alpha)
+{
+#if HAVE_LIBSDL_GFX
+    SDL_PixelFormat *f = screen->format;
+    *alpha = color & 0xff;
+    return ((color >> 24) & 0xff) << f->Rshift |
+        ((color >> 16) & 0xff) << f->Gshift |
+        ((color >> 8) & 0xff) << f->Bshift;
+#else
+    *alpha = 0xff;
+    return color;
+#endif
+}
+
+/* Blend a single color channel */
+static inline Uint32 blend_channel (Uint32 dst, Uint32 src, Uint8 a,
+        Uint32 mask, Uint8 shift)
+{
+    Uint32 d = (dst & mask) >> shift, s = (src & mask) >> shift;
+    return ((s * a + d * (255 - a)) / 255) << shift;
+}
+
+/* Draw all points on the active player viewports and empty the batch */
+/* The screen is 32 bits deep, so pixels are written directly */
+void draw_points (struct PointBatch *batch)
+{
+    SDL_PixelFormat *f = screen->format;
+    int pitch = screen->pitch / 4;
+    int p, i;
+
+    for (p = 0; p < 4; p++) {
+        unsigned int w, h;
+        int left, top;
+        Uint32 *origin;
+        if (players[p].state!=ALIVE && players[p].state!=DEAD)
+            continue;
+        left = cam_rects[p].x;
+        top = cam_rects[p].y;
+        w = cam_rects[p].w;
+        h = cam_rects[p].h;
+        origin = (Uint32 *) screen->pixels + viewport_rects[p].y * pitch +
+            viewport_rects[p].x;
+        for (i = 0; i < batch->count; i++) {
+            /* Negative coordinates wrap around and get clipped too */
+            unsigned int x = batch->points[i].x - left;
+            unsigned int y = batch->points[i].y - top;
+            Uint32 *pixel, color;
+            Uint8 alpha;
+            if (x >= w || y >= h)
+                continue;
+            pixel = origin + y * pitch + x;
+            color = point_pixel (batch->points[i].color, &alpha);
+            if (alpha == 0xff)
+                *pixel = color;
+            else if (alpha)
+                *pixel = blend_channel (*pixel, color, alpha, f->Rmask,
+                        f->Rshift) | blend_channel (*pixel, color, alpha,
+                        f->Gmask, f->Gshift) | blend_channel (*pixel, color,
+                        alpha, f->Bmask, f->Bshift);
+        }
+    }
+    batch->count = 0;
+}
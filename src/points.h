@@ -0,0 +1,64 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2001-2006 Calle Laakkonen
+ *
+ * File        : points.h
+ * Description : Batched single pixel drawing
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef POINTS_H
+#define POINTS_H
+
+#include "SDL.h"
+
+/* A single pixel point in level coordinates */
+struct Point {
+    int x, y;
+    Uint32 color;   /* In map_rgba format */
+};
+
+/* A batch of points that are drawn together */
+struct PointBatch {
+    struct Point *points;
+    int count;
+    int size;
+};
+
+/* Grow the batch. Returns nonzero on success */
+extern int grow_points (struct PointBatch *batch);
+
+/* Add a point to the batch */
+static inline void add_point (struct PointBatch *batch, int x, int y,
+        Uint32 color)
+{
+    if (batch->count == batch->size && grow_points (batch) == 0)
+        return;
+    batch->points[batch->count].x = x;
+    batch->points[batch->count].y = y;
+    batch->points[batch->count].color = color;
+    batch->count++;
+}
+
+/* Draw all points on the active player viewports and empty the batch. */
+/* Translucent points are blended with the background */
+extern void draw_points (struct PointBatch *batch);
+
+/* Free the memory used by a batch */
+extern void free_points (struct PointBatch *batch);
+
+#endif
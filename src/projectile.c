@@ -22,10 +22,14 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
 #include <math.h>
 
 #include "defines.h" /* Round */
 #include "projectile.h"
+#include "bullet.h"
+#include "points.h"
 #include "console.h"
 #include "player.h"
 #include "level.h"
@@ -38,37 +42,229 @@
 /* How soon an explosion sends out shrapnel */
 #define EXPLOSION_CLUSTER_SPEED 5
 
+/* Owner index hash table size */
+#define PROJ_OWNER_BUCKETS 16
+
 struct Explosion {
     int x,y,frame,terrain;
 };
 
 struct dllist *projectile_list,*last_projectile;
+struct ProjectileQueueStats projectile_queue_stats;
+
+/* The projectile list is not changed while it is being walked. New */
+/* projectiles are queued and dead ones are left in place with zero */
+/* life, and flush_projectiles applies both at the sync points. */
+static struct Projectile **spawn_queue;
+static int spawn_queue_len, spawn_queue_size;
+static int dead_projectiles;
+
+/* Tracked projectiles are kept in per-kind lists for each index cell */
+/* and in lists hashed by the ship that fired them */
+struct ProjectileCell {
+    int count;
+    struct Projectile *head;
+};
+static struct ProjectileCell *proj_cells[PROJ_KINDS];
+static struct Projectile *proj_owners[PROJ_KINDS][PROJ_OWNER_BUCKETS];
+static int proj_cells_w, proj_cells_h;
 static struct dllist *explosions;
 static SDL_Surface **explosion_gfx;
 static int explosion_frames;
+static struct PointBatch projectile_points;
 
 /* Load projectile related datafiles */
 extern void init_projectiles(LDAT *explosionfile) {
     explosion_gfx = load_image_array(explosionfile,0,T_ALPHA,"EXPL",&explosion_frames);
 }
 
+/* Find the index cell for a position */
+static int projectile_cell(double x, double y) {
+    int cx = (int)x >> PROJ_CELL_SHIFT;
+    int cy = (int)y >> PROJ_CELL_SHIFT;
+    if(cx<0) cx=0;
+    else if(cx>=proj_cells_w) cx=proj_cells_w-1;
+    if(cy<0) cy=0;
+    else if(cy>=proj_cells_h) cy=proj_cells_h-1;
+    return cy * proj_cells_w + cx;
+}
+
+static inline int owner_bucket(struct Ship *src) {
+    return ((unsigned long)src >> 4) % PROJ_OWNER_BUCKETS;
+}
+
+/* Add a projectile to the indices */
+static void index_projectile(struct Projectile *p) {
+    struct ProjectileCell *cell;
+    struct Projectile **owner;
+    p->cell = -1;
+    if(p->kind == PROJ_UNTRACKED || proj_cells[p->kind]==NULL)
+        return;
+    p->cell = projectile_cell(p->physics.x, p->physics.y);
+    cell = &proj_cells[p->kind][p->cell];
+    p->cellprev = NULL;
+    p->cellnext = cell->head;
+    if(cell->head) cell->head->cellprev = p;
+    cell->head = p;
+    cell->count++;
+
+    owner = &proj_owners[p->kind][owner_bucket(p->src)];
+    p->ownerprev = NULL;
+    p->ownernext = *owner;
+    if(*owner) (*owner)->ownerprev = p;
+    *owner = p;
+}
+
+/* Remove a projectile from its index cell */
+static void unlink_cell(struct Projectile *p) {
+    struct ProjectileCell *cell = &proj_cells[p->kind][p->cell];
+    if(p->cellprev) p->cellprev->cellnext = p->cellnext;
+    else cell->head = p->cellnext;
+    if(p->cellnext) p->cellnext->cellprev = p->cellprev;
+    cell->count--;
+}
+
+/* Remove a projectile from the indices */
+static void unindex_projectile(struct Projectile *p) {
+    if(p->cell<0)
+        return;
+    unlink_cell(p);
+    if(p->ownerprev) p->ownerprev->ownernext = p->ownernext;
+    else proj_owners[p->kind][owner_bucket(p->src)] = p->ownernext;
+    if(p->ownernext) p->ownernext->ownerprev = p->ownerprev;
+    p->cell = -1;
+}
+
+/* Move a projectile to another index cell if it has left its old one */
+static inline void reindex_projectile(struct Projectile *p) {
+    int c;
+    if(p->cell<0)
+        return;
+    c = projectile_cell(p->physics.x, p->physics.y);
+    if(c != p->cell) {
+        struct ProjectileCell *cell = &proj_cells[p->kind][c];
+        unlink_cell(p);
+        p->cell = c;
+        p->cellprev = NULL;
+        p->cellnext = cell->head;
+        if(cell->head) cell->head->cellprev = p;
+        cell->head = p;
+        cell->count++;
+    }
+}
+
+/* Count the projectiles of a kind around x,y */
+int count_projectiles_near(int kind, double x, double y) {
+    int c, cx, cy, dx, dy, count=0;
+    if(proj_cells[kind]==NULL)
+        return 0;
+    c = projectile_cell(x,y);
+    cx = c % proj_cells_w;
+    cy = c / proj_cells_w;
+    for(dy=cy-1;dy<=cy+1;dy++) {
+        if(dy<0 || dy>=proj_cells_h) continue;
+        for(dx=cx-1;dx<=cx+1;dx++) {
+            if(dx<0 || dx>=proj_cells_w) continue;
+            count += proj_cells[kind][dy*proj_cells_w+dx].count;
+        }
+    }
+    return count;
+}
+
+/* Visit the projectiles of a kind around x,y */
+void visit_projectiles_near(int kind, double x, double y,
+        int (*func)(struct Projectile *p, void *arg), void *arg)
+{
+    int c, cx, cy, dx, dy;
+    if(proj_cells[kind]==NULL)
+        return;
+    c = projectile_cell(x,y);
+    cx = c % proj_cells_w;
+    cy = c / proj_cells_w;
+    for(dy=cy-1;dy<=cy+1;dy++) {
+        if(dy<0 || dy>=proj_cells_h) continue;
+        for(dx=cx-1;dx<=cx+1;dx++) {
+            struct Projectile *p;
+            if(dx<0 || dx>=proj_cells_w) continue;
+            p = proj_cells[kind][dy*proj_cells_w+dx].head;
+            while(p) {
+                struct Projectile *next = p->cellnext;
+                if(func(p,arg))
+                    return;
+                p = next;
+            }
+        }
+    }
+}
+
+/* Get the projectiles of a kind fired by a ship */
+struct Projectile *first_owned_projectile(int kind, struct Ship *src) {
+    struct Projectile *p = proj_owners[kind][owner_bucket(src)];
+    while(p && p->src != src)
+        p = p->ownernext;
+    return p;
+}
+
+struct Projectile *next_owned_projectile(struct Projectile *p) {
+    struct Ship *src = p->src;
+    p = p->ownernext;
+    while(p && p->src != src)
+        p = p->ownernext;
+    return p;
+}
+
 /* Clear all projectiles */
 void clear_projectiles(void) {
+    int r;
     dllist_free(projectile_list,free);
     projectile_list=NULL;
     last_projectile = NULL;
+    for(r=0;r<spawn_queue_len;r++)
+        free(spawn_queue[r]);
+    spawn_queue_len = 0;
+    dead_projectiles = 0;
+    memset(&projectile_queue_stats,0,sizeof(struct ProjectileQueueStats));
+
+    /* Size the index for the current level */
+    proj_cells_w = (lev_level.width >> PROJ_CELL_SHIFT) + 1;
+    proj_cells_h = (lev_level.height >> PROJ_CELL_SHIFT) + 1;
+    for(r=1;r<PROJ_KINDS;r++) {
+        free(proj_cells[r]);
+        proj_cells[r] = calloc(proj_cells_w*proj_cells_h,
+                sizeof(struct ProjectileCell));
+        if(!proj_cells[r]) {
+            perror("clear_projectiles");
+            exit(1);
+        }
+    }
+    memset(proj_owners,0,sizeof(proj_owners));
     dllist_free(explosions,free);
     explosions=NULL;
 }
 
-/* Add a new projectile */
+/* Queue a new projectile */
 void add_projectile(struct Projectile *p) {
-    last_projectile=dllist_append(last_projectile,p);
-    if(!projectile_list) projectile_list=last_projectile;
+    if(spawn_queue_len == spawn_queue_size) {
+        spawn_queue_size = spawn_queue_size ? spawn_queue_size * 2 : 64;
+        spawn_queue = realloc(spawn_queue,
+                spawn_queue_size * sizeof(struct Projectile*));
+        if(!spawn_queue) {
+            perror("add_projectile");
+            exit(1);
+        }
+    }
+    spawn_queue[spawn_queue_len++] = p;
+    if(spawn_queue_len > projectile_queue_stats.maxdepth)
+        projectile_queue_stats.maxdepth = spawn_queue_len;
 }
 
 /* Add an explosion animation and make a hole */
 void add_explosion(int x,int y) {
+    add_big_explosion(x,y,HOLE_RADIUS);
+}
+
+/* Add an explosion animation and make a crater */
+void add_big_explosion(int x,int y,int radius) {
     if(x<0 || y<0 || x>=lev_level.width || y>=lev_level.height)
         return;
     playwave_3d (WAV_EXPLOSION, x, y);
@@ -83,7 +279,7 @@ void add_explosion(int x,int y) {
         explosions = dllist_prepend(explosions,e);
     }
 
-    make_hole(x,y);
+    make_crater(x,y,radius);
 }
 
 /* Remove a projectile. Returns the next one in the list */
@@ -93,7 +289,9 @@ static struct dllist *remove_projectile(struct dllist *lst) {
     if(((struct Projectile*)lst->data)->destroy)
         ((struct Projectile*)lst->data)->destroy(lst->data);
 
+    unindex_projectile(lst->data);
     free(lst->data);
+    projectile_queue_stats.removed++;
     if(lst==last_projectile) last_projectile=last_projectile->prev;
     if(lst==projectile_list)
         projectile_list=dllist_remove(lst);
@@ -102,9 +300,46 @@ static struct dllist *remove_projectile(struct dllist *lst) {
     return next;
 }
 
+/* Apply the queued changes to the projectile list */
+void flush_projectiles(void) {
+    Uint64 start;
+    int r;
+    if(spawn_queue_len==0 && dead_projectiles==0)
+        return;
+    start = get_time_us();
+
+    /* Remove dead projectiles. Destructors may queue new ones */
+    if(dead_projectiles) {
+        struct dllist *ptr = projectile_list;
+        while(ptr) {
+            if(((struct Projectile*)ptr->data)->life==0)
+                ptr = remove_projectile(ptr);
+            else
+                ptr = ptr->next;
+        }
+        dead_projectiles = 0;
+    }
+
+    /* Add the queued ones */
+    for(r=0;r<spawn_queue_len;r++) {
+        index_projectile(spawn_queue[r]);
+        last_projectile=dllist_append(last_projectile,spawn_queue[r]);
+        if(!projectile_list) projectile_list=last_projectile;
+    }
+    projectile_queue_stats.spawned += spawn_queue_len;
+    spawn_queue_len = 0;
+
+    projectile_queue_stats.flushes++;
+    projectile_queue_stats.flushtime += get_time_us() - start;
+}
+
 /* Projectile drawing framework */
 static void projectile_draw(struct Projectile *p) {
-    if(p->draw) {
+    if(p->draw == draw_simple_projectile && p->cloak==0) {
+        /* Simple projectiles are drawn all at once */
+        add_point(&projectile_points, Round(p->physics.x),
+                Round(p->physics.y), p->color);
+    } else if(p->draw) {
         int ix = Round(p->physics.x);
         int iy = Round(p->physics.y);
         int plr;
@@ -188,6 +423,13 @@ void animate_projectiles(void) {
         int ccount=1;
         struct Projectile *p = ptr->data;
 
+        /* Killed by something else since the last sync point */
+        if(p->life==0) {
+            dead_projectiles++;
+            ptr=ptr->next;
+            continue;
+        }
+
         /* Counters */
         if(p->life > 0) p->life--;
         if(p->timer> 0) p->timer--;
@@ -215,6 +457,7 @@ void animate_projectiles(void) {
         }
 
         animate_object(&p->physics,ccount,clist);
+        reindex_projectile(p);
 
         /* Terrain collisions */
         if(p->physics.hitground || (p->hydrophobic && p->physics.underwater)) {
@@ -253,6 +496,8 @@ void animate_projectiles(void) {
                     if(hp->explode)
                         hp->explode(p);
                     hp->life=0;
+                    hp->physics.obj=0;
+                    dead_projectiles++;
                 }
             }
         }
@@ -260,12 +505,15 @@ void animate_projectiles(void) {
         /* Draw the projectile */
         projectile_draw(p);
 
-        /* Delete expired projectile and move on */
-        if(p->life==0)
-            ptr = remove_projectile(ptr);
-        else
-            ptr=ptr->next;
+        /* Expired projectiles are removed at the next sync point. */
+        /* Until then, nothing can hit them */
+        if(p->life==0) {
+            p->physics.obj=0;
+            dead_projectiles++;
+        }
+        ptr=ptr->next;
     }
+    draw_points(&projectile_points);
 
     animate_explosions();
 }
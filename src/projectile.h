@@ -30,6 +30,16 @@
 
 struct Ship;
 
+/* Kinds of projectiles kept in the spatial and owner indices */
+#define PROJ_UNTRACKED  0
+#define PROJ_DIVMINE    1
+#define PROJ_LANDMINE   2
+#define PROJ_KINDS      3
+
+/* The spatial index divides the level into squares of this size */
+#define PROJ_CELL_SHIFT 6
+#define PROJ_CELL       (1<<PROJ_CELL_SHIFT)
+
 struct Projectile { /* inherits Physics */
     struct Physics physics;
     
@@ -54,6 +64,12 @@ struct Projectile { /* inherits Physics */
     int hydrophobic;        /* Explode when touch water */
     int otherobj;           /* Collide with other projectiles */
     int critter;            /* Collide with critters and pilots */
+    int kind;               /* Index this projectile under this kind */
+
+    /* Index links, managed by projectile.c */
+    int cell;
+    struct Projectile *cellnext, *cellprev;
+    struct Projectile *ownernext, *ownerprev;
 
     /* Methods */
     void (*draw)(struct Projectile *p,int x,int y, SDL_Rect viewport);
@@ -74,17 +90,49 @@ extern void clear_projectiles(void);
 /* Set time until projectile becomes active */
 extern void set_fuse(struct Projectile *p, int ticks);
 
-/* Add a new projectile to list */
+/* Spawn queue counters */
+struct ProjectileQueueStats {
+    unsigned long spawned;  /* Projectiles moved from the queue to the list */
+    unsigned long removed;  /* Dead projectiles removed from the list */
+    unsigned long flushes;  /* Sync points that had something to do */
+    int maxdepth;           /* Longest the spawn queue has been */
+    Uint64 flushtime;       /* Time spent flushing in microseconds */
+};
+
+/* Queue a new projectile. It is added to the list at the next sync point */
 extern void add_projectile(struct Projectile *p);
 
+/* Add the queued projectiles to the list and remove the dead ones */
+extern void flush_projectiles(void);
+
 /* Add a new explosion to list */
 extern void add_explosion(int x,int y);
 
+/* Add an explosion that blasts a crater of the given radius */
+extern void add_big_explosion(int x,int y,int radius);
+
 /* Animate and draw all projectiles */
 extern void animate_projectiles(void);
 
+/* Count the projectiles of a kind in the 3x3 block of index cells */
+/* around x,y */
+extern int count_projectiles_near(int kind, double x, double y);
+
+/* Call func for each projectile of a kind in the 3x3 block of index */
+/* cells around x,y, until it returns nonzero */
+extern void visit_projectiles_near(int kind, double x, double y,
+        int (*func)(struct Projectile *p, void *arg), void *arg);
+
+/* Get the projectiles of a kind fired by a ship. Returns NULL when */
+/* there are no more */
+extern struct Projectile *first_owned_projectile(int kind, struct Ship *src);
+extern struct Projectile *next_owned_projectile(struct Projectile *p);
+
 /* List of projectiles. Look, don't touch please */
 extern struct dllist *projectile_list,*last_projectile;
 
+/* Spawn queue counters for the current round */
+extern struct ProjectileQueueStats projectile_queue_stats;
+
 #endif
 
@@ -37,6 +37,7 @@
 #include "weapon.h"
 #include "demo.h"
 #include "audio.h"
+#include "level.h"
 
 #define HEADER_HEIGHT 90
 #define THUMBNAIL_HEIGHT 120
@@ -48,6 +49,7 @@ struct LevelThumbnail {
     struct LevelFile *file;
     SDL_Surface *name;
     SDL_Surface *thumbnail;
+    int loaded;                 /* Thumbnails are loaded when first shown */
 };
 
 static SDL_Surface *trophy_gfx[4];
@@ -91,14 +93,9 @@ static struct dllist *get_level_thumbnails(void) {
         struct LevelThumbnail *level = malloc(sizeof(struct LevelThumbnail));
 
         level->file = levels->data;
-        level->name = renderstring(Smallfont,
-                level->file->settings->mainblock.name, font_color_cyan);
-        level->thumbnail = level->file->settings->thumbnail;
-
-        if(level->thumbnail && level->thumbnail->h != THUMBNAIL_HEIGHT) {
-            fprintf(stderr,"Level \"%s\" thumbnail height is not 120 (%d)!\n",
-                    level->file->settings->mainblock.name,level->thumbnail->h);
-        }
+        level->name = NULL;
+        level->thumbnail = NULL;
+        level->loaded = 0;
 
         thumbnails = dllist_append(thumbnails,level);
         levels=levels->next;
@@ -107,10 +104,27 @@ static struct dllist *get_level_thumbnails(void) {
     return thumbnails;
 }
 
+/* Load the thumbnail and render the name of a level */
+static void load_thumbnail(struct LevelThumbnail *level) {
+    if(level->loaded)
+        return;
+    level->loaded = 1;
+    level->name = renderstring(Smallfont,level->file->name,font_color_cyan);
+    level->thumbnail = load_level_thumbnail(level->file);
+
+    if(level->thumbnail && level->thumbnail->h != THUMBNAIL_HEIGHT) {
+        fprintf(stderr,"Level \"%s\" thumbnail height is not 120 (%d)!\n",
+                level->file->name,level->thumbnail->h);
+    }
+}
+
 /* Free a level thumbnail */
 static void free_level_thumbnail(void *data) {
     struct LevelThumbnail *l = data;
-    SDL_FreeSurface(l->name);
+    if(l->name)
+        SDL_FreeSurface(l->name);
+    if(l->thumbnail)
+        SDL_FreeSurface(l->thumbnail);
     free(l);
 }
 
@@ -124,6 +138,7 @@ static int draw_level(SDL_Surface *surface, struct LevelThumbnail *level,
     int thwidth;
     SDL_Rect rect;
     Uint8 alpha;
+    load_thumbnail(level);
     rect.x = x;
     rect.y = y;
     if(level->thumbnail) {
@@ -162,6 +177,7 @@ static int draw_level(SDL_Surface *surface, struct LevelThumbnail *level,
 
 /* Return the width of the level thumbnail */
 static int level_width(struct LevelThumbnail *level) {
+    load_thumbnail(level);
     if(level->thumbnail)
         return level->thumbnail->w;
     else
@@ -219,7 +235,7 @@ static struct dllist *randomize_level(struct dllist *levels) {
 
 /* Level selection screen. Returns the selected level or NULL if cancelled */
 struct LevelFile *select_level(int fade) {
-    struct dllist *levels;
+    struct dllist *levels, *prefetched=NULL;
     struct LevelFile *selection=NULL;
     SDL_Event event;
     int loop=1,animate=0;
@@ -241,12 +257,17 @@ struct LevelFile *select_level(int fade) {
         memset(screen->pixels,0,screen->pitch*screen->h);
         draw_header(screen,roundstr);
         draw_level_bar(screen,levels,0);
-        SDL_UpdateRect(screen,0,0,0,0);
+        update_screen_rect(0,0,0,0);
     }
 
     /* Level selection event loop */
     while(loop) {
         enum {DO_NOTHING,MOVE_LEFT,MOVE_RIGHT,CHOOSE,CANCEL} cmd = DO_NOTHING;
+        /* Start loading the highlighted level while the player decides */
+        if(animate==0 && levels!=prefetched) {
+            prefetch_level(((struct LevelThumbnail*)levels->data)->file);
+            prefetched=levels;
+        }
         if(animate) {
             if(SDL_PollEvent(&event)==0)
                 event.type = SDL_NOEVENT;
@@ -320,7 +341,7 @@ struct LevelFile *select_level(int fade) {
                     animate -= delta;
             }
             draw_level_bar(screen,levels,animate);
-            SDL_UpdateRect(screen,0,screen->h/2 - BAR_HEIGHT/2,
+            update_screen_rect(0,screen->h/2 - BAR_HEIGHT/2,
                     screen->w,BAR_HEIGHT);
         }
 
@@ -390,12 +411,12 @@ int select_weapon(struct LevelFile *level) {
 
     int i;
     memset(screen->pixels,0,screen->pitch*screen->h);
-    draw_header(screen,level->settings->mainblock.name);
+    draw_header(screen,level->name);
     for(i=0;i<4;i++)
         if(players[i].state != INACTIVE)
             draw_weapon_bar(screen,i);
 
-    SDL_UpdateRect(screen,0,0,0,0);
+    update_screen_rect(0,0,0,0);
 
     while(1) {
         SDL_Event event;
@@ -446,7 +467,7 @@ int select_weapon(struct LevelFile *level) {
                         players[i].standardWeapon = 0;
 
                     rect = draw_weapon_bar(screen,i);
-                    SDL_UpdateRect(screen,rect.x,rect.y,rect.w,rect.h);
+                    update_screen_rect(rect.x,rect.y,rect.w,rect.h);
                 }
             }
         } else if(event.type == SDL_JOYBUTTONDOWN)
@@ -40,11 +40,15 @@
 #include "levelfile.h"
 #include "ship.h"
 #include "weapon.h"
+#include "startup.h"
+#include "spritecache.h"
 
 #define SHIP_POSES      36
 #define SHIP_WHITE_DUR	(0.13*GAME_SPEED)   /* After receiving damage, for how long the ship appears white */
 #define THRUST          (80.0/GAME_SPEED)
 #define DAMAGE_TRESHOLD 3.0 /* Treshold velocity for collision damage */
+#define TINT_VARIANT    16  /* Image cache variants of the tinted graphics */
+#define GHOST_VARIANT   7   /* Ghost ships follow the 7 normal colors in the sprite cache */
 
 
 /* Exported globals */
@@ -54,6 +58,7 @@ struct dllist *ship_list;
 static SDL_Surface *ship_gfx[7][SHIP_POSES]; /* 0=grey, 1-4=coloured, 5 = white, 6 =  frozen */
 static SDL_Surface *ghost_gfx[4][SHIP_POSES];
 static SDL_Surface *shield_gfx[4];      /* 0-3 coloured */
+static struct SpriteCache *ship_cache; /* ship_gfx and ghost_gfx pre-rotated */
 static SDL_Surface **remocon_gfx;
 static int remocon_frames;
 
@@ -65,10 +70,15 @@ static void ship_specials (struct Ship * ship);
 void init_ships (LDAT *playerfile) {
     SDL_Surface *tmpsurface;
     int r, p;
-    /* Load ship graphics */
+    /* Load ship graphics. The tinted versions are kept in the image cache */
     for (p = 0; p < SHIP_POSES; p++) {
-        tmpsurface = load_image_ldat (playerfile, 0, T_ALPHA,"VWING",p);
+        tmpsurface = NULL;
         for (r = 0; r < 7; r++) {
+            ship_gfx[r][p] = get_cached_image ("VWING", p, TINT_VARIANT + r);
+            if (ship_gfx[r][p])
+                continue;
+            if (tmpsurface == NULL)
+                tmpsurface = load_image_ldat (playerfile, 0, T_ALPHA,"VWING",p);
             ship_gfx[r][p] = copy_surface(tmpsurface);
             switch (r) {
             case Grey:
@@ -92,19 +102,31 @@ void init_ships (LDAT *playerfile) {
                 recolor (ship_gfx[r][p], 1, 1, 0.4, 1);
                 break;
             }
+            cache_image ("VWING", p, TINT_VARIANT + r, ship_gfx[r][p]);
         }
-        SDL_FreeSurface(tmpsurface);
+        if (tmpsurface)
+            SDL_FreeSurface(tmpsurface);
     }
     /* Create ghost ship graphics */
     for (r = 0; r < 4; r++) {
         for (p = 0; p < SHIP_POSES; p++) {
+            ghost_gfx[r][p] = get_cached_image ("VWING", p,
+                    TINT_VARIANT + 7 + r);
+            if (ghost_gfx[r][p])
+                continue;
             ghost_gfx[r][p] = copy_surface (ship_gfx[r + 1][p]);
             recolor (ghost_gfx[r][p], 1.0, 1.0, 1.0, 0.5);
+            cache_image ("VWING", p, TINT_VARIANT + 7 + r, ghost_gfx[r][p]);
         }
     }
     /* Load Shield graphics */
-    tmpsurface = load_image_ldat (playerfile, 0, T_ALPHA, "SHIELD", 0);
+    tmpsurface = NULL;
     for (r = 0; r < 4; r++) {
+        shield_gfx[r] = get_cached_image ("SHIELD", 0, TINT_VARIANT + r);
+        if (shield_gfx[r])
+            continue;
+        if (tmpsurface == NULL)
+            tmpsurface = load_image_ldat (playerfile, 0, T_ALPHA, "SHIELD", 0);
         shield_gfx[r] = copy_surface (tmpsurface);
         switch (r + Red) {
         case Red:
@@ -123,11 +145,29 @@ void init_ships (LDAT *playerfile) {
             fputs("Unhandled shield color in init_ships()\n",stderr);
             exit(1);
         }
+        cache_image ("SHIELD", 0, TINT_VARIANT + r, shield_gfx[r]);
     }
-    SDL_FreeSurface(tmpsurface);
+    if (tmpsurface)
+        SDL_FreeSurface(tmpsurface);
     /* Load Remote Control graphics */
     remocon_gfx =
         load_image_array (playerfile, 0, T_ALPHA, "XMIT", &remocon_frames);
+    /* Pre-rotate the ships. If they don't fit, the poses are used as is */
+    if (luola_options.rotations > SHIP_POSES) {
+        ship_cache = new_sprite_cache ("ships", GHOST_VARIANT + 4,
+                luola_options.rotations, ship_gfx[Grey][0]);
+        for (r = 0; r < GHOST_VARIANT + 4; r++) {
+            if (!bake_sprite_variant (ship_cache, r, r < GHOST_VARIANT ?
+                        ship_gfx[r] : ghost_gfx[r - GHOST_VARIANT],
+                        SHIP_POSES)) {
+                fprintf (stderr, "Not enough memory for %d ship rotations\n",
+                        luola_options.rotations);
+                free_sprite_cache (ship_cache);
+                ship_cache = NULL;
+                break;
+            }
+        }
+    }
 }
 
 /* Remove ships */
@@ -220,7 +260,7 @@ void draw_ships (void)
 {
     struct dllist *current=ship_list;
     SDL_Rect rect, rect2;
-    int plr, pose;
+    int plr, pose, variant;
     struct Ship *ship;
     while (current) {
         ship = current->data;
@@ -256,14 +296,26 @@ void draw_ships (void)
                     if (pose > 35)
                         pose = 35;
                     if (ship->state!=INTACT)
-                        surf = ship_gfx[Grey][pose];
+                        variant = Grey;
                     else if (ship->frozen)
-                        surf = ship_gfx[Frozen][pose];
+                        variant = Frozen;
                     else if (ship->white_ship)
-                        surf = ship_gfx[White][pose];
+                        variant = White;
+                    else if (ship->ship == ship_gfx[ship->color])
+                        variant = ship->color;
                     else
-                        surf = ship->ship[pose];
-                    SDL_BlitSurface (surf, &rect2, screen, &rect);
+                        variant = GHOST_VARIANT + ship->color - Red;
+                    if (ship_cache) {
+                        const struct AtlasFrame *frame =
+                            sprite_frame (ship_cache, variant, ship->angle);
+                        rect2.x += frame->rect.x;
+                        rect2.y += frame->rect.y;
+                        SDL_BlitSurface (frame->page, &rect2, screen, &rect);
+                    } else {
+                        surf = variant < GHOST_VARIANT ?
+                            ship_gfx[variant][pose] : ship->ship[pose];
+                        SDL_BlitSurface (surf, &rect2, screen, &rect);
+                    }
                     if (ship->shieldup) {
                         SDL_Rect sr, tr;
                         tr.x =
@@ -38,6 +38,8 @@
 #include "special.h"
 #include "ship.h"
 #include "audio.h"
+#include "startup.h"
+#include "spritecache.h"
 
 /* List of special objects */
 static struct dllist *special_list;
@@ -47,6 +49,7 @@ static SDL_Surface **jumpgate_gfx;
 static int jumpgate_frames;
 static SDL_Surface **turret_gfx[2]; /* Normal and missile turrets */
 static int turret_frames[2];
+static struct SpriteCache *turret_cache; /* Normal turret pre-rotated */
 static SDL_Surface **jumppoint_gfx[2]; /* Entry and exit points */
 static int jumppoint_frames[2];
 
@@ -98,6 +101,20 @@ void init_specials (LDAT *specialfile) {
     turret_gfx[1] = load_image_array(specialfile, 0, T_ALPHA, "SAMSITE",
             &turret_frames[1]);
 
+    /* The last turret frame is the same as the first one. The missile */
+    /* turret is a sweep animation and is not rotated */
+    if(luola_options.rotations > turret_frames[0]-1) {
+        turret_cache = new_sprite_cache("turrets", 1, luola_options.rotations,
+                turret_gfx[0][0]);
+        if(!bake_sprite_variant(turret_cache, 0, turret_gfx[0],
+                    turret_frames[0]-1)) {
+            fprintf(stderr,"Not enough memory for %d turret rotations\n",
+                    luola_options.rotations);
+            free_sprite_cache(turret_cache);
+            turret_cache = NULL;
+        }
+    }
+
     jumpgate_gfx = load_image_array (specialfile, 0, T_ALPHA, "JUMPGATE",
             &jumpgate_frames);
 }
@@ -552,8 +569,16 @@ static void draw_special (struct SpecialObj *object)
                     rect.x = viewport_rects[p].x;
                 if (rect.y < viewport_rects[p].y)
                     rect.y = viewport_rects[p].y;
-                SDL_BlitSurface (object->gfx[object->frame], &rect2, screen,
-                                 &rect);
+                if (turret_cache && object->gfx == turret_gfx[0]) {
+                    const struct AtlasFrame *frame =
+                        sprite_frame (turret_cache, 0, object->angle);
+                    rect2.x += frame->rect.x;
+                    rect2.y += frame->rect.y;
+                    SDL_BlitSurface (frame->page, &rect2, screen, &rect);
+                } else {
+                    SDL_BlitSurface (object->gfx[object->frame], &rect2, screen,
+                                     &rect);
+                }
             }
         }
     }
@@ -21,17 +21,32 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 
 #include "defines.h" /* For Round() */
 #include "console.h"
+#include "level.h"
 #include "spring.h"
 
+#define SPRING_ITERATIONS 4     /* Default solver iterations per frame */
+#define MAX_SPRING_NODES  64
+#define SPRING_DAMPING    0.98  /* Node velocity kept over a frame */
+#define SPRING_TOLERANCE  0.5   /* Stretch in pixels small enough to stop */
+                                /* iterating the solver early. Less than */
+                                /* half a pixel doesn't show on screen. */
+
 /* Create a new spring */
 struct Spring *create_spring(struct Physics *head,float nodelen, int nodecount)
 {
-    struct Spring *spring = malloc(sizeof(struct Spring));
+    struct Spring *spring;
+    if(nodecount > MAX_SPRING_NODES) {
+        fprintf(stderr,"create_spring: %d nodes requested, at most %d supported\n",
+                nodecount,MAX_SPRING_NODES);
+        return NULL;
+    }
+    spring = malloc(sizeof(struct Spring));
     if(!spring) {
         perror("create_spring");
         return NULL;
@@ -41,7 +56,8 @@ struct Spring *create_spring(struct Physics *head,float nodelen, int nodecount)
     spring->tail = malloc(sizeof(struct Physics));
     init_physobj(spring->tail,head->x,head->y,makeVector(0,0));
 
-    spring->sc = -0.6;
+    spring->iterations = SPRING_ITERATIONS;
+    spring->stiffness = 1.0;
     spring->color = col_rope;
 
     spring->nodelen = nodelen;
@@ -70,39 +86,153 @@ void free_spring(struct Spring *spring) {
     free(spring);
 }
 
-/* Animate spring segment */
-static void animate_segment(struct Spring *spring,struct Physics *s1, struct Physics *s2) {
-    Vector springvec = makeVector(s1->x - s2->x, s1->y - s2->y);
-    double dist = hypot(springvec.x,springvec.y);
-    if(dist>0) {
-        Vector force = multVector(springvec,1/dist);
-        Vector friction = {s1->vel.x - s2->vel.x, s1->vel.y - s2->vel.y};
+/* Shorten a stretched segment between points i and i+1 by moving */
+/* them towards each other in proportion to their inverse masses. */
+/* Segments resist stretching, but not compression, like a rope. */
+/* Returns how much the segment was stretched. */
+static inline double solve_segment(const struct Spring *spring,
+        double *x, double *y, const double *w, int i)
+{
+    double dx = x[i+1] - x[i];
+    double dy = y[i+1] - y[i];
+    double dist2 = dx*dx + dy*dy;
+    double dist, stretch, corr;
+    if(dist2 <= spring->nodelen * spring->nodelen || w[i] + w[i+1] == 0)
+        return 0;
+    dist = sqrt(dist2);
+    stretch = dist - spring->nodelen;
+    corr = stretch / dist * spring->stiffness / (w[i] + w[i+1]);
+    dx *= corr;
+    dy *= corr;
+    x[i] += dx * w[i];
+    y[i] += dy * w[i];
+    x[i+1] -= dx * w[i+1];
+    y[i+1] -= dy * w[i+1];
+    return stretch;
+}
 
-        force = multVector(force,(dist - spring->nodelen)*spring->sc);
-        friction = multVector(friction, -0.1); /* Something wrong with this */
-        force = addVectors(force,friction);
+/* Pull every point back within reach of an anchored end point. */
+/* A point can be no further from the anchor than the rope between */
+/* them is long. This removes the stretch that the segment sweeps */
+/* would need many iterations to propagate along a long rope. */
+static void tether_points(const struct Spring *spring,
+        double *x, double *y, int anchor)
+{
+    int i;
+    for(i=0;i<anchor;i++) {
+        double maxlen = (anchor - i) * spring->nodelen;
+        double dx = x[i] - x[anchor];
+        double dy = y[i] - y[anchor];
+        double dist2 = dx*dx + dy*dy;
+        if(dist2 > maxlen * maxlen) {
+            double scale = maxlen / sqrt(dist2);
+            x[i] = x[anchor] + dx * scale;
+            y[i] = y[anchor] + dy * scale;
+        }
+    }
+}
 
-        s1->vel = addVectors(s1->vel,multVector(force,1/(s1->mass/s2->mass)));
-        s2->vel = addVectors(s2->vel,multVector(force,1/(-s2->mass/s1->mass)));
+/* Keep the nodes out of solid terrain. Only the pixel under each node */
+/* is checked. A node that ends up in the ground is returned to where */
+/* it was at the start of the frame. */
+static void collide_nodes(struct Spring *spring) {
+    int r;
+    for(r=0;r<spring->nodecount;r++) {
+        struct Physics *node = &spring->nodes[r];
+        if(is_solid(Round(node->x),Round(node->y))) {
+            double oldx = node->x - node->vel.x;
+            double oldy = node->y - node->vel.y;
+            if(is_solid(Round(oldx),Round(oldy))==0) {
+                node->x = oldx;
+                node->y = oldy;
+            }
+            node->vel.x = 0;
+            node->vel.y = 0;
+        }
     }
 }
 
-/* Simulate the spring */
-void animate_spring(struct Spring *spring) {
+/* Simulate a spring for one frame */
+static void animate_spring(struct Spring *spring) {
+    struct Physics *head = spring->head, *tail = spring->tail;
+    struct Physics *nodes = spring->nodes;
+    double x[MAX_SPRING_NODES+2], y[MAX_SPRING_NODES+2];
+    double w[MAX_SPRING_NODES+2];
+    int n = spring->nodecount;
+    int r,i;
 
-    if(spring->nodes) {
-        int r;
-        animate_segment(spring,spring->head,&spring->nodes[0]);
-        for(r=0;r<spring->nodecount-1;r++) {
-            animate_segment(spring,&spring->nodes[r],&spring->nodes[r+1]);
-            animate_object(&spring->nodes[r],0,NULL);
+    /* The tail flies like a projectile and sticks in the ground */
+    animate_object(tail,0,NULL);
+
+    /* Move the nodes freely */
+    for(r=0;r<n;r++) {
+        nodes[r].vel.x *= SPRING_DAMPING;
+        nodes[r].vel.y = nodes[r].vel.y * SPRING_DAMPING + GRAVITY;
+        nodes[r].x += nodes[r].vel.x;
+        nodes[r].y += nodes[r].vel.y;
+    }
+    collide_nodes(spring);
+
+    /* Then satisfy the length constraints. The solver works on */
+    /* a copy of the positions, with the head as the first point */
+    /* and the tail as the last. */
+    x[0] = head->x;
+    y[0] = head->y;
+    w[0] = 1.0 / head->mass;
+    for(r=0;r<n;r++) {
+        x[r+1] = nodes[r].x;
+        y[r+1] = nodes[r].y;
+        w[r+1] = 1.0 / nodes[r].mass;
+    }
+    x[n+1] = tail->x;
+    y[n+1] = tail->y;
+    w[n+1] = tail->hitground ? 0 : 1.0 / tail->mass;
+
+    if(w[n+1]==0)
+        tether_points(spring,x,y,n+1);
+    for(i=0;i<spring->iterations;i++) {
+        double stretch = 0;
+        /* Sweep in alternating directions so corrections travel */
+        /* both ways along long springs */
+        if(i&1) {
+            for(r=n;r>=0;r--) {
+                double s = solve_segment(spring,x,y,w,r);
+                if(s > stretch) stretch = s;
+            }
+        } else {
+            for(r=0;r<=n;r++) {
+                double s = solve_segment(spring,x,y,w,r);
+                if(s > stretch) stretch = s;
+            }
         }
-        animate_segment(spring,&spring->nodes[r],spring->tail);
-        animate_object(&spring->nodes[r],0,NULL);
-    } else {
-        animate_segment(spring,spring->head,spring->tail);
+        /* Stop early once the rope is close enough to its length */
+        if(stretch < SPRING_TOLERANCE)
+            break;
+    }
+
+    /* The nodes keep the motion the constraints gave them. The end */
+    /* objects are moved by their owners who do their own collision */
+    /* detection, so they only get the change in velocity. */
+    head->vel.x += x[0] - head->x;
+    head->vel.y += y[0] - head->y;
+    for(r=0;r<n;r++) {
+        nodes[r].vel.x += x[r+1] - nodes[r].x;
+        nodes[r].vel.y += y[r+1] - nodes[r].y;
+        nodes[r].x = x[r+1];
+        nodes[r].y = y[r+1];
     }
-    animate_object(spring->tail,0,NULL);
+    if(w[n+1]) {
+        tail->vel.x += x[n+1] - tail->x;
+        tail->vel.y += y[n+1] - tail->y;
+    }
+    collide_nodes(spring);
+}
+
+/* Simulate a batch of springs */
+void animate_springs(struct Spring *springs[], int count) {
+    int s;
+    for(s=0;s<count;s++)
+        animate_spring(springs[s]);
 }
 
 /* Draw a spring segment */
@@ -32,19 +32,23 @@ struct Spring {
     struct Physics *nodes;  /* Possible nodes in between */
     int nodecount;          /* Number of nodes */
 
-    float sc;               /* Spring constant */
+    int iterations;         /* Constraint solver iterations per frame */
+    float stiffness;        /* How much of the stretch is removed per */
+                            /* iteration (0-1] */
     float nodelen;          /* Max. length between two nodes */
     Uint32 color;           /* Color of the spring */
 };
 
 /* Create a new spring. A physics object is automatically created at the tail */
+/* Returns NULL if more than 64 nodes are requested */
 extern struct Spring *create_spring(struct Physics *head,float nodelen, int nodecount);
 
 /* Destroy the spring */
 extern void free_spring(struct Spring *spring);
 
-/* Animate a spring */
-extern void animate_spring(struct Spring *spring);
+/* Animate a batch of springs for one frame. */
+/* The head objects are not moved, only pulled by the spring */
+extern void animate_springs(struct Spring *springs[], int count);
 
 /* Draw a spring onto a viewport */
 extern void draw_spring(struct Spring *spring, const SDL_Rect *camera, const SDL_Rect *viewport);
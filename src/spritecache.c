@@ -0,0 +1,186 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : spritecache.c
+ * Description : Pre-rotated sprite caches
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "SDL.h"
+
+#include "spritecache.h"
+
+/* Subsamples per pixel on each axis when rotating */
+#define ROTATE_SUBSAMPLES 2
+
+/* Create a sprite cache */
+struct SpriteCache *new_sprite_cache (const char *name, int variants,
+                                      int rotations, SDL_Surface * likethis)
+{
+    struct SpriteCache *cache = malloc (sizeof (struct SpriteCache));
+    if (cache)
+        cache->frames = malloc (sizeof (struct AtlasFrame) * variants *
+                                rotations);
+    if (!cache || !cache->frames) {
+        perror ("new_sprite_cache");
+        exit (1);
+    }
+    cache->atlas = new_atlas (name, likethis);
+    cache->variants = variants;
+    cache->rotations = rotations;
+    return cache;
+}
+
+/* Free a sprite cache */
+void free_sprite_cache (struct SpriteCache *cache)
+{
+    free_atlas (cache->atlas);
+    free (cache->frames);
+    free (cache);
+}
+
+/* Read a pixel with premultiplied alpha. Outside is transparent */
+static inline void get_premul (SDL_Surface * src, int x, int y,
+                               float *rgba)
+{
+    const SDL_PixelFormat *f = src->format;
+    Uint32 c;
+    float a;
+    if (x < 0 || y < 0 || x >= src->w || y >= src->h) {
+        rgba[0] = rgba[1] = rgba[2] = rgba[3] = 0;
+        return;
+    }
+    c = *((Uint32 *) ((Uint8 *) src->pixels + y * src->pitch) + x);
+    a = ((c & f->Amask) >> f->Ashift) / 255.0;
+    rgba[0] = ((c & f->Rmask) >> f->Rshift) * a;
+    rgba[1] = ((c & f->Gmask) >> f->Gshift) * a;
+    rgba[2] = ((c & f->Bmask) >> f->Bshift) * a;
+    rgba[3] = a * 255.0;
+}
+
+/* Sample a surface with bilinear filtering */
+static void sample_bilinear (SDL_Surface * src, float x, float y,
+                             float *rgba)
+{
+    float c00[4], c10[4], c01[4], c11[4];
+    int ix, iy, i;
+    float fx, fy;
+    x -= 0.5;
+    y -= 0.5;
+    ix = floor (x);
+    iy = floor (y);
+    fx = x - ix;
+    fy = y - iy;
+    get_premul (src, ix, iy, c00);
+    get_premul (src, ix + 1, iy, c10);
+    get_premul (src, ix, iy + 1, c01);
+    get_premul (src, ix + 1, iy + 1, c11);
+    for (i = 0; i < 4; i++)
+        rgba[i] = (c00[i] * (1 - fx) + c10[i] * fx) * (1 - fy) +
+            (c01[i] * (1 - fx) + c11[i] * fx) * fy;
+}
+
+/* Render src turned counterclockwise by angle around its centre into */
+/* a frame of the same size. Both must be 32 bit with an alpha channel */
+static void rotate_into (SDL_Surface * src, SDL_Surface * dst,
+                         const SDL_Rect * rect, double angle)
+{
+    const SDL_PixelFormat *f = dst->format;
+    float cx = src->w / 2.0, cy = src->h / 2.0;
+    float ca = cos (angle), sa = sin (angle);
+    int x, y, sx, sy, i;
+
+    for (y = 0; y < rect->h; y++) {
+        Uint32 *row = (Uint32 *) ((Uint8 *) dst->pixels +
+                                  (rect->y + y) * dst->pitch) + rect->x;
+        for (x = 0; x < rect->w; x++) {
+            float sum[4] = { 0, 0, 0, 0 };
+            for (sy = 0; sy < ROTATE_SUBSAMPLES; sy++) {
+                for (sx = 0; sx < ROTATE_SUBSAMPLES; sx++) {
+                    float rgba[4];
+                    float px = x + (sx + 0.5) / ROTATE_SUBSAMPLES - cx;
+                    float py = y + (sy + 0.5) / ROTATE_SUBSAMPLES - cy;
+                    /* y grows down, so counterclockwise on screen */
+                    /* means the inverse of the usual rotation */
+                    sample_bilinear (src, cx + px * ca - py * sa,
+                                     cy + px * sa + py * ca, rgba);
+                    for (i = 0; i < 4; i++)
+                        sum[i] += rgba[i];
+                }
+            }
+            for (i = 0; i < 4; i++)
+                sum[i] /= ROTATE_SUBSAMPLES * ROTATE_SUBSAMPLES;
+            if (sum[3] < 0.5) {
+                row[x] = 0;
+            } else {
+                float a = sum[3] / 255.0;
+                row[x] = ((Uint32) (sum[0] / a + 0.5) << f->Rshift) |
+                    ((Uint32) (sum[1] / a + 0.5) << f->Gshift) |
+                    ((Uint32) (sum[2] / a + 0.5) << f->Bshift) |
+                    ((Uint32) (sum[3] + 0.5) << f->Ashift);
+            }
+        }
+    }
+}
+
+/* Copy a surface into a frame as is */
+static void copy_into (SDL_Surface * src, SDL_Surface * dst,
+                       const SDL_Rect * rect)
+{
+    int y;
+    for (y = 0; y < rect->h; y++)
+        memcpy ((Uint8 *) dst->pixels + (rect->y + y) * dst->pitch +
+                rect->x * 4, (Uint8 *) src->pixels + y * src->pitch,
+                rect->w * 4);
+}
+
+/* Render all rotations of a variant */
+int bake_sprite_variant (struct SpriteCache *cache, int variant,
+                         SDL_Surface ** poses, int posecount)
+{
+    Uint32 start = SDL_GetTicks ();
+    int r, ok = 1;
+    for (r = 0; r < cache->rotations; r++) {
+        struct AtlasFrame *frame =
+            &cache->frames[variant * cache->rotations + r];
+        double angle = 2 * M_PI * r / cache->rotations;
+        double pose = angle / (2 * M_PI) * posecount;
+        int p = floor (pose + 0.5);
+        double rest = (pose - p) * 2 * M_PI / posecount;
+        SDL_Surface *src = poses[p % posecount];
+
+        if (!atlas_add (cache->atlas, src->w, src->h, frame)) {
+            ok = 0;
+            break;
+        }
+        SDL_LockSurface (src);
+        SDL_LockSurface (frame->page);
+        if (fabs (rest) < 1e-6 || src->format->Amask == 0)
+            copy_into (src, frame->page, &frame->rect);
+        else
+            rotate_into (src, frame->page, &frame->rect, rest);
+        SDL_UnlockSurface (frame->page);
+        SDL_UnlockSurface (src);
+    }
+    cache->atlas->baketime += SDL_GetTicks () - start;
+    return ok;
+}
@@ -0,0 +1,67 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : spritecache.h
+ * Description : Pre-rotated sprite caches
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef SPRITECACHE_H
+#define SPRITECACHE_H
+
+#include <math.h>
+#include "SDL.h"
+#include "atlas.h"
+
+/* Variants of a sprite, each pre-rotated to a number of angles */
+struct SpriteCache {
+    struct Atlas *atlas;
+    int variants;
+    int rotations;
+    struct AtlasFrame *frames;  /* rotations frames for each variant */
+};
+
+/* Create a sprite cache. Its atlas pages are made like likethis */
+extern struct SpriteCache *new_sprite_cache (const char *name, int variants,
+                                             int rotations,
+                                             SDL_Surface * likethis);
+
+/* Free a sprite cache */
+extern void free_sprite_cache (struct SpriteCache *cache);
+
+/* Render all rotations of a variant. poses are hand drawn frames */
+/* evenly spread over a full counterclockwise turn, starting at angle 0. */
+/* Each rotation is made from the closest pose, turned the rest of the */
+/* way with a filtering rotator. Returns 0 if out of atlas memory */
+extern int bake_sprite_variant (struct SpriteCache *cache, int variant,
+                                SDL_Surface ** poses, int posecount);
+
+/* Get the frame of a variant closest to an angle */
+static inline const struct AtlasFrame *sprite_frame (const struct
+                                                     SpriteCache *cache,
+                                                     int variant,
+                                                     double angle)
+{
+    int r = floor (angle / (2 * M_PI) * cache->rotations + 0.5);
+    r %= cache->rotations;
+    if (r < 0)
+        r += cache->rotations;
+    return &cache->frames[variant * cache->rotations + r];
+}
+
+#endif
@@ -45,7 +45,7 @@ StartupOptions luola_options;
 
 /* Set default values */
 void init_startup_options (void) {
-    struct dllist *config;
+    struct ConfigFile *config;
 
     /* Built in values */
     luola_options.fullscreen = 0;
@@ -60,12 +60,13 @@ void init_startup_options (void) {
     luola_options.audio_chunks = 256;
     luola_options.sfont = 0;
     luola_options.mbg_anim = 1;
+    luola_options.stats = 0;
+    luola_options.rotations = 72;
     luola_options.videomode = VID_640;
 
     /* Load configuration file (if exists) */
     config = read_config_file(getfullpath (HOME_DIRECTORY, "startup.cfg"),1);
     if(config) {
-        struct ConfigBlock *block = config->data;
         struct Translate tr[] = {
             {"fullscreen", CFG_INT, &luola_options.fullscreen},
             {"hidemouse", CFG_INT, &luola_options.hidemouse},
@@ -75,13 +76,16 @@ void init_startup_options (void) {
             {"audiochunks", CFG_INT, &luola_options.audio_chunks},
             {"sfont", CFG_INT, &luola_options.sfont},
             {"mbg_anim", CFG_INT, &luola_options.mbg_anim},
+            {"rotations", CFG_INT, &luola_options.rotations},
             {"videomode", CFG_INT, &luola_options.videomode},
             {0,0,0}
         };
-        translate_config(block->values,tr,0);
+        translate_config(&config->blocks[0],tr,0);
 
-        dllist_free(config,free_config_file);
+        free_config_file(config);
     }
+    if(luola_options.rotations<1)
+        luola_options.rotations = 72;
 }
 
 void print_help (void) {
@@ -103,6 +107,8 @@ void print_help (void) {
     printf ("  --no-menu-animation        Disable menu background animation\n");
     printf ("  --audiorate <rate>         Set audio sampling frequency\n");
     printf ("  --audiochunks <chunks>     Set audio chunks\n");
+    printf ("  --rotations <n>            Pre-rotated frames per ship and turret\n");
+    printf ("  --stats                    Print performance counters after each round\n");
     printf ("  --help                     Show this message\n");
     printf ("  --version                  Show version information\n\n");
 }
@@ -135,6 +141,8 @@ int parse_argument (int r, int argc, char **argv) {
         luola_options.mbg_anim = 1;
     else if (strcmp (argv[r], "--no-menu-animation") == 0)
         luola_options.mbg_anim = 0;
+    else if (strcmp (argv[r], "--stats") == 0)
+        luola_options.stats = 1;
     else if (strcmp (argv[r], "--audiorate") == 0) {
         if (r + 1 < argc) {
             r++;
@@ -151,6 +159,18 @@ int parse_argument (int r, int argc, char **argv) {
             printf ("You did not specify number of chunks\n");
             return 0;
         }
+    } else if (strcmp (argv[r], "--rotations") == 0) {
+        if (r + 1 < argc) {
+            r++;
+            luola_options.rotations = atoi (argv[r]);
+            if (luola_options.rotations < 1) {
+                printf ("Invalid number of rotations %s\n",argv[r]);
+                return 0;
+            }
+        } else {
+            printf ("You did not specify the number of rotations\n");
+            return 0;
+        }
     } else if (strcmp (argv[r], "--videomode") == 0) {
         if (r + 1 < argc) {
             r++;
@@ -191,6 +211,7 @@ int save_startup_config (void) {
     fprintf(fp, "audiochunks=%d\n",luola_options.audio_chunks);
     fprintf(fp, "sfont=%d\n",luola_options.sfont);
     fprintf(fp, "mbg_anim=%d\n",luola_options.mbg_anim);
+    fprintf(fp, "rotations=%d\n",luola_options.rotations);
     fprintf(fp, "videomode=%d\n",luola_options.videomode);
     /* Done. */
     fclose (fp);
@@ -35,6 +35,8 @@ typedef struct {
     int audio_rate, audio_chunks;
     int sfont;
     int mbg_anim;
+    int stats;      /* Print performance counters after each round */
+    int rotations;  /* Pre-rotated frames per ship and turret graphic */
     Videomode videomode;
 } StartupOptions;
 
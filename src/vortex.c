@@ -0,0 +1,97 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : vortex.c
+ * Description : Gravity well vortex graphics
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "console.h"
+#include "atlas.h"
+#include "vortex.h"
+
+int vortex_frame_count = VORTEX_FRAMES;
+
+static struct Atlas *vortex_atlas;
+static struct AtlasFrame *vortex_frames;
+static Uint32 vortex_color;
+
+/* Render a vortex in some phase of its animation. The offsets are */
+/* rounded before they are added to x and y, so the vortex looks the */
+/* same wherever it is drawn and baked frames match it exactly */
+void render_vortex(SDL_Surface *surface,int x,int y,int phase,Uint32 color) {
+    int i;
+    for(i=0;i<12;i++) {
+        double d = -M_PI_4 * i + phase / 4.0;
+        int j;
+        for(j=4;j<=16;j++) {
+            putpixel(surface, x + (int)floor(cos(d-j/6.0) * j),
+                    y + (int)floor(sin(d-j/6.0) * j), color);
+        }
+    }
+}
+
+/* Free the baked frames */
+static void free_vortex(void) {
+    if(vortex_atlas)
+        free_atlas(vortex_atlas);
+    free(vortex_frames);
+    vortex_atlas = NULL;
+    vortex_frames = NULL;
+}
+
+/* Bake the vortex animation into an atlas */
+void bake_vortex(int frames, Uint32 color) {
+    Uint32 start = SDL_GetTicks();
+    int f;
+    free_vortex();
+    vortex_frame_count = frames;
+    vortex_color = color;
+    vortex_frames = malloc(sizeof(struct AtlasFrame) * frames);
+    if(!vortex_frames) {
+        perror("bake_vortex");
+        return;
+    }
+    vortex_atlas = new_atlas("vortex", screen);
+    for(f=0;f<frames;f++) {
+        if(!atlas_add(vortex_atlas, VORTEX_SIZE, VORTEX_SIZE,
+                    &vortex_frames[f])) {
+            /* Out of budget. Draw them the slow way */
+            free_vortex();
+            return;
+        }
+        render_vortex(vortex_frames[f].page,
+                vortex_frames[f].rect.x + VORTEX_SIZE/2,
+                vortex_frames[f].rect.y + VORTEX_SIZE/2, f, color);
+    }
+    vortex_atlas->baketime = SDL_GetTicks() - start;
+}
+
+/* Draw a vortex */
+void draw_vortex_phase(int phase, Uint32 color, int x, int y,
+        SDL_Rect viewport)
+{
+    if(vortex_atlas && color==vortex_color)
+        draw_atlas_frame(&vortex_frames[phase], x, y, viewport);
+    else
+        render_vortex(screen, x+viewport.x, y+viewport.y, phase, color);
+}
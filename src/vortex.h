@@ -0,0 +1,52 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : vortex.h
+ * Description : Gravity well vortex graphics
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef VORTEX_H
+#define VORTEX_H
+
+#include "SDL.h"
+
+/* Default number of animation steps of a gravity well */
+#define VORTEX_FRAMES 10
+
+/* Baked vortex frame size. Arms reach 16 pixels */
+#define VORTEX_SIZE 35
+
+/* Number of steps in the vortex animation */
+extern int vortex_frame_count;
+
+/* Render a vortex in some phase of its animation */
+extern void render_vortex (SDL_Surface * surface, int x, int y, int phase,
+                           Uint32 color);
+
+/* Set the number of animation steps and bake each step in the given */
+/* color into an atlas. If the atlas budget runs out, vortices are */
+/* rendered the slow way */
+extern void bake_vortex (int frames, Uint32 color);
+
+/* Draw a vortex centered on x,y of a player viewport. The baked frame */
+/* is used if the color matches the one the frames were baked in */
+extern void draw_vortex_phase (int phase, Uint32 color, int x, int y,
+                               SDL_Rect viewport);
+
+#endif
@@ -22,10 +22,25 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "level.h"
 #include "walker.h"
 
+/* Surface cache. Each column keeps a sorted list of the y coordinates */
+/* where a walker can stand. Changed rows are rescanned when needed */
+struct Footholds {
+    unsigned short *y;
+    int count, size;
+    int dirty1, dirty2;         /* Changed rows. Clean if dirty1>dirty2 */
+};
+
+static struct Footholds *footholds;
+static int foothold_cols;
+static unsigned short *foothold_scratch;
+static int foothold_scratch_size;
+
 /* Initialize walker with default values */
 void init_walker(struct Walker *walker) {
     init_physobj(&walker->physics,0,0,makeVector(0,0));
@@ -56,16 +71,122 @@ void walker_dive(struct Walker *walker) {
         walker->dive = 1;
 }
 
+/* Allocate the surface cache for the current level */
+void init_footholds(void) {
+    int x;
+    foothold_cols = lev_level.width;
+    footholds = malloc(sizeof(struct Footholds) * foothold_cols);
+    foothold_scratch_size = lev_level.height + 1;
+    foothold_scratch = malloc(sizeof(unsigned short) * foothold_scratch_size);
+    if(!footholds || !foothold_scratch) {
+        perror("init_footholds");
+        exit(1);
+    }
+    for(x=0;x<foothold_cols;x++) {
+        footholds[x].y = NULL;
+        footholds[x].count = 0;
+        footholds[x].size = 0;
+        footholds[x].dirty1 = 0;
+        footholds[x].dirty2 = lev_level.height;
+    }
+}
+
+/* Free the surface cache */
+void free_footholds(void) {
+    int x;
+    for(x=0;x<foothold_cols;x++)
+        free(footholds[x].y);
+    free(footholds);
+    free(foothold_scratch);
+    footholds = NULL;
+    foothold_scratch = NULL;
+    foothold_cols = 0;
+}
+
+/* Mark rows of columns for rescanning */
+void footholds_changed(int x,int y,int w,int h) {
+    int x2 = x + w;
+    if(footholds==NULL)
+        return;
+    if(x<0) x=0;
+    if(x2>foothold_cols) x2=foothold_cols;
+    for(;x<x2;x++) {
+        struct Footholds *col = &footholds[x];
+        if(col->dirty1 > col->dirty2) {
+            col->dirty1 = y;
+            col->dirty2 = y + h - 1;
+        } else {
+            if(y < col->dirty1) col->dirty1 = y;
+            if(y + h - 1 > col->dirty2) col->dirty2 = y + h - 1;
+        }
+    }
+}
+
+/* Rescan the changed rows of a column. A pixel change at y can add or */
+/* remove a surface at y or y+1. Below the level counts as ground */
+static void scan_column(int x) {
+    struct Footholds *col = &footholds[x];
+    const Uint8 *solid = lev_level.solid[x];
+    int y, y1, y2, lo, hi, found = 0;
+
+    y1 = col->dirty1 < 1 ? 1 : col->dirty1;
+    y2 = col->dirty2 + 1 > lev_level.height ? lev_level.height
+        : col->dirty2 + 1;
+    col->dirty1 = 1;
+    col->dirty2 = 0;
+
+    for(y=y1;y<=y2;y++) {
+        if(solid[y-1] > TER_WALKWAY)
+            continue;
+        if(y<lev_level.height && !ter_walkable(solid[y]))
+            continue;
+        foothold_scratch[found++] = y;
+    }
+
+    /* Replace the old surfaces in the range with the new ones */
+    for(lo=0;lo<col->count && col->y[lo]<y1;lo++) {}
+    for(hi=lo;hi<col->count && col->y[hi]<=y2;hi++) {}
+    if(lo + found + col->count - hi > col->size) {
+        col->size = lo + found + col->count - hi + 8;
+        col->y = realloc(col->y, sizeof(unsigned short) * col->size);
+        if(!col->y) {
+            perror("scan_column");
+            exit(1);
+        }
+    }
+    memmove(col->y + lo + found, col->y + hi,
+            sizeof(unsigned short) * (col->count - hi));
+    memcpy(col->y + lo, foothold_scratch, sizeof(unsigned short) * found);
+    col->count = lo + found + col->count - hi;
+}
+
 /* Try to find foothold at x, y +/- h */
 /* Returns the y coordinate where ground was found, or -1 if not */
 int find_foothold(int x,int y,int h) {
-    int r;
-    if(is_walkable(x,y) && is_breathable(x,y-1)) return y;
-    for(r=1;r<h;r++) {
-        if(is_walkable(x,y+r) && is_breathable(x,y+r-1)) return y+r;
-        if(is_walkable(x,y-r) && is_breathable(x,y-r-1)) return y-r;
+    struct Footholds *col;
+    int r, best = -1, bestd = h;
+
+    if(x<0 || x>=foothold_cols)
+        return -1;
+    col = &footholds[x];
+    if(col->dirty1 <= col->dirty2)
+        scan_column(x);
+
+    /* The closest surface wins, the lower one if there is a tie */
+    for(r=0;r<col->count;r++) {
+        int d = col->y[r] - y;
+        if(d<0) {
+            if(-d < bestd) {
+                best = col->y[r];
+                bestd = -d;
+            }
+        } else {
+            if(d==0 || (d < h && d <= bestd))
+                best = col->y[r];
+            break;
+        }
     }
-    return -1;
+    return best;
 }
 
 /* Animate walker */
@@ -53,6 +53,13 @@ extern void walker_jump(struct Walker *walker);
 /* Instruct a walker to dive */
 extern void walker_dive(struct Walker *walker);
 
+/* Build and free the surface cache used by find_foothold */
+extern void init_footholds(void);
+extern void free_footholds(void);
+
+/* Note that terrain in an area has changed */
+extern void footholds_changed(int x,int y,int w,int h);
+
 /* Try to find foothold at x, y +/- h */
 /* Returns the y coordinate where ground was found, or -1 if not */
 extern int find_foothold(int x,int y,int h);
@@ -174,9 +174,10 @@ int print_ldat_catalog(LDAT * ldat, int verbose)
     item = ldat->catalog;
     while (item) {
         if (verbose)
-            printf("%s%s%d\t\t%d\t%d\n", item->ID,
+            printf("%s%s%d\t\t%d\t%d\t%d%s\n", item->ID,
                align_space(item->ID, 30), item->index, item->size,
-               item->pos);
+               item->pos, item->stored,
+               item->codec == LDAT_CODEC_ZLIB ? " (zlib)" : "");
         else
             printf("%s%s%d\n", item->ID, align_space(item->ID, 30),
                item->index);
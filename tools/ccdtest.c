@@ -0,0 +1,200 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : ccdtest.c
+ * Description : Check that fast objects don't tunnel through thin walls
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "physics.h"
+#include "level.h"
+#include "decor.h"
+
+#define LEVEL_SIZE  2048
+#define CENTER      (LEVEL_SIZE / 2)
+#define DISTANCE    300.0   /* How far from the wall objects are fired */
+#define MAX_SPEED   600     /* Fastest shot in pixels per frame */
+
+/* What physics.c needs from the rest of the game */
+Level lev_level;
+Uint32 lev_watercol, col_black;
+
+void put_terrain_pixel (int x, int y, Uint32 color) { }
+void add_decor (struct Decor *decor) { }
+struct Decor *make_snowflake (double x, double y, Vector v) { return NULL; }
+struct Decor *make_waterdrop (double x, double y, Vector v) { return NULL; }
+void add_splash (double x, double y, double force, int count, Vector v,
+        struct Decor *(*make) (double, double, Vector)) { }
+
+/* One pixel thick walls through the centre of the level. */
+/* The diagonal wall pixels only touch each other at the corners */
+typedef enum { VERTICAL, HORIZONTAL, DIAGONAL } Wall;
+static const char *wall_names[] = { "vertical", "horizontal", "diagonal" };
+static const double wall_angles[] = { M_PI_2, 0, -M_PI_4 };
+
+/* Which side of the wall a point is on. 0 means on the wall */
+static int wall_side (Wall wall, double x, double y)
+{
+    int d;
+    switch (wall) {
+    case VERTICAL: d = Round (x) - CENTER; break;
+    case HORIZONTAL: d = Round (y) - CENTER; break;
+    default: d = Round (x) + Round (y) - (LEVEL_SIZE - 1); break;
+    }
+    return d < 0 ? -1 : d > 0;
+}
+
+static void build_wall (Wall wall)
+{
+    int x, y;
+    for (x = 0; x < LEVEL_SIZE; x++) {
+        memset (lev_level.solid[x], TER_FREE, LEVEL_SIZE);
+        for (y = 0; y < LEVEL_SIZE; y++)
+            if (wall_side (wall, x, y) == 0)
+                lev_level.solid[x][y] = TER_GROUND;
+    }
+}
+
+/* Fire an object at the wall and return nonzero if it went through */
+/* or didn't report the wall where it touched it */
+static int fire_at_wall (Wall wall, int solidity, double angle, int speed)
+{
+    struct Physics obj;
+    double vx = cos (angle), vy = sin (angle);
+    int side, frames;
+
+    /* Skip shots that run along the wall */
+    if (fabs (sin (angle - wall_angles[wall])) < 0.1)
+        return 0;
+    /* Aim at a wall pixel, but start off the pixel grid */
+    /* so the paths cover all cases */
+    init_physobj (&obj, CENTER - vx * DISTANCE + 0.37,
+            CENTER - (wall == DIAGONAL) - vy * DISTANCE + 0.21,
+            makeVector (vx * speed, vy * speed));
+    obj.solidity = solidity;
+    obj.obj = 0;
+    /* Cancel gravity and drag so the object flies straight */
+    obj.thrust = get_constant_vel (obj.vel, obj.radius, obj.mass);
+    side = wall_side (wall, obj.x, obj.y);
+    if (side == 0)
+        return 0;   /* The wall runs along the path */
+
+    for (frames = DISTANCE / speed + 3; frames > 0; frames--) {
+        animate_object (&obj, 0, NULL);
+        if (wall_side (wall, obj.x, obj.y) == -side)
+            return 1;
+        if (obj.hitground)
+            return obj.hitground != TER_GROUND ||
+                wall_side (wall, obj.x, obj.y) != 0;
+    }
+    return 1;   /* Never reached the wall */
+}
+
+/* Fire a bullet at a pilot sized object and return nonzero if it missed */
+static int fire_at_object (double angle, int speed)
+{
+    struct Physics target, bullet;
+    struct dllist list, *lists[1];
+    double vx = cos (angle), vy = sin (angle);
+    int frames;
+
+    init_physobj (&target, CENTER, CENTER, makeVector (0, 0));
+    target.radius = 1.0;
+    memset (&list, 0, sizeof (list));
+    list.data = &target;
+    lists[0] = &list;
+
+    init_physobj (&bullet, CENTER - vx * DISTANCE,
+            CENTER - vy * DISTANCE + 0.3, makeVector (vx * speed, vy * speed));
+    bullet.solidity = IMMATERIAL;
+    bullet.radius = 0.5;
+    bullet.thrust = get_constant_vel (bullet.vel, bullet.radius,
+            bullet.mass);
+
+    for (frames = DISTANCE / speed + 3; frames > 0; frames--) {
+        animate_object (&bullet, 1, lists);
+        if (bullet.hitobj)
+            return bullet.hitobj != &target ||
+                hypot (bullet.x - CENTER, bullet.y - CENTER) >
+                target.radius + bullet.radius + 0.01;
+    }
+    return 1;
+}
+
+int main (int argc, char *argv[])
+{
+    int wall, solidity, speed, angle, x;
+    int tests = 0, fails = 0;
+
+    lev_level.width = LEVEL_SIZE;
+    lev_level.height = LEVEL_SIZE;
+    lev_level.solid = malloc (sizeof (unsigned char *) * LEVEL_SIZE);
+    for (x = 0; x < LEVEL_SIZE; x++)
+        lev_level.solid[x] = malloc (LEVEL_SIZE);
+    reset_physics ();
+
+    for (wall = VERTICAL; wall <= DIAGONAL; wall++) {
+        build_wall (wall);
+        for (solidity = WRAITH; solidity <= SOLID; solidity++) {
+            int wallfails = 0, walltests = 0;
+            for (speed = 1; speed <= MAX_SPEED; speed += speed / 8 + 1) {
+                for (angle = 0; angle < 360; angle += 7) {
+                    walltests++;
+                    if (fire_at_wall (wall, solidity, angle * M_PI / 180.0,
+                                speed)) {
+                        if (wallfails++ < 5)
+                            printf ("%s wall: speed %d, angle %d failed\n",
+                                    wall_names[wall], speed, angle);
+                    }
+                }
+            }
+            printf ("%s wall, %s objects: %d of %d shots failed\n",
+                    wall_names[wall], solidity == SOLID ? "solid" : "wraith",
+                    wallfails, walltests);
+            tests += walltests;
+            fails += wallfails;
+        }
+    }
+
+    for (x = 0; x < LEVEL_SIZE; x++)
+        memset (lev_level.solid[x], TER_FREE, LEVEL_SIZE);
+    {
+        int objfails = 0, objtests = 0;
+        for (speed = 1; speed <= MAX_SPEED; speed += speed / 8 + 1) {
+            for (angle = 0; angle < 360; angle += 11) {
+                objtests++;
+                if (fire_at_object (angle * M_PI / 180.0, speed)) {
+                    if (objfails++ < 5)
+                        printf ("object: speed %d, angle %d missed\n",
+                                speed, angle);
+                }
+            }
+        }
+        printf ("objects: %d of %d shots missed\n", objfails, objtests);
+        tests += objtests;
+        fails += objfails;
+    }
+
+    printf ("%d of %d tests failed\n", fails, tests);
+    return fails > 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : craterbench.c
+ * Description : Compare the terrain brush with the old bullet hole stamps
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "console.h"
+#include "level.h"
+#include "levelfile.h"
+#include "lcmap.h"
+#include "jobs.h"
+#include "decor.h"
+#include "particle.h"
+#include "player.h"
+#include "ship.h"
+#include "bullet.h"
+#include "animation.h"
+
+#define LEVEL_SIZE  2048
+#define RADIUS      12      /* Radius of the crater */
+#define SPACING     32      /* Distance between the craters */
+#define PASSES      10      /* Times the level is dug full of craters */
+
+/* What level.c, nav.c and walker.c need from the rest of the game */
+Uint32 col_black, col_gray, col_clay, col_clay_uw, col_green, col_snow,
+    col_white;
+SDL_Surface *screen;
+Player players[4];
+GameInfo game_settings;
+PerLevelSettings level_settings;
+double weather_wind_vector;
+
+Uint32 map_rgba (Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    return SDL_MapRGB (screen->format, r, g, b);
+}
+
+#ifndef HAVE_LIBSDL_GFX
+void putpixel (SDL_Surface * surface, int x, int y, Uint32 color)
+{
+    *(Uint32 *) ((Uint8 *) surface->pixels + y * surface->pitch + x * 4) =
+        color;
+}
+#endif
+
+Uint32 getpixel (SDL_Surface * surface, int x, int y) { return 0; }
+SDL_Surface *make_surface (SDL_Surface * likethis, int w, int h)
+{
+    return NULL;
+}
+SDL_Rect cliprect (int x1, int y1, int w1, int h1, int x2, int y2,
+        int w2, int h2)
+{
+    SDL_Rect r = { 0, 0, 0, 0 };
+    return r;
+}
+SDL_Rect get_viewport_size (void)
+{
+    SDL_Rect r = { 0, 0, 0, 0 };
+    return r;
+}
+void bump_ship (int x, int y) { }
+void add_decor (struct Decor *d) { }
+void add_splash (double x, double y, double f, int count, Vector v,
+        struct Decor *(*make) (double, double, Vector)) { }
+struct Decor *make_snowflake (double x, double y, Vector v) { return NULL; }
+struct Decor *make_waterdrop (double x, double y, Vector v) { return NULL; }
+struct Particle *make_particle (float x, float y, int age) { return NULL; }
+struct Projectile *make_bullet (double x, double y, Vector v) { return NULL; }
+struct Projectile *make_grenade (double x, double y, Vector v) { return NULL; }
+void spawn_clusters (double x, double y, double f, int count,
+        struct Projectile *(*make_projectile) (double x, double y,
+                                               Vector v)) { }
+
+/* The level is a solid block of ground, decoded right away */
+static struct LevelSettings settings;
+
+int open_level (struct LevelFile *level)
+{
+    level->settings = &settings;
+    return 0;
+}
+void close_level (struct LevelFile *level) { }
+SDL_Surface *load_level_art (struct LevelFile *level,
+        SDL_PixelFormat * format)
+{
+    return SDL_CreateRGBSurface (SDL_SWSURFACE, LEVEL_SIZE, LEVEL_SIZE, 32,
+                                 format->Rmask, format->Gmask,
+                                 format->Bmask, 0);
+}
+int load_level_grid (struct LevelFile *level, int mark, LCMAP_Grid * grid)
+{
+    memset (grid, 0, sizeof (LCMAP_Grid));
+    grid->width = LEVEL_SIZE;
+    grid->height = LEVEL_SIZE;
+    grid->grid = malloc (LEVEL_SIZE * LEVEL_SIZE);
+    memset (grid->grid, TER_GROUND, LEVEL_SIZE * LEVEL_SIZE);
+    return 0;
+}
+void lcmap_free_grid (LCMAP_Grid * grid)
+{
+    free (grid->grid);
+}
+Job *add_job (JobFunc func, void *arg)
+{
+    func (arg);
+    return NULL;
+}
+void finish_job (Job * job) { }
+int cancel_job (Job * job) { return 1; }
+int job_done (Job * job) { return 1; }
+
+/* The old bullet hole bitmap */
+#define HOLE_W 9
+#define HOLE_H 9
+static const Uint8 hole_bm[HOLE_H][HOLE_W] = {
+    {1, 1, 1, 1, 0, 1, 1, 1, 1},
+    {1, 1, 1, 0, 0, 0, 1, 1, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 0},
+    {1, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 0, 0, 0, 0, 0, 0, 0, 1},
+    {1, 1, 1, 0, 0, 0, 1, 1, 1},
+    {1, 1, 1, 1, 0, 1, 1, 1, 1}
+};
+
+/* Make a bullet hole the way it was done before the terrain brush. */
+/* Every pixel is changed with put_terrain_pixel */
+static void old_make_hole (int x, int y)
+{
+    int fx, fy;
+    if (lev_level.solid[x][y] == TER_INDESTRUCT)
+        return;
+    for (fx = 0; fx < HOLE_W; fx++) {
+        for (fy = 0; fy < HOLE_H; fy++) {
+            int terrain, rx, ry;
+            if (hole_bm[fx][fy])
+                continue;
+            rx = fx - HOLE_W / 2 + x;
+            ry = fy - HOLE_H / 2 + y;
+            if (rx < 0 || ry < 0 || rx >= lev_level.width
+                || ry >= lev_level.height)
+                continue;
+            terrain = lev_level.solid[rx][ry];
+            if ((ter_semisolid (terrain) || ter_solid (terrain))
+                && ter_indestructable (terrain) == 0) {
+                if (terrain == TER_BASE)
+                    lev_level.base_area--;
+                if (terrain == TER_UNDERWATER || terrain == TER_ICE) {
+                    lev_level.solid[rx][ry] = TER_WATER;
+                    put_terrain_pixel (rx, ry, lev_watercol);
+                } else {
+                    lev_level.solid[rx][ry] = TER_FREE;
+                    put_terrain_pixel (rx, ry, col_black);
+                }
+            }
+        }
+    }
+}
+
+/* Dig a crater out of overlapping bullet holes, as the game had to */
+/* before the brush could make big craters. The holes are 3 pixels */
+/* apart and dig out about as many pixels as the brush crater */
+#define STAMP_STEP  3
+#define STAMP_REACH (RADIUS - 3)
+static void old_make_crater (int x, int y)
+{
+    int dx, dy;
+    for (dx = -STAMP_REACH; dx <= STAMP_REACH; dx += STAMP_STEP)
+        for (dy = -STAMP_REACH; dy <= STAMP_REACH; dy += STAMP_STEP)
+            if (dx * dx + dy * dy <= STAMP_REACH * STAMP_REACH)
+                old_make_hole (x + dx, y + dy);
+}
+
+static void new_make_crater (int x, int y)
+{
+    make_crater (x, y, RADIUS);
+}
+
+/* Fill the level with ground again */
+static void refill (void)
+{
+    int x;
+    for (x = 0; x < LEVEL_SIZE; x++)
+        memset (lev_level.solid[x], TER_GROUND, LEVEL_SIZE);
+    mark_terrain_dirty (0, 0, LEVEL_SIZE, LEVEL_SIZE);
+}
+
+/* Count the pixels dug out of the level */
+static int count_free (void)
+{
+    int x, y, count = 0;
+    for (x = 0; x < LEVEL_SIZE; x++)
+        for (y = 0; y < LEVEL_SIZE; y++)
+            count += lev_level.solid[x][y] == TER_FREE;
+    return count;
+}
+
+/* Dig the level full of craters and print the time one crater takes */
+static void bench (const char *name, void (*crater) (int x, int y))
+{
+    clock_t elapsed = 0;
+    int pass, x, y, craters = 0, dug = 0;
+    for (pass = 0; pass < PASSES; pass++) {
+        clock_t start;
+        refill ();
+        start = clock ();
+        for (x = SPACING / 2; x < LEVEL_SIZE; x += SPACING) {
+            for (y = SPACING / 2; y < LEVEL_SIZE; y += SPACING) {
+                crater (x, y);
+                craters++;
+            }
+        }
+        elapsed += clock () - start;
+        dug += count_free ();
+    }
+    printf ("%-32s %6.2f us per crater, %3d pixels\n", name,
+            (double) elapsed / CLOCKS_PER_SEC / craters * 1e6,
+            dug / craters);
+}
+
+int main (int argc, char *argv[])
+{
+    struct LevelFile lev;
+
+    /* load_level converts the level art to the display format, */
+    /* so a video mode is needed. It doesn't have to be seen */
+    putenv ("SDL_VIDEODRIVER=dummy");
+    SDL_Init (SDL_INIT_VIDEO);
+    screen = SDL_SetVideoMode (64, 64, 32, 0);
+    if (screen == NULL) {
+        printf ("Couldn't set a video mode: %s\n", SDL_GetError ());
+        return 1;
+    }
+    memset (&lev, 0, sizeof (lev));
+    load_level (&lev);
+
+    bench ("Radius 12 brush", new_make_crater);
+    bench ("Overlapping 9x9 bullet holes", old_make_crater);
+    unload_level ();
+    SDL_Quit ();
+    return 0;
+}
@@ -29,6 +29,62 @@
 #include <SDL/SDL_image.h>
 
 #include "lcmap.h"
+#include "jobs.h"
+
+static Uint32 get_le32(const Uint8 *ptr)
+{
+    return ptr[0] | ptr[1] << 8 | ptr[2] << 16 | (Uint32)ptr[3] << 24;
+}
+
+/* Print LCMAP header information */
+static int lcmap_info(const char *filename)
+{
+    Uint8 hdr[19], entry[12];
+    Uint32 bandrows, bands, b, zlen = 0, rawlen = 0;
+    FILE *fp;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        perror(filename);
+        return 1;
+    }
+    if (fread(hdr, 1, 10, fp) < 10 || strncmp((char*)hdr, "LCMAP", 5)) {
+        fprintf(stderr,"%s: not an LCMAP file\n", filename);
+        fclose(fp);
+        return 1;
+    }
+    if (hdr[5] | hdr[6] | hdr[7] | hdr[8]) {
+        printf("Version: 1\nSize: %dx%d\n", hdr[5] | hdr[6] << 8,
+                hdr[7] | hdr[8] << 8);
+        fclose(fp);
+        return 0;
+    }
+    if (fread(hdr + 10, 1, 9, fp) < 9
+            || fseek(fp, hdr[18] * 3, SEEK_CUR)
+            || fread(entry, 1, 8, fp) < 8) {
+        fprintf(stderr,"%s: truncated header\n", filename);
+        fclose(fp);
+        return 1;
+    }
+    bandrows = get_le32(entry);
+    bands = get_le32(entry + 4);
+    for (b = 0; b < bands; b++) {
+        if (fread(entry, 1, 12, fp) < 12) {
+            fprintf(stderr,"%s: truncated band table\n", filename);
+            fclose(fp);
+            return 1;
+        }
+        zlen += get_le32(entry + 4);
+        rawlen += get_le32(entry + 8);
+    }
+    fclose(fp);
+    printf("Version: %d\nSize: %ux%u\n", hdr[9], get_le32(hdr + 10),
+            get_le32(hdr + 14));
+    printf("Bands: %u of %u rows\n", bands, bandrows);
+    printf("Data: %u bytes packed, %u bytes run length encoded\n",
+            zlen, rawlen);
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
@@ -39,8 +95,11 @@ int main(int argc, char *argv[])
     Uint32 maplen;
     int bytes;
 
+    if (argc == 3 && strcmp(argv[1], "info") == 0)
+        return lcmap_info(argv[2]);
     if (argc < 4) {
-        printf("Usage:\nlcmap <pack/unpack> <file1> <file2>\n");
+        printf("Usage:\nlcmap <pack/unpack> <file1> <file2>\n"
+               "lcmap info <file>\n");
         return 0;
     }
     if (strcmp(argv[1], "pack") == 0)
@@ -97,6 +156,7 @@ int main(int argc, char *argv[])
                     finfo.st_size);
             perror("fread");
         }
+        init_jobs();
         surface = lcmap_to_surface(mapdata, bytes);
         free(mapdata);
         if (surface == NULL)
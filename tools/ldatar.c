@@ -30,7 +30,7 @@
 
 typedef enum {MODE_UNSET,LIST,PACK,EXTRACT} Mode;
 static Mode ldat_mode = MODE_UNSET;
-static int verbose = 0, pack_index = 1;
+static int verbose = 0, pack_index = 1, compress = 0;
 
 /* Print out list of files in LDAT archive */
 static int list_ldat(const char *filename) {
@@ -48,6 +48,7 @@ static int pack_ldat(const char *filename,int filec, char *filev[]) {
     const char *outputfile;
     LDAT *ldat = ldat_create();
 
+    ldat->compress = compress;
     if(filec==0) {
         /* No list of files specified, assume filename is a .pack file */
         outputfile = pack_ldat_index(ldat,filename, pack_index,verbose);
@@ -141,6 +142,7 @@ int main(int argc, char *argv[]) {
         puts("\t-p, --pack <ldat/pack>    Pack files into an archive");
         puts("\t-x, --extract <ldat/pack> Extract files from an archive");
         puts("\t-I, --noindex             Do not automatically insert index file");
+        puts("\t-z, --compress            Compress items when packing");
         puts("\t-v, --verbose             Print extra information");
         exit(0);
     }
@@ -152,15 +154,17 @@ int main(int argc, char *argv[]) {
             {"extract", required_argument,  0, 'x'},
             {"index",   no_argument,        0, 'i'},
             {"noindex",no_argument,        0, 'I'},
+            {"compress",no_argument,       0, 'z'},
             {0,0,0,0}};
         int option_index = 0;
 
-        c = getopt_long(argc,argv,"l:p:x:Iv", options, &option_index);
+        c = getopt_long(argc,argv,"l:p:x:Izv", options, &option_index);
         switch(c) {
             case 'l': set_mode(LIST); ldatfile=optarg; break;
             case 'p': set_mode(PACK); ldatfile=optarg; break;
             case 'x': set_mode(EXTRACT); ldatfile=optarg; break;
             case 'I': pack_index = 0; break;
+            case 'z': compress = 1; break;
             case 'v': verbose = 1; break;
             case '?': exit(1);
         }
@@ -0,0 +1,165 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : minetest.c
+ * Description : Dividing mine stress test for the projectile index
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "projectile.h"
+#include "bullet.h"
+#include "level.h"
+
+#define LEVEL_SIZE  3000
+#define MINES       5000    /* Dividing mines at the start */
+#define SPACING     38      /* Distance between the mines at the start */
+#define KILLS       10      /* Mines destroyed on each frame */
+#define FRAMES      300     /* Default number of frames to run */
+#define CELLS       (LEVEL_SIZE / PROJ_CELL + 1)
+
+static int failures;
+
+/* Report a failed check */
+static void fail (int frame, const char *what, int x, int y)
+{
+    if (failures++ < 10)
+        printf ("Frame %d: %s at %d,%d\n", frame, what, x, y);
+}
+
+/* Recount the dividing mines in each index cell the slow way and */
+/* compare with what the index reports for the cells around each one */
+static int check_index (int frame)
+{
+    static int cells[CELLS][CELLS];
+    struct dllist *ptr;
+    int x, y, dx, dy, mines = 0;
+
+    memset (cells, 0, sizeof (cells));
+    for (ptr = projectile_list; ptr; ptr = ptr->next) {
+        struct Projectile *p = ptr->data;
+        if (p->kind != PROJ_DIVMINE)
+            continue;
+        x = (int) p->physics.x >> PROJ_CELL_SHIFT;
+        y = (int) p->physics.y >> PROJ_CELL_SHIFT;
+        x = x < 0 ? 0 : x >= CELLS ? CELLS - 1 : x;
+        y = y < 0 ? 0 : y >= CELLS ? CELLS - 1 : y;
+        if (p->cell != y * CELLS + x)
+            fail (frame, "mine indexed in the wrong cell", x, y);
+        cells[x][y]++;
+        mines++;
+    }
+
+    for (x = 0; x < CELLS; x++) {
+        for (y = 0; y < CELLS; y++) {
+            int count = 0;
+            for (dx = x - 1; dx <= x + 1; dx++) {
+                for (dy = y - 1; dy <= y + 1; dy++) {
+                    if (dx >= 0 && dx < CELLS && dy >= 0 && dy < CELLS)
+                        count += cells[dx][dy];
+                }
+            }
+            if (count_projectiles_near (PROJ_DIVMINE, x * PROJ_CELL,
+                                        y * PROJ_CELL) != count)
+                fail (frame, "wrong mine count", x, y);
+        }
+    }
+    return mines;
+}
+
+/* Destroy a random mine, as if something had hit it */
+static void kill_mine (void)
+{
+    struct dllist *ptr = projectile_list;
+    int r = rand () % (dllist_count (projectile_list) + 1);
+    while (ptr && r--)
+        ptr = ptr->next;
+    if (ptr)
+        ((struct Projectile *) ptr->data)->life = 0;
+}
+
+static double seconds (clock_t ticks)
+{
+    return (double) ticks / CLOCKS_PER_SEC;
+}
+
+int main (int argc, char *argv[])
+{
+    int frames = argc > 1 ? atoi (argv[1]) : FRAMES;
+    clock_t total = 0, worst = 0;
+    int f, x, mines = 0, most = 0;
+
+    screen = SDL_CreateRGBSurface (SDL_SWSURFACE, 64, 64, 32, 0xff0000,
+                                   0xff00, 0xff, 0);
+    lev_level.width = LEVEL_SIZE;
+    lev_level.height = LEVEL_SIZE;
+    lev_level.solid = malloc (sizeof (unsigned char *) * LEVEL_SIZE);
+    for (x = 0; x < LEVEL_SIZE; x++) {
+        lev_level.solid[x] = malloc (LEVEL_SIZE);
+        memset (lev_level.solid[x], TER_FREE, LEVEL_SIZE);
+    }
+    reset_physics ();
+    clear_projectiles ();
+    srand (1);
+
+    /* Lay the mines out in a grid and make them divide on different */
+    /* frames. The mines don't hit each other. Otherwise the field soon */
+    /* blows itself up and the bullets take most of the time */
+    for (x = 0; x < MINES; x++) {
+        int row = LEVEL_SIZE / SPACING - 4;
+        struct Projectile *p = make_divmine (
+                2 * SPACING + x % row * SPACING + rand () % 10,
+                2 * SPACING + x / row * SPACING + rand () % 10,
+                makeVector (0, 0));
+        p->timer = rand () % p->var;
+        p->otherobj = 0;
+        add_projectile (p);
+    }
+    flush_projectiles ();
+
+    /* Mines move, divide and get destroyed. The index must still */
+    /* match the list after every sync point */
+    for (f = 0; f < frames; f++) {
+        clock_t start, elapsed;
+        for (x = 0; x < KILLS; x++)
+            kill_mine ();
+        start = clock ();
+        flush_projectiles ();
+        animate_projectiles ();
+        flush_projectiles ();
+        elapsed = clock () - start;
+        total += elapsed;
+        if (elapsed > worst)
+            worst = elapsed;
+
+        mines = check_index (f);
+        if (mines > most)
+            most = mines;
+    }
+
+    printf ("%d frames: %.3f ms average, %.3f ms worst, "
+            "%d mines at most, %d at the end, %lu projectiles removed\n",
+            frames, seconds (total) / frames * 1e3, seconds (worst) * 1e3,
+            most, mines, projectile_queue_stats.removed);
+    printf ("%d checks failed\n", failures);
+    return failures > 0;
+}
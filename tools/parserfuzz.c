@@ -0,0 +1,264 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : parserfuzz.c
+ * Description : Fuzz test and benchmark for the configuration file parser
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SDL.h"
+#include "parser.h"
+
+#define FUZZ_ITERATIONS 30000   /* Default number of random inputs */
+#define FUZZ_MAXLEN     300     /* Longest random input */
+#define DUMP_SIZE       65536   /* Enough for the dump of any random input */
+#define BENCH_TIME      0.2     /* Seconds to spend on each benchmark */
+
+/* Random inputs are mostly made of characters that mean something */
+/* to the parser, so they hit all the corner cases often */
+static const char fuzz_chars[] = "ab =[]#\n\r\t x1-";
+
+/* Translation table with overlapping and duplicate keys. */
+/* The first of the duplicate keys should win */
+static int values[5];
+static const struct Translate fuzz_table[] = {
+    {"a", CFG_INT, &values[0]},
+    {"b", CFG_INT, &values[1]},
+    {"ab", CFG_INT, &values[2]},
+    {"a b", CFG_INT, &values[3]},
+    {"a", CFG_INT, &values[4]},
+    {0, 0, 0}
+};
+
+/* Dump the translated values of a block */
+static int dump_values (char *out)
+{
+    return sprintf (out, "T %d %d %d %d %d\n", values[0], values[1],
+                    values[2], values[3], values[4]);
+}
+
+/* Parse a buffer with the real parser and dump the result as text */
+static int parser_dump (const char *buf, int len, char *out)
+{
+    SDL_RWops *rw = SDL_RWFromConstMem (buf, len);
+    struct ConfigFile *cfg = read_config_rw (rw, len, 1);
+    int n = 0, b, v;
+    SDL_FreeRW (rw);
+    out[0] = '\0';
+    if (cfg == NULL)
+        return sprintf (out, "NULL\n");
+    for (b = 0; b < cfg->count; b++) {
+        const struct ConfigBlock *block = &cfg->blocks[b];
+        struct ConfigBlock complete;
+        struct KeyValue pairs[FUZZ_MAXLEN];
+        n += sprintf (out + n, "[%s]\n",
+                      block->title ? block->title : "(default)");
+        /* Settings without a key or a value are complained about even */
+        /* in quiet mode, so only the complete ones are translated */
+        complete.count = 0;
+        complete.values = pairs;
+        for (v = 0; v < block->count; v++) {
+            const struct KeyValue *pair = &block->values[v];
+            n += sprintf (out + n, "<%s>=<%s>\n",
+                          pair->key ? pair->key : "(null)",
+                          pair->value ? pair->value : "(null)");
+            if (pair->key && pair->value)
+                pairs[complete.count++] = *pair;
+        }
+        memset (values, 0, sizeof (values));
+        translate_config (&complete, fuzz_table, 1);
+        n += dump_values (out + n);
+    }
+    free_config_file (cfg);
+    return n;
+}
+
+/* Strip characters upto 0x20 from both ends of str..end */
+static const char *reference_trim (const char *str, const char **end)
+{
+    while (str < *end && (unsigned char) *str <= ' ')
+        str++;
+    while (*end > str && (unsigned char) (*end)[-1] <= ' ')
+        (*end)--;
+    return str < *end ? str : NULL;
+}
+
+/* Parse a buffer one line at a time the simple way and dump the */
+/* result in the same format as parser_dump */
+static int reference_dump (const char *buf, int len, char *out)
+{
+    const char *line = buf, *end = buf + len;
+    int n = 0, blocks = 0;
+    while (line < end) {
+        const char *eol = memchr (line, '\n', end - line);
+        const char *str, *eq;
+        if (eol == NULL)
+            eol = end;
+        str = reference_trim (line, &eol);
+        line = memchr (line, '\n', end - line);
+        line = line ? line + 1 : end;
+        if (str == NULL || str[0] == '#')
+            continue;
+        if (str[0] == '[' || blocks == 0) {
+            if (blocks++)
+                n += dump_values (out + n);
+            memset (values, 0, sizeof (values));
+            if (str[0] == '[') {
+                /* The last character is assumed to be the ']' */
+                int titlelen = eol - str - 1;
+                n += sprintf (out + n, "[%.*s]\n",
+                              titlelen > 0 ? titlelen - 1 : 0, str + 1);
+                continue;
+            }
+            n += sprintf (out + n, "[(default)]\n");
+        }
+        eq = memchr (str, '=', eol - str);
+        if (eq == NULL) {
+            n += sprintf (out + n, "<(null)>=<(null)>\n");
+        } else {
+            const char *keyend = eq, *valend = eol;
+            const char *key = reference_trim (str, &keyend);
+            const char *value = reference_trim (eq + 1, &valend);
+            n += sprintf (out + n, "<%.*s>=<%.*s>\n",
+                          key ? (int) (keyend - key) : 6,
+                          key ? key : "(null)",
+                          value ? (int) (valend - value) : 6,
+                          value ? value : "(null)");
+            if (key && value) {
+                int r;
+                for (r = 0; fuzz_table[r].key; r++) {
+                    if (strlen (fuzz_table[r].key) == keyend - key &&
+                        strncmp (fuzz_table[r].key, key, keyend - key) == 0)
+                        break;
+                }
+                if (fuzz_table[r].key) {
+                    char number[FUZZ_MAXLEN + 1];
+                    sprintf (number, "%.*s", (int) (valend - value), value);
+                    *(int *) fuzz_table[r].ptr = atoi (number);
+                }
+            }
+        }
+    }
+    if (blocks == 0)
+        return sprintf (out, "NULL\n");
+    n += dump_values (out + n);
+    return n;
+}
+
+/* Compare the parser against the reference on random inputs. */
+/* Every third input is made of random bytes. Those are only parsed, */
+/* to catch crashes and memory errors when run under a checker. */
+static int fuzz (int iterations, unsigned int seed)
+{
+    static char parsed[DUMP_SIZE], expected[DUMP_SIZE];
+    char buf[FUZZ_MAXLEN];
+    int i, fails = 0;
+    srand (seed);
+    for (i = 0; i < iterations; i++) {
+        int len = rand () % FUZZ_MAXLEN, j;
+        int raw = i % 3 == 2;
+        for (j = 0; j < len; j++) {
+            if (raw)
+                buf[j] = rand () % 256;
+            else
+                buf[j] = fuzz_chars[rand () % (sizeof (fuzz_chars) - 1)];
+        }
+        parser_dump (buf, len, parsed);
+        if (raw)
+            continue;
+        reference_dump (buf, len, expected);
+        if (strcmp (parsed, expected)) {
+            if (fails++ < 3) {
+                printf ("Input %d:\n", i);
+                fwrite (buf, 1, len, stdout);
+                printf ("\n--- parser\n%s--- reference\n%s", parsed,
+                        expected);
+            }
+        }
+    }
+    printf ("%d of %d inputs parsed differently\n", fails, iterations);
+    return fails > 0;
+}
+
+/* Parse a buffer over and over and print the time one parse takes */
+static void bench (const char *name, const char *buf, int len)
+{
+    clock_t start = clock (), elapsed;
+    int reps = 0, blocks = 0;
+    do {
+        SDL_RWops *rw = SDL_RWFromConstMem (buf, len);
+        struct ConfigFile *cfg = read_config_rw (rw, 0, 1);
+        SDL_FreeRW (rw);
+        if (cfg) {
+            blocks = cfg->count;
+            free_config_file (cfg);
+        }
+        reps++;
+        elapsed = clock () - start;
+    } while (elapsed < BENCH_TIME * CLOCKS_PER_SEC);
+    printf ("%-30s %7d bytes, %4d blocks: %9.2f us\n", name, len, blocks,
+            (double) elapsed / CLOCKS_PER_SEC / reps * 1e6);
+}
+
+/* Benchmark the parser with the given files and a large generated file */
+static int bench_files (int count, char *files[])
+{
+    char *buf;
+    int f, len, r;
+    for (f = 0; f < count; f++) {
+        FILE *fp = fopen (files[f], "rb");
+        if (fp == NULL) {
+            perror (files[f]);
+            return 1;
+        }
+        fseek (fp, 0, SEEK_END);
+        len = ftell (fp);
+        rewind (fp);
+        buf = malloc (len + 1);
+        len = fread (buf, 1, len, fp);
+        fclose (fp);
+        bench (files[f], buf, len);
+        free (buf);
+    }
+
+    buf = malloc (500 * 80);
+    for (r = 0, len = 0; r < 500; r++)
+        len += sprintf (buf + len, "[object]\ntype = turret\nx = %d\n"
+                        "y = %d\nvalue = 1\n\n# comment\n", r * 7, r * 3);
+    bench ("500 generated blocks", buf, len);
+    free (buf);
+    return 0;
+}
+
+int main (int argc, char *argv[])
+{
+    if (argc > 1 && strcmp (argv[1], "-b") == 0)
+        return bench_files (argc - 2, argv + 2);
+    if (argc > 1 && argv[1][0] == '-') {
+        printf ("Usage: %s [iterations [seed]]\n"
+                "       %s -b [files...]\n", argv[0], argv[0]);
+        return 1;
+    }
+    return fuzz (argc > 1 ? atoi (argv[1]) : FUZZ_ITERATIONS,
+                 argc > 2 ? atoi (argv[2]) : 1);
+}
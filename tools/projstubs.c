@@ -0,0 +1,122 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : projstubs.c
+ * Description : What projectile.c and bullet.c need from the rest of the
+ *               game, for the projectile tests
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "console.h"
+#include "level.h"
+#include "decor.h"
+#include "particle.h"
+#include "player.h"
+#include "ship.h"
+#include "pilot.h"
+#include "critter.h"
+#include "audio.h"
+#include "fs.h"
+#include "vortex.h"
+
+/* Game state. There are no players, ships, pilots or critters */
+Level lev_level;
+Uint32 lev_watercol, burncolor[FIRE_FRAMES];
+Uint32 col_black, col_gray, col_snow, col_clay, col_default, col_yellow;
+Uint32 col_green, col_blue, col_white;
+SDL_Surface *screen;
+SDL_Rect cam_rects[4], viewport_rects[4];
+Player players[4];
+GameInfo game_settings;
+struct dllist *ship_list, *pilot_list, *critter_list;
+double weather_wind_vector;
+int vortex_frame_count;
+const struct SpecialWeapon special_weapon[1];
+
+Uint64 get_time_us (void)
+{
+    return (Uint64) clock () * 1000000 / CLOCKS_PER_SEC;
+}
+
+Uint32 map_rgba (Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    return (r << 24) | (g << 16) | (b << 8) | a;
+}
+
+void unmap_rgba (Uint32 c, Uint8 * r, Uint8 * g, Uint8 * b, Uint8 * a)
+{
+    *r = c >> 24;
+    *g = c >> 16;
+    *b = c >> 8;
+    *a = c;
+}
+
+Vector get_muzzle_vel (double angle)
+{
+    return makeVector (cos (angle) * 11.5, -sin (angle) * 11.5);
+}
+
+/* Terrain is never changed */
+void put_terrain_pixel (int x, int y, Uint32 color) { }
+void make_crater (int x, int y, int radius) { }
+void burn_hole (int x, int y) { }
+void alter_level (int x, int y, int recurse, LevelFXType type) { }
+void start_burning (int x, int y) { }
+void start_melting (int x, int y, unsigned int recurse) { }
+void mark_terrain_dirty (int x, int y, int w, int h) { }
+
+/* Nothing is drawn or heard */
+void add_decor (struct Decor *d) { }
+void add_splash (double x, double y, double f, int count, Vector v,
+        struct Decor *(*make) (double, double, Vector)) { }
+struct Decor *make_snowflake (double x, double y, Vector v) { return NULL; }
+struct Decor *make_waterdrop (double x, double y, Vector v) { return NULL; }
+struct Particle *make_particle (float x, float y, int age) { return NULL; }
+void playwave (AudioSample sample) { }
+void playwave_3d (AudioSample sample, int x, int y) { }
+void bake_vortex (int frames, Uint32 color) { }
+void draw_vortex_phase (int phase, Uint32 color, int x, int y,
+        SDL_Rect viewport) { }
+SDL_Surface **load_image_array (LDAT * datafile, int allownull,
+        Transparency transparency, const char *id, int *count)
+{
+    *count = 0;
+    return NULL;
+}
+#ifndef HAVE_LIBSDL_GFX
+void putpixel (SDL_Surface * surface, int x, int y, Uint32 color) { }
+void draw_line (SDL_Surface * screen, int x1, int y1, int x2, int y2,
+        Uint32 pixel) { }
+#endif
+
+/* Nothing can be hit */
+struct Ship *find_nearest_ship (double myX, double myY,
+        struct Ship *not_this, double *dist) { return NULL; }
+int find_nearest_enemy (double myX, double myY, int myplr, double *dist)
+{
+    return -1;
+}
+void damage_ship (struct Ship *ship, float damage, float critical) { }
+void freeze_ship (struct Ship *ship) { }
+void spear_ship (struct Ship *ship, struct Projectile *spear) { }
+void kill_pilot (struct Pilot *pilot) { }
+void hit_critter (struct Critter *critter, struct Projectile *p) { }
@@ -0,0 +1,163 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : projtest.c
+ * Description : Stress test for the projectile spawn queue
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "projectile.h"
+#include "bullet.h"
+#include "level.h"
+
+#define LEVEL_SIZE  1024
+#define BOMBS       2000    /* Bombs going off in the same frame */
+#define CLUSTER     16      /* Bullets in each bomb's cluster */
+#define FUSES       4000    /* Projectiles that spawn another when removed */
+#define FRAMES      400     /* Frames to run, enough for everything to land */
+
+static int failures;
+
+/* Make a projectile that stays where it is until killed */
+static void hold_still (struct Projectile *p)
+{
+    p->physics.vel = makeVector (0, 0);
+}
+
+static struct Projectile *make_still (double x, double y)
+{
+    struct Projectile *p = make_bullet (x, y, makeVector (0, 0));
+    p->move = hold_still;
+    return p;
+}
+
+/* Removing a fuse queues a new projectile from inside flush_projectiles */
+static void fuse_destroy (struct Projectile *p)
+{
+    add_projectile (make_bullet (p->physics.x, p->physics.y,
+                                 makeVector (1, -3)));
+}
+
+/* Bombs go off in a burst of clusters, and take two fuses with them */
+static struct Projectile *fuses[FUSES];
+static int fuses_lit;
+
+static void bomb_timer (struct Projectile *p)
+{
+    spawn_clusters (p->physics.x, p->physics.y, 3.0, CLUSTER, make_bullet);
+    fuses[fuses_lit++]->life = 0;
+    fuses[fuses_lit++]->life = 0;
+    p->life = 0;
+}
+
+/* Report a failed check */
+static void fail (int frame, const char *what)
+{
+    if (failures++ < 10)
+        printf ("Frame %d: %s\n", frame, what);
+}
+
+/* Walk the projectile list and check its links. Returns the number of */
+/* entries and counts the dead ones */
+static int check_list (int frame, int *dead)
+{
+    struct dllist *ptr = projectile_list, *prev = NULL;
+    int count = 0;
+    *dead = 0;
+    if (projectile_list && projectile_list->prev)
+        fail (frame, "first projectile has a previous link");
+    while (ptr) {
+        if (ptr->prev != prev)
+            fail (frame, "broken previous link");
+        if (((struct Projectile *) ptr->data)->life == 0)
+            (*dead)++;
+        prev = ptr;
+        ptr = ptr->next;
+        count++;
+    }
+    if (prev != last_projectile)
+        fail (frame, "last_projectile is not the end of the list");
+    return count;
+}
+
+int main (int argc, char *argv[])
+{
+    struct ProjectileQueueStats before;
+    int f, x, r, count, dead;
+
+    screen = SDL_CreateRGBSurface (SDL_SWSURFACE, 64, 64, 32, 0xff0000,
+                                   0xff00, 0xff, 0);
+    lev_level.width = LEVEL_SIZE;
+    lev_level.height = LEVEL_SIZE;
+    lev_level.solid = malloc (sizeof (unsigned char *) * LEVEL_SIZE);
+    for (x = 0; x < LEVEL_SIZE; x++) {
+        lev_level.solid[x] = malloc (LEVEL_SIZE);
+        memset (lev_level.solid[x], TER_FREE, LEVEL_SIZE);
+    }
+    reset_physics ();
+    clear_projectiles ();
+    srand (1);
+
+    for (r = 0; r < FUSES; r++) {
+        fuses[r] = make_still (20 + r % 900, 20 + r / 900);
+        fuses[r]->destroy = fuse_destroy;
+        add_projectile (fuses[r]);
+    }
+    for (r = 0; r < BOMBS; r++) {
+        struct Projectile *bomb = make_still (100 + r % 800,
+                                              400 + r / 800 * 100);
+        bomb->timer = 3;
+        bomb->timerfunc = bomb_timer;
+        add_projectile (bomb);
+    }
+
+    /* Run the frames the way the game loop does. Everything that dies */
+    /* during a frame must be gone after the flush that follows it, */
+    /* and the counters must agree with what is in the list */
+    for (f = 0; f < FRAMES; f++) {
+        flush_projectiles ();
+        animate_projectiles ();
+        count = check_list (f, &dead);
+        before = projectile_queue_stats;
+        flush_projectiles ();
+
+        count = check_list (f, &r);
+        if (r)
+            fail (f, "dead projectiles left after the flush");
+        if (projectile_queue_stats.removed - before.removed != dead)
+            fail (f, "removed count doesn't match the dead projectiles");
+        if (projectile_queue_stats.spawned - projectile_queue_stats.removed
+            != count)
+            fail (f, "spawned and removed counts don't match the list");
+    }
+
+    printf ("%lu projectiles spawned, %lu removed, longest queue %d, "
+            "%lu flushes\n", projectile_queue_stats.spawned,
+            projectile_queue_stats.removed, projectile_queue_stats.maxdepth,
+            projectile_queue_stats.flushes);
+    if (projectile_queue_stats.maxdepth < BOMBS * CLUSTER)
+        fail (f, "the clusters were not queued in the same frame");
+    if (projectile_list)
+        fail (f, "projectiles left after the last frame");
+    printf ("%d checks failed\n", failures);
+    return failures > 0;
+}
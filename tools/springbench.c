@@ -0,0 +1,119 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : springbench.c
+ * Description : Measure the cost and stretch of ropes of different lengths
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "level.h"
+#include "decor.h"
+#include "spring.h"
+
+#define LEVEL_SIZE  2000
+#define CEILING     100     /* Row of solid ground the hook sticks to */
+#define NODELEN     6.0     /* Length of one rope segment */
+#define FRAMES      3000    /* Frames simulated per rope */
+
+/* What physics.c and spring.c need from the rest of the game */
+Level lev_level;
+Uint32 lev_watercol, col_black, col_rope;
+SDL_Surface *screen;
+
+void put_terrain_pixel (int x, int y, Uint32 color) { }
+void add_decor (struct Decor *decor) { }
+struct Decor *make_snowflake (double x, double y, Vector v) { return NULL; }
+struct Decor *make_waterdrop (double x, double y, Vector v) { return NULL; }
+void add_splash (double x, double y, double force, int count, Vector v,
+        struct Decor *(*make) (double, double, Vector)) { }
+int clip_line (int *x1, int *y1, int *x2, int *y2, int left, int top,
+        int right, int bottom) { return 0; }
+#ifndef HAVE_LIBSDL_GFX
+void draw_line (SDL_Surface * screen, int x1, int y1, int x2, int y2,
+        Uint32 pixel) { }
+#endif
+
+/* Simulate a rope with a pilot sized object at its head. */
+/* If hooked is set, the rope is first shot into the ceiling so the */
+/* object swings from it, otherwise the whole rope flies freely. */
+/* Prints the time per frame and how far the ends got from each other */
+static void run_rope (int nodes, int hooked)
+{
+    struct Physics head;
+    struct Spring *spring;
+    double maxdist = 0, length = NODELEN * (nodes + 1);
+    clock_t start;
+    int f, r;
+
+    init_physobj (&head, LEVEL_SIZE / 2, CEILING + 10, makeVector (0, 0));
+    head.mass = 5;
+    head.radius = 4;
+    spring = create_spring (&head, NODELEN, nodes);
+    if (hooked)
+        spring->tail->vel = makeVector (0, -5);
+    else
+        spring->tail->vel = makeVector (12, -2);
+    for (r = 0; r < nodes; r++)
+        spring->nodes[r].vel = multVector (spring->tail->vel,
+                (r + 1.0) / (nodes + 1));
+
+    start = clock ();
+    for (f = 0; f < FRAMES; f++) {
+        double dist;
+        if (f == 5)
+            head.vel.x = 8; /* Start swinging */
+        animate_object (&head, 0, NULL);
+        animate_springs (&spring, 1);
+        dist = hypot (head.x - spring->tail->x, head.y - spring->tail->y);
+        if (f > 100 && dist > maxdist)
+            maxdist = dist;
+    }
+    printf ("%2d nodes, %s: %6.2f us/frame, rope %3.0f px, "
+            "ends at most %5.1f px apart\n", nodes,
+            hooked ? "hooked" : "flying",
+            (double) (clock () - start) / CLOCKS_PER_SEC / FRAMES * 1e6,
+            length, maxdist);
+    free_spring (spring);
+}
+
+int main (int argc, char *argv[])
+{
+    int x, nodes;
+
+    lev_level.width = LEVEL_SIZE;
+    lev_level.height = LEVEL_SIZE;
+    lev_level.solid = malloc (sizeof (unsigned char *) * LEVEL_SIZE);
+    for (x = 0; x < LEVEL_SIZE; x++) {
+        lev_level.solid[x] = malloc (LEVEL_SIZE);
+        memset (lev_level.solid[x], TER_FREE, LEVEL_SIZE);
+        lev_level.solid[x][CEILING] = TER_GROUND;
+    }
+    reset_physics ();
+
+    for (nodes = 1; nodes <= 64; nodes *= 2) {
+        run_rope (nodes, 1);
+        run_rope (nodes, 0);
+    }
+    return 0;
+}
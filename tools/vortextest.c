@@ -0,0 +1,186 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : vortextest.c
+ * Description : Compare baked vortex frames with the procedural renderer
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "console.h"
+#include "atlas.h"
+#include "vortex.h"
+
+#define SCREEN_W    320
+#define SCREEN_H    240
+#define MARGIN      20      /* Vortices this close to the viewport edges */
+                            /* are drawn at every position */
+#define BENCH_DRAWS 100000  /* Draws timed with each renderer */
+
+/* What atlas.c and vortex.c need from the rest of the game */
+SDL_Surface *screen;
+
+#ifndef HAVE_LIBSDL_GFX
+void putpixel (SDL_Surface * surface, int x, int y, Uint32 color)
+{
+    if (x < 0 || y < 0 || x >= surface->w || y >= surface->h)
+        return;
+    *(Uint32 *) ((Uint8 *) surface->pixels + y * surface->pitch + x * 4) =
+        color;
+}
+#endif
+
+SDL_Surface *make_surface (SDL_Surface * likethis, int w, int h)
+{
+    if (w == 0 || h == 0) {
+        w = likethis->w;
+        h = likethis->h;
+    }
+    return SDL_CreateRGBSurface (likethis->flags, w, h,
+                                 likethis->format->BitsPerPixel,
+                                 likethis->format->Rmask,
+                                 likethis->format->Gmask,
+                                 likethis->format->Bmask,
+                                 likethis->format->Amask);
+}
+
+static Uint32 get_pixel (SDL_Surface * surface, int x, int y)
+{
+    return *(Uint32 *) ((Uint8 *) surface->pixels + y * surface->pitch +
+                        x * 4);
+}
+
+/* Step to the next position to draw at. Every position near the */
+/* viewport edges is tried, where the baked frames have to be clipped */
+static int step (int pos, int size)
+{
+    if (pos < MARGIN || pos >= size - MARGIN)
+        return 1;
+    return pos + 13 < size - MARGIN ? 13 : size - MARGIN - pos;
+}
+
+/* Draw every phase of the vortex with the baked frames on the screen */
+/* and with the procedural renderer on the reference surface, at */
+/* positions across and beyond the viewport edges. Returns the number */
+/* of pixels that differ inside the viewport, plus the pixels the */
+/* baked frames drew outside it. Only the area around each vortex */
+/* is compared, since nothing is drawn further away */
+static long compare_renderers (SDL_Surface * reference, Uint32 color,
+                               SDL_Rect viewport, long *drawn)
+{
+    long diffs = 0;
+    int phase, x, y, px, py;
+    for (phase = 0; phase < vortex_frame_count; phase++) {
+        for (y = -MARGIN; y < viewport.h + MARGIN; y += step (y, viewport.h)) {
+            for (x = -MARGIN; x < viewport.w + MARGIN;
+                 x += step (x, viewport.w)) {
+                SDL_Rect area;
+                area.x = viewport.x + x - VORTEX_SIZE / 2 - 1;
+                area.y = viewport.y + y - VORTEX_SIZE / 2 - 1;
+                area.w = VORTEX_SIZE + 2;
+                area.h = VORTEX_SIZE + 2;
+                SDL_FillRect (screen, &area, 0);
+                SDL_FillRect (reference, &area, 0);
+                draw_vortex_phase (phase, color, x, y, viewport);
+                render_vortex (reference, x + viewport.x, y + viewport.y,
+                               phase, color);
+                for (py = area.y; py < area.y + area.h; py++) {
+                    if (py < 0 || py >= SCREEN_H)
+                        continue;
+                    for (px = area.x; px < area.x + area.w; px++) {
+                        Uint32 baked;
+                        if (px < 0 || px >= SCREEN_W)
+                            continue;
+                        baked = get_pixel (screen, px, py);
+                        if (px < viewport.x || py < viewport.y ||
+                            px >= viewport.x + viewport.w ||
+                            py >= viewport.y + viewport.h) {
+                            diffs += baked != 0;
+                        } else {
+                            Uint32 ref = get_pixel (reference, px, py);
+                            diffs += baked != ref;
+                            *drawn += ref != 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return diffs;
+}
+
+/* Print how long one draw takes with both renderers */
+static void bench (Uint32 color, SDL_Rect viewport)
+{
+    clock_t start;
+    double baked, procedural;
+    int i;
+    start = clock ();
+    for (i = 0; i < BENCH_DRAWS; i++)
+        draw_vortex_phase (i % vortex_frame_count, color, i % viewport.w,
+                           i % viewport.h, viewport);
+    baked = (double) (clock () - start) / CLOCKS_PER_SEC;
+    start = clock ();
+    for (i = 0; i < BENCH_DRAWS; i++)
+        render_vortex (screen, viewport.x + i % viewport.w,
+                       viewport.y + i % viewport.h, i % vortex_frame_count,
+                       color);
+    procedural = (double) (clock () - start) / CLOCKS_PER_SEC;
+    printf ("Per draw: baked %.2f us, procedural %.2f us\n",
+            baked / BENCH_DRAWS * 1e6, procedural / BENCH_DRAWS * 1e6);
+}
+
+int main (int argc, char *argv[])
+{
+    const int frame_counts[] = { VORTEX_FRAMES, 1, 24 };
+    SDL_Surface *reference;
+    SDL_Rect viewport = { 40, 30, 200, 150 };
+    Uint32 color;
+    int r, fails = 0;
+
+    screen = SDL_CreateRGBSurface (SDL_SWSURFACE, SCREEN_W, SCREEN_H, 32,
+                                   0xff0000, 0xff00, 0xff, 0);
+    reference = make_surface (screen, 0, 0);
+#ifdef HAVE_LIBSDL_GFX
+    color = 0x808080ff;
+#else
+    color = SDL_MapRGB (screen->format, 128, 128, 128);
+#endif
+
+    for (r = 0; r < sizeof (frame_counts) / sizeof (int); r++) {
+        long diffs, drawn = 0;
+        bake_vortex (frame_counts[r], color);
+        diffs = compare_renderers (reference, color, viewport, &drawn);
+        printf ("%d frames: %ld of %ld vortex pixels differ\n",
+                frame_counts[r], diffs, drawn);
+        /* An empty reference would make the comparison meaningless */
+        if (diffs > 0 || drawn == 0)
+            fails++;
+    }
+    bench (color, viewport);
+    atlas_stats ();
+
+    SDL_FreeSurface (reference);
+    SDL_FreeSurface (screen);
+    return fails > 0;
+}
@@ -0,0 +1,331 @@
+/*
+ * Luola - 2D multiplayer cave-flying game
+ * Copyright (C) 2006 Calle Laakkonen
+ *
+ * File        : walktest.c
+ * Description : Test and benchmark for the walker surface cache
+ * Author(s)   : Calle Laakkonen
+ *
+ * Luola is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Luola is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "level.h"
+#include "walker.h"
+#include "flyer.h"
+#include "decor.h"
+
+#define LEVEL_WIDTH     2000
+#define LEVEL_HEIGHT    1200
+#define PROBES          2000000 /* Random probes in the cross-check */
+#define EDIT_EVERY      100     /* Probes between terrain edits */
+#define SOLDIERS        400
+#define HELICOPTERS     100
+#define TICKS           1000    /* Default number of ticks to simulate */
+#define HOLE            4       /* Radius of the hole dug on each tick */
+
+/* Something that happened to the cache during the simulation. */
+/* A zero width means a find_foothold call with h in the height */
+struct Event {
+    short x, y, w, h;
+};
+
+static struct Event *events;
+static int event_count, event_size, recording;
+static int failures;
+
+static void record (int x, int y, int w, int h)
+{
+    if (!recording)
+        return;
+    if (event_count == event_size) {
+        event_size = event_size ? event_size * 2 : 65536;
+        events = realloc (events, sizeof (struct Event) * event_size);
+        if (events == NULL) {
+            perror ("record");
+            exit (1);
+        }
+    }
+    events[event_count].x = x;
+    events[event_count].y = y;
+    events[event_count].w = w;
+    events[event_count].h = h;
+    event_count++;
+}
+
+/* What physics.c and walker.c need from the rest of the game */
+Level lev_level;
+Uint32 lev_watercol, col_black;
+
+/* Snow and ice that things burrow into change the terrain as well */
+void put_terrain_pixel (int x, int y, Uint32 color)
+{
+    footholds_changed (x, y, 1, 1);
+    record (x, y, 1, 1);
+}
+void add_decor (struct Decor *decor) { }
+struct Decor *make_snowflake (double x, double y, Vector v) { return NULL; }
+struct Decor *make_waterdrop (double x, double y, Vector v) { return NULL; }
+void add_splash (double x, double y, double force, int count, Vector v,
+        struct Decor *(*make) (double, double, Vector)) { }
+
+/* find_foothold as it was before the surface cache */
+static int old_find_foothold (int x, int y, int h)
+{
+    int r;
+    if (is_walkable (x, y) && is_breathable (x, y - 1))
+        return y;
+    for (r = 1; r < h; r++) {
+        if (is_walkable (x, y + r) && is_breathable (x, y + r - 1))
+            return y + r;
+        if (is_walkable (x, y - r) && is_breathable (x, y - r - 1))
+            return y - r;
+    }
+    return -1;
+}
+
+/* Compare the cache with the old scan */
+static int check_foothold (const char *what, int x, int y, int h)
+{
+    int cached = find_foothold (x, y, h);
+    int scanned = old_find_foothold (x, y, h);
+    if (cached != scanned && failures++ < 10)
+        printf ("%s: find_foothold(%d,%d,%d) returned %d instead of %d\n",
+                what, x, y, h, cached, scanned);
+    return cached;
+}
+
+/* Make a rough cave: a bumpy floor with water on it, ledges, walkways */
+/* and tunnels, indestructible walls on the sides and random pixels of */
+/* every kind of terrain sprinkled around */
+static void make_terrain (unsigned int seed)
+{
+    int x, y, floor = 900;
+    srand (seed);
+    for (x = 0; x < LEVEL_WIDTH; x++) {
+        floor += rand () % 7 - 3;
+        if (floor < 700)
+            floor = 700;
+        if (floor > 1100)
+            floor = 1100;
+        for (y = 0; y < LEVEL_HEIGHT; y++) {
+            int t = TER_FREE;
+            if (x < 3 || x >= LEVEL_WIDTH - 3)
+                t = TER_INDESTRUCT;
+            else if (y >= floor)
+                t = TER_GROUND;
+            else if (y > 1000)
+                t = TER_WATER;
+            else if (y > 300 && y < 306 && x / 60 % 3 == 0)
+                t = TER_GROUND;
+            else if (y > 500 && y < 503 && x / 40 % 2)
+                t = TER_WALKWAY;
+            else if (y == 600 && x % 5 == 0)
+                t = TER_TUNNEL;
+            lev_level.solid[x][y] = t;
+        }
+    }
+    for (x = 50; x < LEVEL_WIDTH - 50; x += 97)
+        for (y = 0; y < LEVEL_HEIGHT; y += 13)
+            lev_level.solid[x][y] = rand () % (LAST_TER + 1);
+}
+
+/* Fill a block with one kind of terrain and report a slightly larger */
+/* area as changed, like the terrain brush does */
+static void fill_block (int x, int y, int w, int h, int terrain)
+{
+    int a, b, grow = rand () % 3;
+    for (a = x; a < x + w; a++)
+        for (b = y; b < y + h; b++)
+            lev_level.solid[a][b] = terrain;
+    footholds_changed (x - grow, y - grow, w + 2 * grow, h + 2 * grow);
+}
+
+/* Probe random points in and around the level with random slopes. */
+/* The terrain is edited every now and then */
+static void cross_check (void)
+{
+    int i, edits = 0;
+    make_terrain (1);
+    init_footholds ();
+    for (i = 0; i < PROBES; i++) {
+        if (i % EDIT_EVERY == 0) {
+            int w = i % (2 * EDIT_EVERY) ? 1 : 1 + rand () % 20;
+            int h = i % (2 * EDIT_EVERY) ? 1 : 1 + rand () % 20;
+            fill_block (rand () % (LEVEL_WIDTH - w), rand () % (LEVEL_HEIGHT - h),
+                        w, h, rand () % (LAST_TER + 1));
+            edits++;
+        }
+        check_foothold ("Random probe", rand () % (LEVEL_WIDTH + 20) - 10,
+                        rand () % (LEVEL_HEIGHT + 40) - 20, rand () % 14);
+    }
+    free_footholds ();
+    printf ("%d random probes with %d terrain edits\n", PROBES, edits);
+}
+
+/* Pick a random spot of open air */
+static void random_air (float *x, float *y)
+{
+    do {
+        *x = 3 + rand () % (LEVEL_WIDTH - 6);
+        *y = rand () % LEVEL_HEIGHT;
+    } while (lev_level.solid[(int) *x][(int) *y] != TER_FREE);
+}
+
+/* Dig a bullet hole, like make_hole */
+static void dig_hole (int x, int y)
+{
+    int a, b;
+    for (a = x - HOLE; a <= x + HOLE; a++) {
+        for (b = y - HOLE; b <= y + HOLE; b++) {
+            if ((a - x) * (a - x) + (b - y) * (b - y) <= HOLE * HOLE
+                && lev_level.solid[a][b] != TER_INDESTRUCT)
+                lev_level.solid[a][b] = TER_FREE;
+        }
+    }
+    footholds_changed (x - HOLE, y - HOLE, 2 * HOLE + 1, 2 * HOLE + 1);
+    record (x - HOLE, y - HOLE, 2 * HOLE + 1, 2 * HOLE + 1);
+}
+
+/* Soldiers walk back and forth and helicopters fly around while the */
+/* terrain gets shot up. Each soldier looks for a foothold ahead of it */
+/* on every tick like animate_groundcritter does. With check set, the */
+/* lookups are compared with the old scan, otherwise they are recorded */
+/* and the simulation is timed */
+static double simulate (int ticks, int check, unsigned int seed)
+{
+    static struct Walker soldiers[SOLDIERS];
+    static struct Flyer helicopters[HELICOPTERS];
+    clock_t start;
+    int t, r;
+
+    make_terrain (seed);
+    init_footholds ();
+    reset_physics ();
+    for (r = 0; r < SOLDIERS; r++) {
+        struct Walker *w = &soldiers[r];
+        init_walker (w);
+        w->physics.radius = 6;
+        w->physics.mass = 12;
+        w->walking = rand () % 2 ? -1 : 1;
+        w->walkspeed = 1;
+        w->slope = 10;
+        w->physics.x = 10 + rand () % (LEVEL_WIDTH - 20);
+        w->physics.y = find_foothold (w->physics.x, 0, LEVEL_HEIGHT);
+        if (w->physics.y < 0)
+            w->physics.y = 0;
+    }
+    for (r = 0; r < HELICOPTERS; r++) {
+        struct Flyer *f = &helicopters[r];
+        init_flyer (f, AIRBORNE);
+        random_air (&f->physics.x, &f->physics.y);
+        random_air (&f->targx, &f->targy);
+    }
+
+    recording = !check;
+    start = clock ();
+    for (t = 0; t < ticks; t++) {
+        dig_hole (10 + rand () % (LEVEL_WIDTH - 20),
+                  10 + rand () % (LEVEL_HEIGHT - 20));
+        for (r = 0; r < SOLDIERS; r++) {
+            struct Walker *w = &soldiers[r];
+            int x, y, foothold;
+            animate_walker (w, 0, NULL);
+            x = Round (w->physics.x) + w->walkspeed * w->walking;
+            y = Round (w->physics.y);
+            if (check)
+                foothold = check_foothold ("Soldier", x, y, w->slope);
+            else
+                foothold = find_foothold (x, y, w->slope);
+            record (x, y, 0, w->slope);
+            if (foothold < 0)
+                w->walking *= -1;
+        }
+        for (r = 0; r < HELICOPTERS; r++) {
+            struct Flyer *f = &helicopters[r];
+            animate_flyer (f, 0, NULL);
+            if ((t + r) % 200 == 0)
+                random_air (&f->targx, &f->targy);
+        }
+    }
+    recording = 0;
+    free_footholds ();
+    return (double) (clock () - start) / CLOCKS_PER_SEC;
+}
+
+/* Replay the soldiers' lookups and the terrain changes recorded */
+/* during a simulation and return the time one lookup took. */
+/* Counts the lookups that found nothing in misses */
+static double replay (int cached, int *misses)
+{
+    clock_t start;
+    int e, found, probes = 0;
+
+    init_footholds ();
+    for (e = 0; e < event_count; e++)
+        if (events[e].w == 0)
+            find_foothold (events[e].x, events[e].y, events[e].h);
+
+    *misses = 0;
+    start = clock ();
+    for (e = 0; e < event_count; e++) {
+        const struct Event *ev = &events[e];
+        if (ev->w == 0) {
+            if (cached)
+                found = find_foothold (ev->x, ev->y, ev->h);
+            else
+                found = old_find_foothold (ev->x, ev->y, ev->h);
+            *misses += found < 0;
+            probes++;
+        } else if (cached) {
+            footholds_changed (ev->x, ev->y, ev->w, ev->h);
+        }
+    }
+    free_footholds ();
+    return (double) (clock () - start) / CLOCKS_PER_SEC / probes;
+}
+
+int main (int argc, char *argv[])
+{
+    int ticks = argc > 1 ? atoi (argv[1]) : TICKS;
+    double elapsed, old_scan, cache;
+    int x, misses;
+
+    lev_level.width = LEVEL_WIDTH;
+    lev_level.height = LEVEL_HEIGHT;
+    lev_level.solid = malloc (sizeof (unsigned char *) * LEVEL_WIDTH);
+    for (x = 0; x < LEVEL_WIDTH; x++)
+        lev_level.solid[x] = malloc (LEVEL_HEIGHT);
+
+    cross_check ();
+    simulate (ticks, 1, 2);
+    printf ("%d soldiers checked for %d ticks\n", SOLDIERS, ticks);
+
+    elapsed = simulate (ticks, 0, 3);
+    printf ("%d soldiers and %d helicopters: %.3f ms per tick\n",
+            SOLDIERS, HELICOPTERS, elapsed / ticks * 1e3);
+    old_scan = replay (0, &misses);
+    cache = replay (1, &misses);
+    printf ("%d lookups ahead of the soldiers, %d found nothing: "
+            "old scan %.1f ns, cache %.1f ns\n", SOLDIERS * ticks, misses,
+            old_scan * 1e9, cache * 1e9);
+
+    printf ("%d checks failed\n", failures);
+    return failures > 0;
+}